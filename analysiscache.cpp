@@ -0,0 +1,281 @@
+#include "analysiscache.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <QDebug>
+#include <QMutexLocker>
+
+namespace
+{
+    constexpr char magic[4] = {'C', 'G', 'A', 'C'};
+    constexpr quint32 version = 1;
+    constexpr qint64 fileHeaderSize = 8;
+    constexpr qint64 entrySize = qint64(sizeof(AnalysisCacheEntry));
+
+    // FNV-1a, qHash is seeded per process and the limits keys are stored on disk.
+    quint64 hashBytes(quint64 hash, std::string_view bytes)
+    {
+        for (const char byte : bytes)
+        {
+            hash ^= quint8(byte);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    quint64 hashLimits(std::string_view engine, std::string_view limits)
+    {
+        quint64 hash = hashBytes(0xcbf29ce484222325ull, engine);
+        hash = hashBytes(hash, std::string_view("\0", 1));
+        return hashBytes(hash, limits);
+    }
+
+    std::string_view nextToken(std::string_view &text)
+    {
+        const std::size_t start = std::min(text.find_first_not_of(" \t"), text.size());
+        const std::size_t end = std::min(text.find_first_of(" \t", start), text.size());
+        const std::string_view token = text.substr(start, end - start);
+        text.remove_prefix(end);
+        return token;
+    }
+}
+
+AnalysisCache::AnalysisCache(int memoryEntries)
+    : m_memory(qMax(1, memoryEntries))
+{
+    m_map = nullptr;
+    m_mappedSize = 0;
+}
+
+AnalysisCache::~AnalysisCache()
+{
+    close();
+}
+
+bool AnalysisCache::open(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite))
+    {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    if (m_file.size() == 0)
+    {
+        if (m_file.write(magic, 4) != 4 || m_file.write(reinterpret_cast<const char *>(&version), 4) != 4 || !m_file.flush())
+        {
+            m_error = m_file.errorString();
+            m_file.close();
+            return false;
+        }
+    }
+
+    char header[fileHeaderSize];
+    quint32 fileVersion = 0;
+    m_file.seek(0);
+    if (m_file.read(header, fileHeaderSize) != fileHeaderSize || std::memcmp(header, magic, 4) != 0)
+    {
+        m_error = QStringLiteral("%1 is not an analysis cache").arg(fileName);
+        m_file.close();
+        return false;
+    }
+    std::memcpy(&fileVersion, header + 4, 4);
+    if (fileVersion != version)
+    {
+        m_error = QStringLiteral("%1 has unsupported version %2").arg(fileName).arg(fileVersion);
+        m_file.close();
+        return false;
+    }
+
+    // A partly written last entry belongs to an interrupted store and is dropped.
+    const qint64 entries = (m_file.size() - fileHeaderSize) / entrySize;
+    const qint64 size = fileHeaderSize + entries * entrySize;
+    if (m_file.size() != size)
+        m_file.resize(size);
+
+    // Later entries are deeper than earlier ones for the same key, so the last one wins.
+    m_diskIndex.clear();
+    m_diskIndex.reserve(entries);
+    m_map = entries > 0 ? m_file.map(0, size) : nullptr;
+    m_mappedSize = m_map ? size : 0;
+    for (qint64 index = 0; index < entries && m_map; ++index)
+    {
+        const qint64 offset = fileHeaderSize + index * entrySize;
+        AnalysisCacheEntry entry;
+        std::memcpy(&entry, m_map + offset, sizeof(entry));
+        m_diskIndex.insert({entry.key, entry.limits}, offset);
+    }
+
+    m_file.seek(size);
+    qDebug() << "Analysis cache" << fileName << "with" << m_diskIndex.size() << "positions";
+
+    return true;
+}
+
+void AnalysisCache::close()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_file.isOpen())
+        return;
+
+    m_file.flush();
+    if (m_map)
+        m_file.unmap(const_cast<uchar *>(m_map));
+    m_map = nullptr;
+    m_mappedSize = 0;
+    m_file.close();
+    m_diskIndex.clear();
+}
+
+QString AnalysisCache::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_error;
+}
+
+AnalysisCache::Limits AnalysisCache::limitsFor(std::string_view engine, std::string_view goCommand)
+{
+    // "go depth n" is answered by any result of at least depth n, everything else must match.
+    std::string_view rest = goCommand;
+    const std::string_view command = nextToken(rest);
+    const std::string_view first = nextToken(rest);
+    const std::string_view value = nextToken(rest);
+    if (command == "go" && first == "depth" && nextToken(rest).empty())
+    {
+        int depth = 0;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), depth);
+        if (error == std::errc() && end == value.data() + value.size() && depth > 0)
+            return limitsForDepth(engine, depth);
+    }
+
+    // Normalise the white space so equal commands give equal keys.
+    std::string normalised;
+    rest = goCommand;
+    for (std::string_view token = nextToken(rest); !token.empty(); token = nextToken(rest))
+    {
+        if (!normalised.empty())
+            normalised += ' ';
+        normalised.append(token);
+    }
+
+    Limits limits;
+    limits.key = hashLimits(engine, normalised);
+    return limits;
+}
+
+AnalysisCache::Limits AnalysisCache::limitsForDepth(std::string_view engine, int depth)
+{
+    Limits limits;
+    limits.key = hashLimits(engine, "go depth");
+    limits.depth = depth;
+    return limits;
+}
+
+bool AnalysisCache::readDiskEntry(qint64 offset, AnalysisCacheEntry &entry)
+{
+    // Entries appended since the file was mapped need a new mapping.
+    if (offset + entrySize > m_mappedSize)
+    {
+        m_file.flush();
+        if (m_map)
+            m_file.unmap(const_cast<uchar *>(m_map));
+        m_mappedSize = m_file.size();
+        m_map = m_file.map(0, m_mappedSize);
+        if (!m_map)
+        {
+            qWarning() << "Cannot map" << m_file.fileName() << m_file.errorString();
+            m_mappedSize = 0;
+            return false;
+        }
+    }
+
+    std::memcpy(&entry, m_map + offset, sizeof(entry));
+    return true;
+}
+
+bool AnalysisCache::lookup(quint64 key, const Limits &limits, AnalysisCacheEntry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_statistics.lookups;
+
+    // The memory tier always holds the deepest result of a key it knows.
+    const Key cacheKey{key, limits.key};
+    if (const AnalysisCacheEntry *cached = m_memory.object(cacheKey))
+    {
+        if (cached->depth < limits.depth)
+            return false;
+        entry = *cached;
+        ++m_statistics.memoryHits;
+        return true;
+    }
+
+    const auto disk = m_diskIndex.constFind(cacheKey);
+    if (disk == m_diskIndex.constEnd() || !readDiskEntry(disk.value(), entry))
+        return false;
+
+    m_memory.insert(cacheKey, new AnalysisCacheEntry(entry));
+    if (entry.depth < limits.depth)
+        return false;
+    ++m_statistics.diskHits;
+    return true;
+}
+
+void AnalysisCache::store(quint64 key, const Limits &limits, int depth, int score, bool mate, Move bestMove,
+                          const Move *pv, int pvLength)
+{
+    AnalysisCacheEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.key = key;
+    entry.limits = limits.key;
+    entry.score = score;
+    entry.bestMove = bestMove.data();
+    entry.depth = quint8(qBound(0, depth, 255));
+    entry.scoreType = mate ? AnalysisCacheEntry::Mate : AnalysisCacheEntry::Centipawns;
+    entry.pvLength = quint8(qBound(0, pvLength, AnalysisCacheEntry::MaxPv));
+    for (int ply = 0; ply < entry.pvLength; ++ply)
+        entry.pv[ply] = pv[ply].data();
+
+    QMutexLocker locker(&m_mutex);
+
+    const Key cacheKey{key, limits.key};
+    AnalysisCacheEntry stored;
+    const AnalysisCacheEntry *existing = m_memory.object(cacheKey);
+    if (!existing)
+    {
+        const auto disk = m_diskIndex.constFind(cacheKey);
+        if (disk != m_diskIndex.constEnd() && readDiskEntry(disk.value(), stored))
+            existing = &stored;
+    }
+    if (existing && existing->depth >= entry.depth)
+        return;
+
+    m_memory.insert(cacheKey, new AnalysisCacheEntry(entry));
+    ++m_statistics.stores;
+
+    if (!m_file.isOpen())
+        return;
+    const qint64 offset = m_file.pos();
+    if (m_file.write(reinterpret_cast<const char *>(&entry), entrySize) != entrySize)
+    {
+        qWarning() << "Cannot write" << m_file.fileName() << m_file.errorString();
+        return;
+    }
+    m_diskIndex.insert(cacheKey, offset);
+}
+
+AnalysisCache::Statistics AnalysisCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
+
+qint64 AnalysisCache::diskEntries() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_diskIndex.size();
+}
@@ -0,0 +1,116 @@
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include <cstdint>
+#include <string_view>
+#include "move.h"
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Result of one search, stored as is in the disk tier.
+struct AnalysisCacheEntry
+{
+    enum ScoreType : quint8 {Centipawns, Mate};
+
+    static constexpr int MaxPv = 34;
+
+    quint64 key;
+    quint64 limits;
+    qint32 score;
+    quint16 bestMove;
+    quint8 depth;
+    quint8 scoreType;
+    quint8 pvLength;
+    quint8 reserved[3];
+    quint16 pv[MaxPv];
+};
+static_assert(sizeof(AnalysisCacheEntry) == 96, "AnalysisCacheEntry is stored as is");
+
+/*
+ * Persistent cache of search results keyed by position key and search limits.
+ *
+ * Lookups go to an in-memory LRU of recent entries first, then to the disk tier: an append-only
+ * file of "CGAC" + version followed by entries, memory mapped and indexed by a hash built on open.
+ * A result only replaces a stored one when it is at least as deep, so a lookup may be answered
+ * by a deeper search than the one asked for. The file uses host byte order.
+ *
+ * All members lock, one cache can be shared by searches on any thread.
+ */
+class AnalysisCache
+{
+public:
+    // What a search was asked to do. For depth limited searches depth is the requested depth
+    // and any stored result at least that deep answers it; other limits must match exactly.
+    struct Limits
+    {
+        quint64 key = 0;
+        int depth = 0;
+    };
+
+    struct Statistics
+    {
+        qint64 lookups = 0;
+        qint64 memoryHits = 0;
+        qint64 diskHits = 0;
+        qint64 stores = 0;
+
+        inline qint64 hits() const { return memoryHits + diskHits; }
+        inline double hitRate() const { return lookups > 0 ? double(hits()) / double(lookups) : 0.0; }
+    };
+
+    explicit AnalysisCache(int memoryEntries = 65536);
+    ~AnalysisCache();
+
+    // Opens or creates the disk tier. Without it the cache is memory only.
+    bool open(const QString &fileName);
+    void close();
+    QString errorString() const;
+
+    // Limits of a "go ..." command sent to engine, which is anything that tells engines apart.
+    static Limits limitsFor(std::string_view engine, std::string_view goCommand);
+
+    // Limits of a fixed depth search by the internal searcher.
+    static Limits limitsForDepth(std::string_view engine, int depth);
+
+    bool lookup(quint64 key, const Limits &limits, AnalysisCacheEntry &entry);
+
+    // Keeps entry unless a deeper result for the same key and limits is stored already.
+    void store(quint64 key, const Limits &limits, int depth, int score, bool mate, Move bestMove,
+               const Move *pv = nullptr, int pvLength = 0);
+
+    Statistics statistics() const;
+    qint64 diskEntries() const;
+
+private:
+    struct Key
+    {
+        quint64 key;
+        quint64 limits;
+
+        inline bool operator==(const Key &other) const
+        {
+            return key == other.key && limits == other.limits;
+        }
+
+        friend inline size_t qHash(const Key &key, size_t seed)
+        {
+            return qHashMulti(seed, key.key, key.limits);
+        }
+    };
+
+    bool readDiskEntry(qint64 offset, AnalysisCacheEntry &entry);
+
+    mutable QMutex m_mutex;
+    QCache<Key, AnalysisCacheEntry> m_memory;
+    QHash<Key, qint64> m_diskIndex;
+    QFile m_file;
+    const uchar *m_map;
+    qint64 m_mappedSize;
+    Statistics m_statistics;
+    QString m_error;
+};
+
+#endif // ANALYSISCACHE_H
@@ -0,0 +1,481 @@
+/**
+ * @brief chess-batch: runs the rules engine over every position of an EPD/FEN file.
+ * Build together with analysiscache.cpp, enginepool.cpp, fen.cpp, position.cpp, movegen.cpp,
+ * search.cpp, transposition.cpp, uciengine.cpp, uciengineworker.cpp, uciparser.cpp and zobrist.cpp,
+ * see README for the command.
+ *
+ *   chess-batch [--threads n] [--depth plies] [--cache file] [--output file] positions.epd
+ *   chess-batch --engine path [--threads n] [--go command] [--cache file] [--output file] positions.epd
+ *
+ * The input is memory mapped and cut into chunks at line boundaries. Chunks are analysed on a
+ * thread pool and written back in input order, one tab separated line per position:
+ *
+ *   fen  legal-moves  status  score  bestmove
+ *
+ * With --engine the score and best move come from a pool of external UCI engines, one per
+ * thread, instead of the built in search. With --cache results are kept in an analysis cache
+ * file and positions found there are not searched again.
+ */
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include "../analysiscache.h"
+#include "../enginepool.h"
+#include "../fen.h"
+#include "../movegen.h"
+#include "../search.h"
+#include "../zobrist.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+struct Chunk
+{
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    QByteArray output;
+    qint64 positions = 0;
+    qint64 errors = 0;
+    bool done = false;
+};
+
+static void appendNumber(QByteArray &output, qint64 number)
+{
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    Q_UNUSED(ec);
+    output.append(buffer, end - buffer);
+}
+
+/*
+ * Writes the fen, legal move count and status columns of record. A record that does not parse
+ * gets a complete error line instead and false is returned.
+ */
+static bool describePosition(QByteArray &output, std::string_view record, Position &position, MoveList &moves)
+{
+    std::string_view operations;
+    const Fen::Error error = Fen::parseEpd(record, position, operations);
+    if (error != Fen::Error::None)
+    {
+        output.append(record.data(), qsizetype(record.size()));
+        output.append("\t-\terror: ");
+        output.append(Fen::errorString(error));
+        output.append("\t-\t-\n");
+        return false;
+    }
+
+    MoveGen::generateLegal(position, moves);
+    const MoveGen::Status status = MoveGen::status(position, moves);
+
+    char fen[Fen::BufferSize];
+    const std::size_t length = Fen::write(position, fen, sizeof(fen));
+    output.append(fen, qsizetype(length));
+    output.append('\t');
+    appendNumber(output, moves.size());
+    output.append('\t');
+    output.append(MoveGen::statusString(status));
+    return true;
+}
+
+static void appendMove(QByteArray &output, Move bestMove)
+{
+    char move[6];
+    const std::size_t moveLength = bestMove.isNull() ? 0 : bestMove.writeUci(move);
+    output.append('\t');
+    if (moveLength > 0)
+        output.append(move, qsizetype(moveLength));
+    else
+        output.append('-');
+}
+
+// Score and best move columns, value is in centipawns or in moves to mate.
+static void appendResult(QByteArray &output, bool mate, int value, Move bestMove)
+{
+    output.append(mate ? "\tmate " : "\tcp ");
+    appendNumber(output, value);
+    appendMove(output, bestMove);
+}
+
+static void appendCachedResult(QByteArray &output, const AnalysisCacheEntry &entry)
+{
+    appendResult(output, entry.scoreType == AnalysisCacheEntry::Mate, entry.score, Move::fromData(entry.bestMove));
+}
+
+static void analysePosition(Chunk &chunk, std::string_view record, Searcher &searcher, const SearchLimits &limits,
+                            AnalysisCache *cache)
+{
+    Position position;
+    MoveList moves;
+    if (!describePosition(chunk.output, record, position, moves))
+    {
+        ++chunk.errors;
+        return;
+    }
+
+    // The search is optional, and pointless without legal moves.
+    if (limits.depth > 0 && !moves.empty())
+    {
+        const quint64 key = cache ? Zobrist::key(position) : 0;
+        const AnalysisCache::Limits cacheLimits = AnalysisCache::limitsForDepth("internal", limits.depth);
+        AnalysisCacheEntry cached;
+        if (cache && cache->lookup(key, cacheLimits, cached))
+        {
+            appendCachedResult(chunk.output, cached);
+        }
+        else
+        {
+            const SearchResult result = searcher.search(position, limits);
+            const bool mate = Searcher::isMateScore(result.score);
+            const int value = mate ? Searcher::mateInMoves(result.score) : result.score;
+            appendResult(chunk.output, mate, value, result.bestMove);
+            // The search stops early at a forced mate, which is the answer for the full depth as well.
+            const int depth = mate ? std::max(result.depth, limits.depth) : result.depth;
+            if (cache)
+                cache->store(key, cacheLimits, depth, value, mate, result.bestMove, &result.bestMove, 1);
+        }
+    }
+    else
+    {
+        chunk.output.append("\t-\t-");
+    }
+    chunk.output.append('\n');
+
+    ++chunk.positions;
+}
+
+// Runs on a pool thread. Every chunk owns its output so no locking is needed until it is done.
+static void processChunk(Chunk &chunk, const SearchLimits &limits, AnalysisCache *cache)
+{
+    Searcher searcher;
+    chunk.output.reserve(qsizetype((chunk.end - chunk.begin) * 2));
+
+    const char *line = chunk.begin;
+    while (line < chunk.end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(line, '\n', std::size_t(chunk.end - line)));
+        const char *lineEnd = newline ? newline : chunk.end;
+        std::string_view record(line, std::size_t(lineEnd - line));
+        line = lineEnd + 1;
+
+        if (!record.empty() && record.back() == '\r')
+            record.remove_suffix(1);
+        if (record.empty() || record.front() == '#')
+            continue;
+
+        analysePosition(chunk, record, searcher, limits, cache);
+    }
+}
+
+static void printCacheStatistics(QTextStream &err, const AnalysisCache *cache)
+{
+    if (!cache)
+        return;
+
+    const AnalysisCache::Statistics statistics = cache->statistics();
+    err << "cache: " << statistics.lookups << " lookups, " << QString::number(statistics.hitRate() * 100.0, 'f', 1)
+        << "% hits (" << statistics.memoryHits << " memory, " << statistics.diskHits << " disk), "
+        << statistics.stores << " stored" << Qt::endl;
+}
+
+struct EngineRecord
+{
+    QByteArray output;
+    quint64 key = 0;
+    bool done = false;
+};
+
+/*
+ * Feeds the positions to a pool of UCI engines. Results arrive in completion order and are
+ * written in input order; at most a few positions per engine are parsed ahead.
+ */
+static int runEngineBatch(QCoreApplication &app, const char *data, qint64 size, QFile &output,
+                          const QString &enginePath, int engines, const QString &goCommand, AnalysisCache *cache)
+{
+    QTextStream err(stderr);
+    EnginePool pool(enginePath, engines);
+    const AnalysisCache::Limits cacheLimits = AnalysisCache::limitsFor(enginePath.toStdString(), goCommand.toStdString());
+
+    const std::size_t window = std::size_t(engines) * 4;
+    std::deque<EngineRecord> pending;
+    qint64 firstId = 0;
+    const char *cursor = data;
+    const char *const dataEnd = data + size;
+    qint64 positions = 0;
+    qint64 errors = 0;
+
+    // Writes the finished records at the head, then parses input until the window is full again.
+    // Records that need no engine are done at once and never hold up the window.
+    const auto advance = [&] {
+        while (true)
+        {
+            while (!pending.empty() && pending.front().done)
+            {
+                output.write(pending.front().output);
+                pending.pop_front();
+                ++firstId;
+            }
+            if (pending.size() >= window || cursor >= dataEnd)
+                break;
+
+            const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', std::size_t(dataEnd - cursor)));
+            const char *lineEnd = newline ? newline : dataEnd;
+            std::string_view record(cursor, std::size_t(lineEnd - cursor));
+            cursor = lineEnd + 1;
+
+            if (!record.empty() && record.back() == '\r')
+                record.remove_suffix(1);
+            if (record.empty() || record.front() == '#')
+                continue;
+
+            const qint64 id = firstId + qint64(pending.size());
+            pending.emplace_back();
+            EngineRecord &entry = pending.back();
+
+            Position position;
+            MoveList moves;
+            if (!describePosition(entry.output, record, position, moves))
+            {
+                entry.done = true;
+                ++errors;
+                continue;
+            }
+            ++positions;
+
+            if (moves.empty())
+            {
+                entry.output.append("\t-\t-\n");
+                entry.done = true;
+                continue;
+            }
+
+            // Cache hits never reach an engine.
+            AnalysisCacheEntry cached;
+            entry.key = Zobrist::key(position);
+            if (cache && cache->lookup(entry.key, cacheLimits, cached))
+            {
+                appendCachedResult(entry.output, cached);
+                entry.output.append('\n');
+                entry.done = true;
+                continue;
+            }
+
+            char fen[Fen::BufferSize];
+            const std::size_t length = Fen::write(position, fen, sizeof(fen));
+            pool.submit(id, QString::fromLatin1(fen, qsizetype(length)), goCommand);
+        }
+
+        if (pending.empty())
+            app.quit();
+    };
+
+    QObject::connect(&pool, &EnginePool::resultReady, &app,
+                     [&](qint64 positionId, const UciBestMove &bestMove, const UciInfo &info) {
+        EngineRecord &entry = pending[std::size_t(positionId - firstId)];
+        if (info.scoreType == UciInfo::NoScore)
+        {
+            entry.output.append("\t-");
+            appendMove(entry.output, bestMove.move);
+        }
+        else
+        {
+            const bool mate = info.scoreType == UciInfo::Mate;
+            appendResult(entry.output, mate, info.score, bestMove.move);
+            if (cache && info.depth > 0)
+                cache->store(entry.key, cacheLimits, info.depth, info.score, mate, bestMove.move, info.pv, info.pvLength);
+        }
+        entry.output.append('\n');
+        entry.done = true;
+        advance();
+    });
+    QObject::connect(&pool, &EnginePool::positionFailed, &app, [&](qint64 positionId) {
+        EngineRecord &entry = pending[std::size_t(positionId - firstId)];
+        entry.output.append("\terror: engine failed\t-\n");
+        entry.done = true;
+        ++errors;
+        advance();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+
+    advance();
+    if (!pending.empty())
+        app.exec();
+    output.flush();
+
+    const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+    err << positions << " positions, " << errors << " errors in " << QString::number(seconds, 'f', 3) << " s, "
+        << QString::number(pool.positionsPerSecond(), 'f', 1) << " searches/sec on " << engines << " engines" << Qt::endl;
+
+    // Engines well below 100% busy mean the pool is bigger than the machine or the feed can keep up with.
+    const QList<EnginePool::EngineStatistics> statistics = pool.statistics();
+    for (int index = 0; index < statistics.size(); ++index)
+    {
+        const EnginePool::EngineStatistics &engine = statistics[index];
+        err << "engine " << index << ": " << engine.positions << " positions, " << engine.nodes << " nodes, "
+            << QString::number(engine.utilization * 100.0, 'f', 1) << "% busy" << Qt::endl;
+    }
+
+    return errors > 0 ? 2 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chess-batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the rules engine over every position of an EPD/FEN file.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "EPD or FEN file with one position per line.");
+
+    QCommandLineOption threadsOption({"t", "threads"}, "Number of worker threads.", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption depthOption({"d", "depth"}, "Search depth in plies, 0 disables the search.", "plies", "0");
+    QCommandLineOption outputOption({"o", "output"}, "Output file, standard output if not given.", "file");
+    QCommandLineOption chunkOption("chunk-size", "Approximate number of input bytes per work chunk.", "bytes", "262144");
+    QCommandLineOption engineOption({"e", "engine"}, "Analyse with a pool of UCI engines, one per thread.", "path");
+    QCommandLineOption goOption("go", "Search command sent to the engines.", "command", "go depth 12");
+    QCommandLineOption cacheOption("cache", "Analysis cache file, created if it does not exist.", "file");
+    parser.addOption(threadsOption);
+    parser.addOption(depthOption);
+    parser.addOption(outputOption);
+    parser.addOption(chunkOption);
+    parser.addOption(engineOption);
+    parser.addOption(goOption);
+    parser.addOption(cacheOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    const int threads = qMax(1, parser.value(threadsOption).toInt());
+    const qint64 chunkSize = qMax(4096, parser.value(chunkOption).toInt());
+    SearchLimits limits;
+    limits.depth = parser.value(depthOption).toInt();
+
+    // Map the whole input. Pipes and other unmappable files are read into memory instead.
+    QFile input(parser.positionalArguments().first());
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        err << "Cannot open " << input.fileName() << ": " << input.errorString() << Qt::endl;
+        return 1;
+    }
+    QByteArray buffer;
+    const char *data = reinterpret_cast<const char *>(input.size() > 0 ? input.map(0, input.size()) : nullptr);
+    qint64 size = input.size();
+    if (!data)
+    {
+        buffer = input.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption))
+    {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            err << "Cannot write " << output.fileName() << ": " << output.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        output.open(stdout, QIODevice::WriteOnly);
+    }
+
+    AnalysisCache cache;
+    AnalysisCache *analysisCache = nullptr;
+    if (parser.isSet(cacheOption))
+    {
+        if (!cache.open(parser.value(cacheOption)))
+        {
+            err << "Cannot open " << parser.value(cacheOption) << ": " << cache.errorString() << Qt::endl;
+            return 1;
+        }
+        analysisCache = &cache;
+    }
+
+    if (parser.isSet(engineOption))
+    {
+        const int result = runEngineBatch(app, data, size, output, parser.value(engineOption), threads,
+                                          parser.value(goOption), analysisCache);
+        printCacheStatistics(err, analysisCache);
+        return result;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QMutex mutex;
+    QWaitCondition chunkDone;
+
+    // Keep a bounded number of chunks in flight so the output of a huge file never piles up in memory.
+    const std::size_t window = std::size_t(threads) * 4;
+    std::deque<std::unique_ptr<Chunk>> inFlight;
+    const char *cursor = data;
+    const char *const dataEnd = data + size;
+    qint64 positions = 0;
+    qint64 errors = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true)
+    {
+        while (inFlight.size() < window && cursor < dataEnd)
+        {
+            // Cut the next chunk at the first line end after chunkSize bytes.
+            const char *end = cursor + qMin<qint64>(chunkSize, dataEnd - cursor);
+            const char *newline = static_cast<const char *>(std::memchr(end, '\n', std::size_t(dataEnd - end)));
+            end = newline ? newline + 1 : dataEnd;
+
+            auto chunk = std::make_unique<Chunk>();
+            chunk->begin = cursor;
+            chunk->end = end;
+            cursor = end;
+
+            Chunk *work = chunk.get();
+            inFlight.push_back(std::move(chunk));
+            pool.start([work, &limits, analysisCache, &mutex, &chunkDone] {
+                processChunk(*work, limits, analysisCache);
+                QMutexLocker locker(&mutex);
+                work->done = true;
+                chunkDone.wakeAll();
+            });
+        }
+
+        if (inFlight.empty())
+            break;
+
+        // Write the oldest chunk as soon as it is done, this keeps the input order.
+        Chunk *head = inFlight.front().get();
+        {
+            QMutexLocker locker(&mutex);
+            while (!head->done)
+                chunkDone.wait(&mutex);
+        }
+        output.write(head->output);
+        positions += head->positions;
+        errors += head->errors;
+        inFlight.pop_front();
+    }
+    output.flush();
+
+    const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+    err << positions << " positions, " << errors << " errors in " << QString::number(seconds, 'f', 3) << " s, "
+        << QString::number(positions / seconds, 'f', 0) << " positions/sec on " << threads << " threads" << Qt::endl;
+    printCacheStatistics(err, analysisCache);
+
+    return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,632 @@
+/**
+ * @brief Microbenchmarks for the rules, notation and FEN hot paths.
+ * Build with the command in README, which lists the sources it needs, and run:
+ *
+ *   chessbench [--corpus bench/corpus.fen] [--pgn bench/games.pgn] [--iterations 20] [--output results.json]
+ *
+ * Results are written as JSON with ns/op and allocations/op per case so two builds can be compared.
+ * The games of --pgn are also stored in a game database to compare its size and decoding speed with PGN.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <iterator>
+#include <utility>
+#include "../chessalgorithm.h"
+#include "../chessboard.h"
+#include "../fen.h"
+#include "../gamecodec.h"
+#include "../gamedb.h"
+#include "../movegen.h"
+#include "../pgnreader.h"
+#include "../zobrist.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+static std::atomic<quint64> g_allocations{0};
+
+// Results of measured lookups end up here so the compiler cannot drop them.
+static std::atomic<quint64> g_sink{0};
+
+/*
+ * Count every heap allocation made by the process.
+ * QString and friends allocate through malloc() directly, so on glibc we interpose malloc itself.
+ * Elsewhere only operator new is counted.
+ */
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+}
+#else
+#include <new>
+
+void *operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+// Exposes the protected player setter so positions can be loaded with the right side to move.
+class BenchAlgorithm : public ChessAlgorithm
+{
+public:
+    using ChessAlgorithm::setCurrentPlayer;
+
+    void loadPosition(const QString &fen, bool whiteToMove)
+    {
+        board()->setFen(fen);
+        setCurrentPlayer(whiteToMove ? WhitePlayer : BlackPlayer);
+    }
+};
+
+struct CorpusEntry
+{
+    QString name;
+    QString kind;
+    QString fen;
+    bool whiteToMove;
+};
+
+// Accumulates time and allocations of the measured operations only, setup work is excluded.
+struct Sample
+{
+    qint64 ns = 0;
+    quint64 allocations = 0;
+    qint64 ops = 0;
+
+    template<typename Op>
+    void time(Op &&op)
+    {
+        const quint64 allocationsBefore = g_allocations.load(std::memory_order_relaxed);
+        QElapsedTimer timer;
+        timer.start();
+        op();
+        ns += timer.nsecsElapsed();
+        allocations += g_allocations.load(std::memory_order_relaxed) - allocationsBefore;
+        ++ops;
+    }
+
+    QJsonObject toJson(const QString &name) const
+    {
+        QJsonObject result;
+        result["name"] = name;
+        result["ops"] = ops;
+        result["nsPerOp"] = ops ? double(ns) / ops : 0.0;
+        result["allocationsPerOp"] = ops ? double(allocations) / ops : 0.0;
+        return result;
+    }
+};
+
+// The Opera Game (Morphy, 1858) in coordinate notation, replayed through the GUI move path.
+static const char *const operaGame[] = {
+    "e2e4", "e7e5", "g1f3", "d7d6", "d2d4", "c8g4", "d4e5", "g4f3", "d1f3", "d6e5",
+    "f1c4", "g8f6", "f3b3", "d8e7", "b1c3", "c7c6", "c1g5", "b7b5", "c3b5", "c6b5",
+    "c4b5", "b8d7", "e1c1", "a8d8", "d1d7", "d8d7", "h1d1", "e7e6", "b5d7", "f6d7",
+    "b3b8", "d7b8", "d1d8"
+};
+
+static const char *const startFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Perft positions with their leaf counts at perftDepth, see https://www.chessprogramming.org/Perft_Results.
+static const int perftDepth = 3;
+static const struct
+{
+    const char *name;
+    const char *fen;
+    quint64 nodes;
+} perftPositions[] = {
+    {"start", startFen, 8902},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 97862},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 2812},
+};
+
+// Leaf nodes, every move played on a copy of the position.
+static quint64 perftCopyMake(const Position &position, int depth)
+{
+    MoveList moves;
+    MoveGen::generateLegal(position, moves);
+    if (depth == 1)
+        return quint64(moves.size());
+
+    quint64 nodes = 0;
+    for (Move move : moves)
+    {
+        Position next = position;
+        next.makeMove(move);
+        nodes += perftCopyMake(next, depth - 1);
+    }
+    return nodes;
+}
+
+// The same with the mailbox generator, which branches on colour and piece type at run time.
+static quint64 perftMailbox(const Position &position, int depth)
+{
+    MoveList moves;
+    MoveGen::generateLegalMailbox(position, moves);
+    if (depth == 1)
+        return quint64(moves.size());
+
+    quint64 nodes = 0;
+    for (Move move : moves)
+    {
+        Position next = position;
+        next.makeMove(move);
+        nodes += perftMailbox(next, depth - 1);
+    }
+    return nodes;
+}
+
+// Leaf nodes, every move played on the position itself and taken back.
+static quint64 perftMakeUnmake(Position &position, int depth)
+{
+    MoveList moves;
+    MoveGen::generateLegal(position, moves);
+    if (depth == 1)
+        return quint64(moves.size());
+
+    quint64 nodes = 0;
+    Position::Undo undo;
+    for (Move move : moves)
+    {
+        position.makeMove(move, undo);
+        nodes += perftMakeUnmake(position, depth - 1);
+        position.unmakeMove(move, undo);
+    }
+    return nodes;
+}
+
+static QList<CorpusEntry> loadCorpus(const QString &path)
+{
+    QList<CorpusEntry> corpus;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qWarning() << "Cannot open corpus" << path;
+        return corpus;
+    }
+
+    QTextStream in(&file);
+    while (!in.atEnd())
+    {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QStringList fields = line.split('|');
+        if (fields.size() != 3)
+        {
+            qWarning() << "Skipping malformed corpus line:" << line;
+            continue;
+        }
+
+        CorpusEntry entry;
+        entry.name = fields.at(0).trimmed();
+        entry.kind = fields.at(1).trimmed();
+        entry.fen = fields.at(2).trimmed();
+        entry.whiteToMove = entry.fen.section(' ', 1, 1) != "b";
+        corpus.append(entry);
+    }
+
+    return corpus;
+}
+
+static QJsonArray runBenchmarks(const QList<CorpusEntry> &corpus, int iterations)
+{
+    QJsonArray results;
+
+    // FEN round trip on a single board.
+    {
+        ChessBoard board;
+        Sample sample;
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const CorpusEntry &entry : corpus)
+            {
+                sample.time([&] {
+                    board.setFen(entry.fen);
+                    board.getFen(entry.whiteToMove ? 'w' : 'b');
+                });
+            }
+        }
+        results.append(sample.toJson("fen/setFen+getFen"));
+    }
+
+    // FEN round trip through the allocation free reader and writer.
+    {
+        QList<QByteArray> fens;
+        for (const CorpusEntry &entry : corpus)
+            fens.append(entry.fen.toLatin1());
+
+        Position position;
+        char buffer[Fen::BufferSize];
+        Sample sample;
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const QByteArray &fen : fens)
+            {
+                sample.time([&] {
+                    Fen::parse(std::string_view(fen.constData(), std::size_t(fen.size())), position);
+                    Fen::write(position, buffer, sizeof(buffer));
+                });
+            }
+        }
+        results.append(sample.toJson("fen/parse+write"));
+    }
+
+    BenchAlgorithm algorithm;
+    algorithm.newGame();
+
+    // The legal moves the rules worker builds once per turn, and the lookup a click on a piece does.
+    {
+        Sample updateSample;
+        Sample lookupSample;
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const CorpusEntry &entry : corpus)
+            {
+                algorithm.loadPosition(entry.fen, entry.whiteToMove);
+                Position position = algorithm.board()->position();
+                position.sideToMove = entry.whiteToMove ? Position::White : Position::Black;
+                position.refresh();
+                updateSample.time([&] { RulesWorker::legalMoves(0, position); });
+                for (int square = 0; square < 64; ++square)
+                {
+                    quint64 targets = 0;
+                    lookupSample.time([&] {
+                        targets = algorithm.legalTargets(square % 8 + 1, square / 8 + 1)
+                                | algorithm.captureTargets(square % 8 + 1, square / 8 + 1);
+                    });
+                    g_sink.fetch_add(targets, std::memory_order_relaxed);
+                }
+            }
+        }
+        results.append(updateSample.toJson("legalMoves/update"));
+        results.append(lookupSample.toJson("legalMoves/lookup"));
+    }
+
+    // Check detection and the game status of the side to move, as the rules worker reports them.
+    {
+        QList<Position> positions;
+        for (const CorpusEntry &entry : corpus)
+        {
+            algorithm.loadPosition(entry.fen, entry.whiteToMove);
+            Position position = algorithm.board()->position();
+            position.sideToMove = entry.whiteToMove ? Position::White : Position::Black;
+            position.refresh();
+            positions.append(position);
+        }
+
+        Sample checkSample;
+        Sample statusSamples[3];
+        const QStringList kinds = {"mate", "nearmate", "quiet"};
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (qsizetype index = 0; index < corpus.size(); ++index)
+            {
+                const Position &position = positions.at(index);
+                bool check = false;
+                checkSample.time([&] { check = MoveGen::inCheck(position); });
+                g_sink.fetch_add(check, std::memory_order_relaxed);
+
+                const qsizetype kind = kinds.indexOf(corpus.at(index).kind);
+                if (kind < 0)
+                    continue;
+                MoveGen::Status status = MoveGen::Status::Ongoing;
+                statusSamples[kind].time([&] {
+                    MoveList moves;
+                    MoveGen::generateLegal(position, moves);
+                    status = MoveGen::status(position, moves);
+                });
+                g_sink.fetch_add(quint64(status), std::memory_order_relaxed);
+            }
+        }
+        results.append(checkSample.toJson("check"));
+        for (qsizetype kind = 0; kind < kinds.size(); ++kind)
+            results.append(statusSamples[kind].toJson(QStringLiteral("checkMate/%1").arg(kinds.at(kind))));
+    }
+
+    // Notation: every piece from d4 to every square, with and without capture.
+    {
+        const QString pieceTypes = "PNBRQK";
+        Sample toAlgebraicSample;
+        Sample toCoordinatesSample;
+        algorithm.loadPosition(startFen, true);
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (QChar type : pieceTypes)
+            {
+                for (int square = 0; square < 64; ++square)
+                {
+                    const int column = square % 8 + 1;
+                    const int rank = square / 8 + 1;
+                    QString move;
+                    toAlgebraicSample.time([&] {
+                        move = algorithm.toAlgebraic(type, 4, 4, column, rank, square % 2);
+                    });
+                    toCoordinatesSample.time([&] { algorithm.toCoordinates(move); });
+                }
+            }
+        }
+        results.append(toAlgebraicSample.toJson("notation/toAlgebraic"));
+        results.append(toCoordinatesSample.toJson("notation/toCoordinates"));
+    }
+
+    // Full game replay through the highlight lookup and move(), exactly as MainWindow::viewClicked drives it.
+    {
+        Sample sample;
+        int acceptedPlies = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            BenchAlgorithm game;
+            game.newGame();
+            sample.time([&] {
+                acceptedPlies = 0;
+                for (const char *move : operaGame)
+                {
+                    const QPoint from(move[0] - 'a' + 1, move[1] - '0');
+                    const QPoint to(move[2] - 'a' + 1, move[3] - '0');
+                    g_sink.fetch_add(game.legalTargets(from.x(), from.y()), std::memory_order_relaxed);
+                    if (game.move(from, to))
+                        ++acceptedPlies;
+                }
+            });
+        }
+        QJsonObject result = sample.toJson("replay/operaGame");
+        result["plies"] = int(std::size(operaGame));
+        result["acceptedPlies"] = acceptedPlies;
+        results.append(result);
+    }
+
+    // Copy-make against make/unmake, and the generator instantiated per side to move against the
+    // mailbox one. All must find the published node count, and make/unmake must leave the key
+    // the incremental updates produced equal to a key computed from scratch.
+    for (const auto &perft : perftPositions)
+    {
+        Position root;
+        Fen::parse(perft.fen, root);
+
+        Sample copySample;
+        Sample unmakeSample;
+        Sample mailboxSample;
+        quint64 copyNodes = 0;
+        quint64 unmakeNodes = 0;
+        quint64 mailboxNodes = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            copySample.time([&] { copyNodes = perftCopyMake(root, perftDepth); });
+            Position position = root;
+            unmakeSample.time([&] { unmakeNodes = perftMakeUnmake(position, perftDepth); });
+            if (std::memcmp(position.board, root.board, sizeof(root.board)) != 0 || position.key != Zobrist::key(root))
+                qWarning() << "perft" << perft.name << "make/unmake did not restore the position";
+            mailboxSample.time([&] { mailboxNodes = perftMailbox(root, perftDepth); });
+        }
+        if (copyNodes != perft.nodes || unmakeNodes != perft.nodes || mailboxNodes != perft.nodes)
+            qWarning() << "perft" << perft.name << "found" << copyNodes << unmakeNodes << "and" << mailboxNodes << "nodes, expected" << perft.nodes;
+
+        const std::pair<Sample *, const char *> samples[] = {
+            {&copySample, "copyMake"}, {&unmakeSample, "makeUnmake"}, {&mailboxSample, "mailbox"}};
+        for (const auto &[sample, variant] : samples)
+        {
+            QJsonObject result = sample->toJson(QStringLiteral("perft/%1/%2").arg(variant, perft.name));
+            result["depth"] = perftDepth;
+            result["nodes"] = double(perft.nodes);
+            result["nsPerNode"] = sample->ops ? double(sample->ns) / sample->ops / double(perft.nodes) : 0.0;
+            results.append(result);
+        }
+    }
+    qDebug() << "Position is" << sizeof(Position) << "bytes";
+
+    return results;
+}
+
+// PGN parsing against the game database: ns/op is per game, on a single thread.
+static QJsonObject runGameDbBenchmarks(const QString &pgnPath, int iterations, QJsonArray &results)
+{
+    QJsonObject summary;
+    PgnReader reader(pgnPath);
+    reader.setThreadCount(1);
+    if (!reader.open())
+    {
+        qWarning() << "Cannot open" << pgnPath << reader.errorString();
+        return summary;
+    }
+
+    const std::string_view text = reader.data();
+    std::vector<PgnGame> games = reader.readAll();
+    games.erase(std::remove_if(games.begin(), games.end(), [](const PgnGame &game) { return !game.valid; }), games.end());
+    if (games.empty())
+        return summary;
+
+    qint64 plies = 0;
+    for (const PgnGame &game : games)
+        plies += qint64(game.moves.size());
+
+    // Tokenizing and SAN resolution, game by game.
+    {
+        Sample sample;
+        PgnGame game;
+        for (int i = 0; i < iterations; ++i)
+        {
+            std::size_t pos = Pgn::findGameStart(text, 0);
+            while (pos < text.size())
+            {
+                std::size_t used = 0;
+                sample.time([&] { used = Pgn::parseGame(text.substr(pos), game); });
+                pos = Pgn::findGameStart(text, pos + used);
+            }
+        }
+        results.append(sample.toJson("gamedb/pgnParse"));
+    }
+
+    QTemporaryDir dir;
+    const QString dbPath = dir.filePath("games.cgdb");
+    {
+        GameDbWriter writer(dbPath);
+        if (!writer.open())
+        {
+            qWarning() << "Cannot create" << dbPath << writer.errorString();
+            return summary;
+        }
+        for (const PgnGame &game : games)
+            writer.append(game);
+        writer.close();
+    }
+
+    // Encoding alone, without file I/O.
+    {
+        Sample sample;
+        std::vector<std::uint8_t> buffer;
+        buffer.reserve(1024);
+        for (int i = 0; i < iterations; ++i)
+        {
+            for (const PgnGame &game : games)
+            {
+                buffer.clear();
+                sample.time([&] { GameCodec::encode(game.start, game.moves, buffer); });
+            }
+        }
+        results.append(sample.toJson("gamedb/encode"));
+    }
+
+    GameDbReader db(dbPath);
+    if (!db.open())
+    {
+        qWarning() << "Cannot open" << dbPath << db.errorString();
+        return summary;
+    }
+
+    // Decoding from the mapped file, moves are replayed through the move generator.
+    {
+        Sample sample;
+        PgnGame game;
+        game.moves.reserve(512);
+        int decoded = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            decoded = 0;
+            for (qint64 index = 0; index < db.gameCount(); ++index)
+                sample.time([&] { decoded += db.readGame(index, game); });
+        }
+        QJsonObject result = sample.toJson("gamedb/decode");
+        result["decodedGames"] = decoded;
+        results.append(result);
+    }
+
+    summary["games"] = qint64(games.size());
+    summary["plies"] = plies;
+    summary["pgnBytes"] = qint64(text.size());
+    summary["dbBytes"] = db.size();
+    summary["compressionRatio"] = double(text.size()) / double(db.size());
+    qint64 moveBytes = 0;
+    for (qint64 index = 0; index < db.gameCount(); ++index)
+        moveBytes += db.header(index).moveBytes;
+    summary["bitsPerPly"] = plies ? 8.0 * double(moveBytes) / double(plies) : 0.0;
+
+    return summary;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // The rules code logs every generated move; measure the rules and not the terminal.
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    QString corpusPath = "bench/corpus.fen";
+    QString pgnPath = "bench/games.pgn";
+    QString outputPath;
+    int iterations = 20;
+
+    const QStringList args = app.arguments();
+    for (int i = 1; i + 1 < args.size(); i += 2)
+    {
+        if (args.at(i) == "--corpus")
+            corpusPath = args.at(i + 1);
+        else if (args.at(i) == "--pgn")
+            pgnPath = args.at(i + 1);
+        else if (args.at(i) == "--iterations")
+            iterations = qMax(1, args.at(i + 1).toInt());
+        else if (args.at(i) == "--output")
+            outputPath = args.at(i + 1);
+    }
+
+    const QList<CorpusEntry> corpus = loadCorpus(corpusPath);
+    if (corpus.isEmpty())
+        return 1;
+
+    QJsonObject report;
+    report["benchmark"] = "chessbench";
+    report["qtVersion"] = qVersion();
+    report["corpus"] = corpusPath;
+    report["positions"] = corpus.size();
+    report["iterations"] = iterations;
+    QJsonArray results = runBenchmarks(corpus, iterations);
+    report["gamedb"] = runGameDbBenchmarks(pgnPath, iterations, results);
+    report["pgn"] = pgnPath;
+    report["results"] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (outputPath.isEmpty())
+    {
+        QTextStream(stdout) << json;
+        return 0;
+    }
+
+    QFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Cannot write" << outputPath;
+        return 1;
+    }
+    output.write(json);
+
+    return 0;
+}
@@ -1,41 +1,112 @@
 #include "chessalgorithm.h"
 #include "chessboard.h"
+#include "fen.h"
+#include "movegen.h"
+#include "san.h"
+#include "zobrist.h"
+#include <algorithm>
 #include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
 #include <QString>
 #include <QChar>
 
+namespace
+{
+    // Overridden with CHESS_ENGINE_PATH, for example to run chess-mock-engine.
+    const char *const defaultEnginePath = "/opt/homebrew/bin/stockfish";
+    const char *const engineGo = "go depth 3";
+}
+
 ChessAlgorithm::ChessAlgorithm(QObject *parent)
     : QObject{parent}
 {
     m_board = nullptr;
-    m_engine = new UciEngine();
+
+    // One engine process for the whole session, started on the first search.
+    m_enginePath = qEnvironmentVariable("CHESS_ENGINE_PATH", defaultEnginePath);
+    m_analysisLimits = AnalysisCache::limitsFor(m_enginePath.toStdString(), engineGo);
+    m_engine = new UciEngine(this);
+    m_engine->setOption("Hash", "32");
+    m_engine->setOption("Ponder", "true");
+    m_ponderKey = 0;
+    m_pondering = false;
+
+    // Every finished search is cached, so a position is only analysed once across sessions.
+    m_analysisKey = 0;
+    m_analysisGeneration = 0;
+    const QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (!QDir().mkpath(dataPath) || !m_analysisCache.open(dataPath + "/analysis.cache"))
+        qWarning() << "Analysis cache not available:" << m_analysisCache.errorString();
+
+    // Output of a search that was replaced may still be queued, it is not for m_analysisKey.
+    connect(m_engine, &UciEngine::info, this, [this](const UciInfo &info) {
+        if (info.generation == m_analysisGeneration && info.multiPv == 1 && info.scoreType != UciInfo::NoScore)
+            m_analysisInfo = info;
+    });
+    connect(m_engine, &UciEngine::bestMove, this, [this](const UciBestMove &result) {
+        if (result.generation != m_analysisGeneration)
+        {
+            qDebug() << "Dropping the answer of search" << result.generation;
+            return;
+        }
+        m_analysisGeneration = 0;
+        if (result.move.isNull())
+            return;
+        if (m_analysisInfo.scoreType != UciInfo::NoScore && m_analysisInfo.depth > 0)
+        {
+            m_analysisCache.store(m_analysisKey, m_analysisLimits, m_analysisInfo.depth,
+                                  m_analysisInfo.score, m_analysisInfo.scoreType == UciInfo::Mate, result.move,
+                                  m_analysisInfo.pv, m_analysisInfo.pvLength);
+        }
+
+        ++m_ponderStatistics.replies;
+        m_ponderStatistics.replyNs += m_replyTimer.nsecsElapsed();
+        m_ponderStatistics.savedNs += result.ponderedNs;
+
+        char move[6];
+        result.move.writeUci(move);
+        emit engineMove(QString::fromLatin1(move));
+
+        startPondering(result.move);
+    });
 
     m_currentPlayer = NoPlayer;
     m_result = NoResult;
 
-    // En-passent.
-    m_enpassent_black = false;
-    m_enpassent_white = false;
-
-    // Castling.
-    m_whitecastled = false;
-    m_blackcastled = false;
-    m_shortcastle_white = false;
-    m_longcastle_white = false;
-    m_shortcastle_black = false;
-    m_longcastle_black = false;
-    m_whiteCannotCastle = false;
-    m_blackCannotCastle = false;
-
-    // Castling condition.
-    m_whiteRookMoved = false;
-    m_blackRookMoved = false;
-    m_whiteKingMoved = false;
-    m_blackKingMoves = false;
-
-    // Make sure we start with empty moves.
-    m_moves.clear();
-    m_engineMoves.clear();
+    // Rules work gets a thread of its own, results come back queued.
+    qRegisterMetaType<RulesResult>();
+    qRegisterMetaType<RulesHint>();
+    m_rulesGeneration = 0;
+    m_staleResults = 0;
+    m_rulesFallbacks = 0;
+    m_rulesFallbackNs = 0;
+    m_reportedGeneration = 0;
+    m_rulesWorker = new RulesWorker();
+    m_rulesWorker->moveToThread(&m_rulesThread);
+    m_rulesThread.setObjectName("Rules");
+    connect(&m_rulesThread, &QThread::finished, m_rulesWorker, &QObject::deleteLater);
+    connect(m_rulesWorker, &RulesWorker::rulesReady, this, &ChessAlgorithm::rulesReady);
+    connect(m_rulesWorker, &RulesWorker::hintReady, this, [this](const RulesHint &hint) {
+        if (hint.generation != m_rulesGeneration)
+        {
+            ++m_staleResults;
+            return;
+        }
+        char san[San::BufferSize];
+        San::write(m_rulesPosition, hint.move, san);
+        qDebug() << "Hint" << san << "score" << hint.score << "depth" << hint.depth;
+        emit hintReady(QString::fromLatin1(san));
+    });
+    m_rulesThread.start();
+}
+
+ChessAlgorithm::~ChessAlgorithm()
+{
+    // A running hint search stops, so the thread can be joined right away.
+    m_rulesWorker->cancelBefore(m_rulesGeneration + 1);
+    m_rulesThread.quit();
+    m_rulesThread.wait();
 }
 
 ChessBoard* ChessAlgorithm::board() const
@@ -52,7 +123,6 @@ void ChessAlgorithm::setBoard(ChessBoard *board)
     if (m_board)
     {
         delete m_board;
-        delete m_engine;
     }
     m_board = board;
 
@@ -63,7 +133,7 @@ void ChessAlgorithm::setBoard(ChessBoard *board)
 void ChessAlgorithm::setupBoard()
 {
     // Setup a classical chess board with 8 ranks and 8 columns.
-    setBoard(new ChessBoard(8, 8, this));
+    setBoard(new ChessBoard(this));
 }
 
 void ChessAlgorithm::newGame()
@@ -80,6 +150,10 @@ void ChessAlgorithm::newGame()
     // White always takes the first move.
     // We could have other chess variants. In that case we'd need to subclass from ChessAlgorithm.
     setCurrentPlayer(WhitePlayer);
+
+    // The engine clears its hash and history before the next search, a ponder search is stopped by it.
+    m_pondering = false;
+    m_engine->newGame();
 }
 
 void ChessAlgorithm::setResult(Result value)
@@ -99,11 +173,113 @@ void ChessAlgorithm::setResult(Result value)
 
 void ChessAlgorithm::setCurrentPlayer(Player value)
 {
-    if (currentPlayer() == value)
+    // A new game or a loaded position can keep the player, the legal moves are rebuilt anyway.
+    const bool changed = currentPlayer() != value;
+    m_currentPlayer = value;
+    updateLegalMoves();
+
+    if (changed)
+        emit currentPlayerChanged(m_currentPlayer);
+}
+
+/*
+ * Hands a snapshot of the position to the rules worker. Results and hints for earlier snapshots
+ * are no longer wanted: the worker skips them, and those already queued are dropped on arrival.
+ */
+void ChessAlgorithm::updateLegalMoves()
+{
+    m_rules = RulesResult();
+    m_rulesWorker->cancelBefore(++m_rulesGeneration);
+
+    // Without a board or a player there are no legal moves, the empty result stands for them.
+    if (!board() || currentPlayer() == NoPlayer)
+    {
+        m_rulesPosition = Position();
+        m_rulesPosition.clear();
+        m_rules.generation = m_rulesGeneration;
         return;
+    }
 
-    m_currentPlayer = value;
-    emit currentPlayerChanged(m_currentPlayer);
+    // The board passes the move to the other side with every move, as the player does; only a
+    // position loaded with the other side as player needs its key rebuilt.
+    m_rulesPosition = board()->position();
+    const Position::Color side = currentPlayer() == BlackPlayer ? Position::Black : Position::White;
+    if (m_rulesPosition.sideToMove != side)
+    {
+        m_rulesPosition.sideToMove = side;
+        m_rulesPosition.refresh();
+    }
+    QMetaObject::invokeMethod(m_rulesWorker, [worker = m_rulesWorker, generation = m_rulesGeneration, position = m_rulesPosition] {
+        worker->computeRules(generation, position);
+    });
+}
+
+/*
+ * Generating the moves is cheap, so a caller that comes before the worker does it here. The worker
+ * is told to skip that generation instead of doing it twice, and the status is reported once the
+ * caller is done, as it would be when the worker's result arrives.
+ */
+const RulesResult &ChessAlgorithm::rules()
+{
+    if (m_rules.generation != m_rulesGeneration)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        m_rulesWorker->skipRules(m_rulesGeneration);
+        m_rules = RulesWorker::legalMoves(m_rulesGeneration, m_rulesPosition);
+        ++m_rulesFallbacks;
+        m_rulesFallbackNs += timer.nsecsElapsed();
+        qDebug() << "Rules computed on the GUI thread in" << timer.nsecsElapsed() / 1000 << "us, average"
+                 << m_rulesFallbackNs / m_rulesFallbacks / 1000 << "us over" << m_rulesFallbacks << "positions";
+
+        QMetaObject::invokeMethod(this, [this, generation = m_rulesGeneration] {
+            if (generation == m_rulesGeneration)
+                reportStatus();
+        }, Qt::QueuedConnection);
+    }
+    return m_rules;
+}
+
+void ChessAlgorithm::rulesReady(const RulesResult &result)
+{
+    if (result.generation != m_rulesGeneration)
+    {
+        ++m_staleResults;
+        qDebug() << "Dropped rules result" << result.generation << "," << m_staleResults << "stale results,"
+                 << m_rulesFallbacks << "computed on the GUI thread";
+        return;
+    }
+
+    if (m_rules.generation != m_rulesGeneration)
+        m_rules = result;
+    reportStatus();
+}
+
+void ChessAlgorithm::requestHint()
+{
+    if (result() != NoResult || rules().legalMoves.empty())
+        return;
+
+    QMetaObject::invokeMethod(m_rulesWorker, [worker = m_rulesWorker, generation = m_rulesGeneration, position = m_rulesPosition] {
+        worker->searchHint(generation, position);
+    });
+}
+
+Move ChessAlgorithm::legalMove(int colFrom, int rankFrom, int colTo, int rankTo)
+{
+    if (!(legalTargets(colFrom, rankFrom) & (onBoard8(colTo, rankTo) ? quint64(1) << Position::square(colTo, rankTo) : 0)))
+        return Move();
+
+    // The board offers no choice of piece, so of the four promotions only the queen is played.
+    const int from = Position::square(colFrom, rankFrom);
+    const int to = Position::square(colTo, rankTo);
+    for (Move move : rules().legalMoves)
+    {
+        if (move.from() == from && move.to() == to
+            && (move.promotion() == Move::NoPromotion || move.promotion() == Move::Queen))
+            return move;
+    }
+    return Move();
 }
 
 void ChessAlgorithm::setCurrentMove(QString move)
@@ -146,114 +322,63 @@ bool ChessAlgorithm::move(int colFrom, int rankFrom, int colTo, int rankTo)
         return false;
     }
 
-    if (m_moves.count() == 0)
+    // Only moves from the legal moves of this turn are played.
+    const Move legal = legalMove(colFrom, rankFrom, colTo, rankTo);
+    if (legal.isNull())
     {
-        qDebug() << "Stalemate! Draw!";
-    }
-
-    // CAUTION: Here we are doing something non-intuitive!
-    // We need to do the provisional move here.
-    // Whitout emitting something so we don't update the UI.
-    QChar pieceOnToSource = board()->data(colTo, colFrom);
-    board()->setDataInternal(colTo, rankTo, board()->data(colFrom, rankFrom));
-    board()->setDataInternal(colFrom, rankFrom, ' ');
-
-    // If current player is white(black) and wants to make a move
-    // check if black(white) doesn't give a check. So change current player.
-    bool switchplayer = true;
-    if (check(switchplayer))
-    {
-        // Revert the move.
-        board()->setDataInternal(colFrom, rankFrom, board()->data(colTo, rankTo));
-        board()->setDataInternal(colTo, rankTo, pieceOnToSource);
-
-        emit checkYourself();
+        // A move that follows the piece rules but leaves the own king in check.
+        MoveList pseudoLegal;
+        MoveGen::generatePseudoLegal(m_rulesPosition, pseudoLegal);
+        const int from = Position::square(colFrom, rankFrom);
+        const int to = onBoard8(colTo, rankTo) ? Position::square(colTo, rankTo) : -1;
+        if (std::any_of(pseudoLegal.begin(), pseudoLegal.end(), [from, to](Move move) { return move.from() == from && move.to() == to; }))
+            emit checkYourself();
 
         return false;
     }
+    // Now do the REAL move, on the position the move was found in.
+    // The move, en-passant capture and castling rook are announced together once the board is complete.
+    if (board()->position().sideToMove != m_rulesPosition.sideToMove)
+        board()->setPosition(m_rulesPosition);
+    board()->makeMove(legal);
 
-    // Revert the move.
-    board()->setDataInternal(colFrom, rankFrom, board()->data(colTo, rankTo));
-    board()->setDataInternal(colTo, rankTo, pieceOnToSource);
+    // Change the player, the rules worker reports check, mate and stalemate for the opponent.
+    setCurrentPlayer(currentPlayer() == WhitePlayer ? BlackPlayer : WhitePlayer);
 
-    // Now do the REAL move.
-    board()->movePiece(colFrom, rankFrom, colTo, rankTo);
+    return true;
+}
 
-    // Check if the new move gave a check.
-    switchplayer = false;
-    if (check(switchplayer))
-    {
-        // Check if we aren't checkmated.
-        bool checkMate = this->checkMate();
-        if (checkMate && currentPlayer() == ChessAlgorithm::WhitePlayer)
-        {
-            emit gameOver(ChessAlgorithm::WhiteWin);
-        }
-        else if (checkMate && currentPlayer() == ChessAlgorithm::BlackPlayer)
-        {
-            emit gameOver(ChessAlgorithm::BlackWin);
-        }
+// Called once per position, when the worker's result for it arrives or after rules() made it.
+void ChessAlgorithm::reportStatus()
+{
+    // A worker result queued before skipRules() took effect comes on top of the fallback.
+    if (m_reportedGeneration == m_rules.generation)
+        return;
+    m_reportedGeneration = m_rules.generation;
 
-        if (currentPlayer() == BlackPlayer)
-        {
+    switch (m_rules.status)
+    {
+    case MoveGen::Status::Checkmate:
+        setResult(currentPlayer() == WhitePlayer ? BlackWin : WhiteWin);
+        Q_FALLTHROUGH();
+    case MoveGen::Status::Check:
+    {
+        const int king = MoveGen::kingSquare(m_rules.position, m_rules.position.sideToMove);
+        if (currentPlayer() == WhitePlayer)
             board()->setWhiteChecked(true);
-            emit checked(QPoint(5, 8));
-        }
-        else if (currentPlayer() == WhitePlayer)
-        {
+        else
             board()->setBlackChecked(true);
-            emit checked(QPoint(5, 8));
-        }
+        emit checked(QPoint(Position::column(king), Position::rank(king)));
+        break;
     }
-    else
-    {
+    case MoveGen::Status::Stalemate:
         emit unChecked();
+        setResult(StaleMate);
+        break;
+    case MoveGen::Status::Ongoing:
+        emit unChecked();
+        break;
     }
-
-    // Check for en-passent.
-    if (currentPlayer() == WhitePlayer && m_enpassent_white)
-    {
-        board()->setDataInternal(colTo, rankTo - 1, ' ');
-        m_enpassent_white = false;
-    }
-    else if (currentPlayer() == BlackPlayer && m_enpassent_black)
-    {
-        board()->setDataInternal(colTo, rankTo + 1, ' ');
-        m_enpassent_black = false;
-    }
-
-    // White castle.
-    if (m_shortcastle_white && !m_whiteCannotCastle && colTo == 7 && rankTo == 1)
-    {
-        board()->setDataInternal(8, 1, ' ');
-        board()->setDataInternal(6, 1, 'R');
-        m_whitecastled = true;
-    }
-    if (m_longcastle_white && !m_whiteCannotCastle && colTo == 3 && rankTo == 1)
-    {
-        board()->setDataInternal(1, 1, ' ');
-        board()->setDataInternal(4, 1, 'R');
-        m_whitecastled = true;
-    }
-
-    // Black castle.
-    if (m_shortcastle_black && !m_blackCannotCastle && colTo == 7 && rankTo == 8)
-    {
-        board()->setDataInternal(8, 8, ' ');
-        board()->setDataInternal(6, 8, 'r');
-        m_blackcastled = true;
-    }
-    if (m_longcastle_black && !m_blackCannotCastle && colTo == 3 && rankTo == 8)
-    {
-        board()->setDataInternal(1, 8, ' ');
-        board()->setDataInternal(4, 8, 'r');
-        m_blackcastled = true;
-    }
-
-    // Finally change the player.
-    setCurrentPlayer(currentPlayer() == WhitePlayer ? BlackPlayer : WhitePlayer);
-
-    return true;
 }
 
 // Entry function from event click!
@@ -262,810 +387,125 @@ bool ChessAlgorithm::move(const QPoint &from, const QPoint &to)
     QString index;
     QChar source = board()->data(from.x(), from.y());
 
-    // Validate if we can actually castle.
-    if (source == 'K' && to.x() != 7 && to.y() != 1)
-    {
-        m_whiteCannotCastle = true;
-    }
-    if (source == 'K' && to.x() != 3 && to.y() != 1)
-    {
-        m_whiteCannotCastle = true;
-    }
-    if (source == 'k' && to.x() != 7 && to.y() != 8)
-    {
-        m_blackCannotCastle = true;
-    }
-    if (source == 'k' && to.x() != 3 && to.y() != 8)
-    {
-        m_blackCannotCastle = true;
-    }
-    if (source == 'R' && to.x() != 6)
-    {
-        m_whiteCannotCastle = true;
-    }
-    if (source == 'R' && to.x() != 4)
-    {
-        m_whiteCannotCastle = true;
-    }
-    if (source == 'r' && to.x() != 6)
-    {
-        m_blackCannotCastle = true;
-    }
-    if (source == 'r' && to.x() != 4)
-    {
-        m_blackCannotCastle = true;
-    }
-
     // Check if we are within the board.
-    if (!onBoard(to.x(), to.y())) return false;
+    if (!onBoard8(to.x(), to.y())) return false;
 
-    // Check if there will be a capture.
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-
-    QChar toField = board()->data(to.x(), to.y());
-
-    // Check if we can take or not.
-    if (currentPlayer() == WhitePlayer)
+    // Check if we can take or not, en-passant included.
+    const bool canTake = captureTargets(from.x(), from.y()) & quint64(1) << Position::square(to.x(), to.y());
+    if (!canTake && (source == 'K' || source == 'k') && from.x() == 5 && to.x() == 7)
     {
-        if (blackPieces.contains(toField) || m_enpassent_white)
-        {
-            index = toAlgebraic(source, from.x(), from.y(), to.x(), to.y(), true);
-        }
-        else if (source == 'K' && from.x() == 5 && to.x() == 7)
-        {
-            index = toAlgebraicCastle(source, from.x(), from.y(), to.x(), to.y(), true);
-        }
-        else
-        {
-            index = toAlgebraic(source, from.x(), from.y(), to.x(), to.y(), false);
-        }
+        index = toAlgebraicCastle(source, from.x(), from.y(), to.x(), to.y(), true);
     }
-    else if (m_currentPlayer == BlackPlayer)
+    else
     {
-        if (whitePieces.contains(toField) || m_enpassent_black)
-        {
-            index = toAlgebraic(source, from.x(), from.y(), to.x(), to.y(), true);
-        }
-        else if (source == 'k' && from.x() == 5 && to.x() == 7)
-        {
-            index = toAlgebraicCastle(source, from.x(), from.y(), to.x(), to.y(), true);
-        }
-        else
-        {
-            index = toAlgebraic(source, from.x(), from.y(), to.x(), to.y(), false);
-        }
+        index = toAlgebraic(source, from.x(), from.y(), to.x(), to.y(), canTake);
     }
-    // Now we try to do the actual move.
-    if (m_moves.contains(index))
-    {
-        setCurrentMove(index);
 
-        return move(from.x(), from.y(), to.x(), to.y());
-    }
+    // Now we try to do the actual move, move() only plays it when it is one of the legal moves of this turn.
+    if (!legalMove(from.x(), from.y(), to.x(), to.y()).isNull())
+        setCurrentMove(index);
 
-    return false;
+    return move(from.x(), from.y(), to.x(), to.y());
 }
 
 void ChessAlgorithm::setEngineMoves(QString fen)
 {
-    m_engine->startEngine("/opt/homebrew/bin/stockfish");
-    m_engine->sendCommand("uci");
-    m_engine->sendCommand("setoption name Hash value 32");
-    m_engine->sendCommand("isready");
-    m_engine->sendCommand("ucinewgame");
-    m_engine->sendCommand("position fen " + fen);
-    m_engine->sendCommand("go depth 3");
-}
-
-void ChessAlgorithm::setMoves(int colFrom, int rankFrom)
-{
-    // Make sure we don't have any old moves.
-    if (!m_moves.empty()) m_moves.clear();
-
-    QChar source = board()->data(colFrom, rankFrom);
-    switch (source.toLatin1())
-    {
-    case 'P': case 'p':
-        setPawnMoves(source, colFrom, rankFrom);
-        break;
-    case 'N': case 'n':
-        setKnightMoves(source, colFrom, rankFrom);
-        break;
-    case 'B': case 'b':
-        setBishopMoves(source, colFrom, rankFrom);
-        break;
-    case 'R': case 'r':
-        setRookMoves(source, colFrom, rankFrom);
-        break;
-    case 'Q': case 'q':
-        setQueenMoves(source, colFrom, rankFrom);
-        break;
-    case 'K': case 'k':
-        setKingMoves(source, colFrom, rankFrom);
-        break;
-    }
-}
-
-void ChessAlgorithm::setQueenMoves(QChar piece, int colFrom, int rankFrom)
-{
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-    QString move = "";
-    int colTo, rankTo;
-
-    for (int ranks=-1; ranks<2; ranks++)
-    {
-         for(int cols=-1; cols<2; cols++)
-         {
-             for(size_t i=1; i<8; i++)
-             {
-
-                 colTo = colFrom + (cols * i);
-                 rankTo = rankFrom + (ranks * i);
-
-                 // Check if on board.
-                 if (onBoard(colTo, rankTo))
-                 {
-                     // Check what is on that field.
-                     QChar toField = board()->data(colTo, rankTo);
-
-                     // Field must be empty and NOT contain a white piece.
-                     if (piece == 'Q')
-                     {
-                         if (whitePieces.contains(toField))
-                         {
-                             qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                             break;
-                         }
-                         if (toField == ' ' || !whitePieces.contains(toField))
-                         {
-                             toField = board()->data(colTo, rankTo);
-                             if (blackPieces.contains(toField))
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                 qDebug() << "[Log] Legal move. Capture of black piece.";
-                                 m_moves[move] = false;
-                                 break;
-                             }
-                             else
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                 qDebug() << "[Log] Legal move. To empty place.";
-
-                             }
-                             m_moves[move] = false;
-                         }
-                         else
-                         {
-                             qDebug() << "[Log] Illegal position for Queen.";
-                             break;
-                         }
-                     }
-                     if (piece == 'q')
-                     {
-                         if (blackPieces.contains(toField))
-                         {
-                             qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                             break;
-                         }
-                         if (toField == ' ' || !blackPieces.contains(toField))
-                         {
-                             toField = board()->data(colTo, rankTo);
-                             if (whitePieces.contains(toField))
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                 qDebug() << "[Log] Legal move. Capture of black piece.";
-                                 m_moves[move] = false;
-                                 break;
-                             }
-                             else
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                 qDebug() << "[Log] Legal move. To empty place.";
-
-                             }
-                             m_moves[move] = false;
-                         }
-                         else
-                         {
-                             qDebug() << "[Log] Illegal position for Queen.";
-                             break;
-                         }
-                     }
-                 }
-             }
-         }
-    }
-}
-
-void ChessAlgorithm::setKingMoves(QChar piece, int colFrom, int rankFrom)
-{
-
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-    QString move = "";
-    int colTo, rankTo;
-
-    for (int ranks=-1; ranks<2; ranks++)
-    {
-         for(int cols=-1; cols<2; cols++)
-         {
-             for(size_t i=1; i<2; i++)
-             {
-
-                 colTo = colFrom + (cols * i);
-                 rankTo = rankFrom + (ranks * i);
-
-                 // Check if on board.
-                 if (onBoard(colTo, rankTo))
-                 {
-                     // Check what is on that field.
-                     QChar toField = board()->data(colTo, rankTo);
-
-                     // Field must be empty and NOT contain a white piece.
-                     if (piece == 'K')
-                     {
-                         if (whitePieces.contains(toField))
-                         {
-                             qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                             break;
-                         }
-                         if (toField == ' ' || !whitePieces.contains(toField))
-                         {
-                             toField = board()->data(colTo, rankTo);
-                             if (blackPieces.contains(toField))
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                 qDebug() << "[Log] Legal move. Capture of black piece.";
-                             }
-                             else
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                 qDebug() << "[Log] Legal move. To empty place.";
-
-                             }
-                             m_moves[move] = false;
-                         }
-                         else
-                         {
-                             qDebug() << "[Log] Illegal position for Queen.";
-                         }
-                     }
-                     if (piece == 'k')
-                     {
-                         if (blackPieces.contains(toField))
-                         {
-                             qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                             break;
-                         }
-                         if (toField == ' ')
-                         {
-                             toField = board()->data(colTo, rankTo);
-                             if (whitePieces.contains(toField))
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                 qDebug() << "[Log] Legal move. Capture of black piece.";
-                             }
-                             else
-                             {
-                                 move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                 qDebug() << "[Log] Legal move. To empty place.";
-
-                             }
-                             m_moves[move] = false;
-                         }
-                         else
-                         {
-                             qDebug() << "[Log] Illegal position for Queen.";
-                         }
-                     }
-                 }
-             }
-         }
-    }
-
-    for (int cols=1; cols<3; cols++)
+    Position position;
+    const QByteArray latin = fen.toLatin1();
+    if (Fen::parse(std::string_view(latin.constData(), std::size_t(latin.size())), position) != Fen::Error::None)
     {
-        colTo = colFrom + cols;
-        rankTo = rankFrom;
-
-        if (onBoard(colTo, rankTo))
-        {
-            if (piece == 'K' || piece == 'k')
-            {
-                QChar toField = board()->data(colTo, rankTo);
-                if (toField == ' ')
-                {
-                    if (piece == 'K' && !m_whiteCannotCastle)
-                    {
-                        move = toAlgebraicCastle('K', colFrom, rankFrom, colTo, rankTo, true);
-                    }
-                    else if (piece == 'k' && !m_blackCannotCastle)
-                    {
-                        move = toAlgebraicCastle('k', colFrom, rankFrom, colTo, rankTo, true);
-                    }
-
-                    // Check short castle colour.
-                    if (move.contains("0-0"))
-                    {
-                       m_shortcastle_white = true;
-                    }
-                    if (move.contains("0-0"))
-                    {
-                       m_shortcastle_black = true;
-                    }
-                    m_moves[move] = false;
-                }
-            }
-        }
+        qWarning() << "Cannot analyse" << fen;
+        return;
     }
 
-    // Long castle.
-    for (int cols=-2; cols<0; cols++)
+    // A cached result is answered right away, the engine is not involved.
+    const quint64 key = Zobrist::key(position);
+    AnalysisCacheEntry cached;
+    if (m_analysisCache.lookup(key, m_analysisLimits, cached))
     {
-        colTo = colFrom + cols;
-        rankTo = rankFrom;
-        if (onBoard(colTo, rankTo))
+        // The cache answers for a ponder search as well, it would otherwise wait for a ponderhit forever.
+        if (m_pondering)
         {
-            // Field must be empty and NOT contain a white piece.
-            if (piece == 'K' || piece == 'k')
-            {
-                QChar toField = board()->data(colTo, rankTo);
-                if (toField == ' ')
-                {
-                    colTo = colFrom - 2;
-                    rankTo = rankFrom;
-                    if (piece == 'K' && !m_whiteCannotCastle)
-                    {
-                       move = toAlgebraic('K', colFrom, rankFrom, colTo, rankTo, false);
-                    }
-                    else if (piece == 'k' && !m_blackCannotCastle)
-                    {
-                       move = toAlgebraic('k', colFrom, rankFrom, colTo, rankTo, false);
-                    }
-
-                    // Check long castle colour.
-                    if (move.contains("Kc1"))
-                    {
-                       m_longcastle_white = true;
-                    }
-                    if (move.contains("Kc8"))
-                    {
-                       m_longcastle_black = true;
-                    }
-                    m_moves[move] = false;
-                }
-            }
+            m_pondering = false;
+            if (key == m_ponderKey)
+                ++m_ponderStatistics.hits;
+            else
+                ++m_ponderStatistics.misses;
+            m_engine->stopSearch();
         }
-    }
-}
-
-void ChessAlgorithm::setKnightMoves(QChar piece, int colFrom, int rankFrom)
-{
+        m_analysisGeneration = 0;
 
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-    QString move = "";
-
-    if (piece == 'N' || piece == 'n')
-    {
-        int colTo, rankTo, x, y;
+        const AnalysisCache::Statistics statistics = m_analysisCache.statistics();
+        qDebug() << "Analysis cache hit, hit rate" << QString::number(statistics.hitRate() * 100.0, 'f', 1) << "%";
 
-        // Knight has 8 possible moves.
-        for (size_t i=0; i<8; i++)
-        {
-            switch (i)
-            {
-            case 0:
-                x = 1;
-                y = 2;
-                break;
-            case 1:
-                x = 1;
-                y = -2;
-                break;
-
-            case 2:
-                x = -1;
-                y = 2;
-                break;
-
-            case 3:
-                x = -1;
-                y = -2;
-                break;
-
-            case 4:
-                x = 2;
-                y = 1;
-                break;
-
-            case 5:
-                x = 2;
-                y = -1;
-                break;
-
-            case 6:
-                x = -2;
-                y = 1;
-                break;
-
-            case 7:
-                x = -2;
-                y = -1;
-                break;
-            }
-            colTo = colFrom + x;
-            rankTo = rankFrom + y;
-
-            // Check if on board.
-            if (onBoard(colTo, rankTo))
-            {
-                // Check what is on that field.
-                QChar toField = board()->data(colTo, rankTo);
-                // Field must be empty and NOT contain a white piece.
-                if (piece == 'N')
-                {
-                    if (toField == ' ' || !whitePieces.contains(toField))
-                    {
-                        toField = board()->data(colTo, rankTo);
-                        if (blackPieces.contains(toField))
-                        {
-                            move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                            qDebug() << "[Log] Legal move. Capture of black piece.";
-                        }
-                        else
-                        {
-                            move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                            qDebug() << "[Log] Legal move. To empty place.";
-
-                        }
-                        m_moves[move] = false;
-                    }
-                }
-                else if (piece == 'n')
-                {
-                    if (toField == ' ' || !blackPieces.contains(toField))
-                    {
-                        if (whitePieces.contains(toField))
-                        {
-                            move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                            qDebug() << "[Log] Legal move. Capture of white piece.";
-                        }
-                        else
-                        {
-                            move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                            qDebug() << "[Log] Legal move. To empty place.";
-
-                        }
-                        m_moves[move] = false;
-                    }
-                }
-            }
-            else
-            {
-                qDebug() << "[Error] Illegal move. Off board.";
-            }
-        }
+        char move[6];
+        Move::fromData(cached.bestMove).writeUci(move);
+        emit engineMove(QString::fromLatin1(move));
+        return;
     }
-}
-
-void ChessAlgorithm::setBishopMoves(QChar piece, int colFrom, int rankFrom)
-{
 
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-    QString move = "";
-    int colTo, rankTo;
+    m_replyTimer.start();
 
-    for (int ranks=-1; ranks<2; ranks++)
+    // The position the engine ponders on turns the ponder search into the real one.
+    if (m_pondering && key == m_ponderKey)
     {
-        for(int cols=-1; cols<2; cols++)
-        {
-            for(size_t i=1; i<8; i++)
-            {
-
-                colTo = colFrom + (cols * i);
-                rankTo = rankFrom + (ranks * i);
-
-                // Make sure the bishop is moving diagonally.
-                bool sameCol = colTo == colFrom;
-                bool sameRank = rankTo == rankFrom;
-
-                // Check if on board.
-                if (onBoard(colTo, rankTo))
-                {
-                    // Check what is on that field.
-                    QChar toField = board()->data(colTo, rankTo);
-
-                    // Field must be empty and NOT contain a white piece.
-                    if (piece == 'B')
-                    {
-                        if (sameCol)
-                        {
-                            qDebug() << "[Log] Illegal move. Same column.";
-                            break;
-                        }
-                        if (sameRank)
-                        {
-                            qDebug() << "[Log] Illegal move. Same rank.";
-                            break;
-                        }
-                        if (whitePieces.contains(toField))
-                        {
-                            qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                            break;
-                        }
-                        if (toField == ' ' || !whitePieces.contains(toField))
-                        {
-                            toField = board()->data(colTo, rankTo);
-                            if (blackPieces.contains(toField))
-                            {
-                                move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                qDebug() << "[Log] Legal move. Capture of black piece.";
-                                m_moves[move] = false;
-                                break;
-                            }
-                            else
-                            {
-                                move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                qDebug() << "[Log] Legal move. To empty place.";
-
-                            }
-                            m_moves[move] = false;
-                        }
-                        else
-                        {
-                            qDebug() << "[Log] Illegal position for Bisshop.";
-                        }
-                    }
-                    else if (piece == 'b')
-                    {
-                        if (sameCol)
-                        {
-                            qDebug() << "[Log] Illegal move. Same column.";
-                            break;
-                        }
-                        if (sameRank)
-                        {
-                            qDebug() << "[Log] Illegal move. Same rank.";
-                            break;
-                        }
-                        if (blackPieces.contains(toField))
-                        {
-                            qDebug() << "[Log] Illegal move. Bumped on piece of same colour.";
-                            break;
-                        }
-                        if (toField == ' ' || !blackPieces.contains(toField))
-                        {
-                            if (whitePieces.contains(toField))
-                            {
-                                move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                qDebug() << "[Log] Legal move. Capture of white piece.";
-                                m_moves[move] = false;
-                                break;
-                            }
-                            else
-                            {
-                                move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                qDebug() << "[Log] Legal move. To empty place.";
-
-                            }
-                            m_moves[move] = false;
-                        }
-                        else
-                        {
-                            qDebug() << "[Log] Illegal position for Bisshop.";
-                            break;
-                        }
-                    }
-                }
-                else
-                {
-                    qDebug() << "[Error] Illegal move. Off board.";
-                }
-            }
-        }
+        m_pondering = false;
+        ++m_ponderStatistics.hits;
+        m_analysisGeneration = m_engine->analyse(m_ponderFen, engineGo);
+        return;
     }
-}
-
-void ChessAlgorithm::setRookMoves(QChar piece, int colFrom, int rankFrom)
-{
-    QString whitePieces = "PRNBQK";
-    QString blackPieces = "prnbqk";
-    QString move = "";
-    int colTo, rankTo;
-
-    for (int rank=-1; rank<2; rank++)
+    if (m_pondering)
     {
-        for(int col=-1; col<2; col++)
-        {
-            if (rank != col && rank != (-col))
-            {
-                for (size_t i=1; i<8; i++)
-                {
-                    colTo = colFrom + (col * i);
-                    rankTo = rankFrom + (rank * i);
-
-                    // Check if on board.
-                    if (onBoard(colTo, rankTo))
-                    {
-                        // Check what is on that field.
-                        QChar toField = board()->data(colTo, rankTo);
-
-                        // Field must be empty and NOT contain a white piece.
-                        if (piece == 'R')
-                        {
-                            if (whitePieces.contains(toField))
-                            {
-                                qDebug() << "[Log] Illegal move. Bumped on white piece.";
-                                break;
-                            }
-                            if (toField == ' ' || !whitePieces.contains(toField))
-                            {
-                                toField = board()->data(colTo, rankTo);
-                                if (blackPieces.contains(toField))
-                                {
-                                    move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                    qDebug() << "[Log] Legal move. Capture of black piece.";
-                                    m_moves[move] = false;
-                                    break;
-                                }
-                                else
-                                {
-                                    move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                    qDebug() << "[Log] Legal move. To empty place.";
-
-                                }
-                                m_moves[move] = false;
-                            }
-                            else
-                            {
-                                qDebug() << "[Log] Illegal position for rook.";
-                            }
-                        }
-                        else if (piece == 'r')
-                        {
-                            if (toField == ' ' || !blackPieces.contains(toField))
-                            {
-                                toField = board()->data(colTo, rankTo);
-                                if (whitePieces.contains(toField))
-                                {
-                                    move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, true);
-                                    qDebug() << "[Log] Legal move. Capture of white piece.";
-                                    m_moves[move] = false;
-                                    break;
-                                }
-                                else
-                                {
-                                    move = toAlgebraic(piece, colFrom, rankFrom, colTo, rankTo, false);
-                                    qDebug() << "[Log] Legal move. To empty place.";
-
-                                }
-                                m_moves[move] = false;
-                            }
-                            else
-                            {
-                                qDebug() << "[Log] Illegal position for rook.";
-                                break;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        qDebug() << "[Error] Illegal move. Off board.";
-                    }
-                }
-            }
-        }
+        m_pondering = false;
+        ++m_ponderStatistics.misses;
     }
+
+    // Starting is a no-op once the engine runs, a search still running for an older position is stopped.
+    m_analysisKey = key;
+    m_analysisPosition = position;
+    m_analysisInfo = UciInfo();
+    m_engine->startEngine(m_enginePath);
+    m_analysisGeneration = m_engine->analyse(fen, engineGo);
 }
 
-void ChessAlgorithm::setPawnMoves(QChar piece, int colFrom, int rankFrom)
+// Assumes the player follows the suggestion, the engine searches the reply in the meantime.
+void ChessAlgorithm::startPondering(Move expected)
 {
-    QString move = "";
-    if (piece == 'P')
+    // The engine may answer with anything, only a legal move is played on the copy.
+    MoveList moves;
+    MoveGen::generateLegal(m_analysisPosition, moves);
+    if (std::find(moves.begin(), moves.end(), expected) == moves.end())
     {
-        if (rankFrom == 2)
-        {
-            if (board()->data(colFrom, rankFrom + 2) == ' ')
-            {
-                move = toAlgebraic(piece, colFrom, rankFrom, colFrom, rankFrom + 2, false);
-                m_moves[move] = false;
-            }
-        }
-        if (board()->data(colFrom, rankFrom + 1) == ' ')
-        {
-            move = toAlgebraic(piece, colFrom, rankFrom, colFrom, rankFrom + 1, false);
-            m_moves[move] = false;
-        }
-        // Add take moves.
-        bool leftOnBoard = this->onBoard(colFrom - 1, rankFrom + 1);
-        QChar leftTake = board()->data(colFrom - 1, rankFrom + 1);
-
-        bool rightOnBoard = this->onBoard(colFrom + 1, rankFrom + 1);
-        QChar rightTake = board()->data(colFrom + 1, rankFrom + 1);
-
-        QString whitePieces = "PRNBQK";
-        if (leftOnBoard && leftTake != ' ' && !whitePieces.contains(leftTake))
-        {
-            move = toAlgebraic(piece, colFrom, rankFrom, colFrom - 1, rankFrom + 1, true);
-            m_moves[move] = false;
-        }
-        else if (rightOnBoard && rightTake != ' ' && !whitePieces.contains(rightTake))
-        {
-            move = toAlgebraic(piece, colFrom, rankFrom, colFrom + 1, rankFrom + 1, true);
-            m_moves[move] = false;
-        }
-        // En passant.
-        leftTake = board()->data(colFrom - 1, rankFrom);
-        rightTake = board()->data(colFrom + 1, rankFrom);
-        if (rankFrom == 5)
-        {
-            if (leftTake != ' ' && !whitePieces.contains(leftTake))
-            {
-                move = toAlgebraic(piece, colFrom, rankFrom, colFrom - 1, rankFrom + 1, true);
-                m_moves[move] = false;
-                m_enpassent_white = true;
-            }
-            else if (rightTake != ' ' && !whitePieces.contains(rightTake))
-            {
-                move = toAlgebraic(piece, colFrom, rankFrom, colFrom + 1, rankFrom + 1, true);
-                m_moves[move] = false;
-                m_enpassent_white = true;
-            }
-        }
+        qWarning() << "Not pondering after an illegal engine move";
+        return;
     }
-    else if (piece == 'p')
-    {
-        if (board()->data(colFrom, rankFrom - 1) == ' ') {
-            move = toAlgebraic(piece, colFrom, rankFrom, colFrom, rankFrom - 1, false);
-            m_moves[move] = false;
-        }
-        if (rankFrom == 7)
-        {
-            if (board()->data(colFrom, rankFrom - 2) == ' ')
-            {
-                QString move = toAlgebraic(piece, colFrom, rankFrom, colFrom, rankFrom - 2, false);
-                m_moves[move] = false;
-            }
-        }
 
-        // Add take moves.
-        QChar leftTake = board()->data(colFrom + 1, rankFrom - 1);
-        QChar rightTake = board()->data(colFrom - 1, rankFrom - 1);
-        QString blackPieces = "prnbqk";
-        if (leftTake != ' ' && !blackPieces.contains(leftTake))
-        {
-            QString move = toAlgebraic(piece, colFrom, rankFrom, colFrom + 1, rankFrom - 1, true);
-            m_moves[move] = false;
-        }
-        else if (rightTake != ' ' && !blackPieces.contains(rightTake))
-        {
-            QString move = toAlgebraic(piece, colFrom, rankFrom, colFrom - 1, rankFrom - 1, true);
-            m_moves[move] = false;
-        }
+    Position next = m_analysisPosition;
+    next.makeMove(expected);
 
-        // En passant.
-        leftTake = board()->data(colFrom - 1, rankFrom);
-        rightTake = board()->data(colFrom + 1, rankFrom);
-        if (rankFrom == 4)
-        {
-            if (leftTake != ' ' && !blackPieces.contains(leftTake))
-            {
-                move = toAlgebraic(piece, colFrom, rankFrom, colFrom - 1, rankFrom - 1, true);
-                m_enpassent_black = true;
-                m_moves[move] = false;
-            }
-            else if (rightTake != ' ' && !blackPieces.contains(rightTake))
-            {
-                move = toAlgebraic(piece, colFrom, rankFrom, colFrom + 1, rankFrom - 1, true);
-                m_enpassent_black = true;
-                m_moves[move] = false;
-            }
-        }
-    }
+    moves.clear();
+    MoveGen::generateLegal(next, moves);
+    const quint64 key = Zobrist::key(next);
+    AnalysisCacheEntry cached;
+    if (moves.empty() || m_analysisCache.lookup(key, m_analysisLimits, cached))
+        return;
+
+    char fen[Fen::BufferSize];
+    const std::size_t length = Fen::write(next, fen, sizeof(fen));
+    m_ponderFen = QString::fromLatin1(fen, qsizetype(length));
+    m_ponderKey = key;
+    m_pondering = true;
+    ++m_ponderStatistics.ponders;
+
+    // Its results belong to the pondered position.
+    m_analysisKey = key;
+    m_analysisPosition = next;
+    m_analysisInfo = UciInfo();
+    m_analysisGeneration = m_engine->ponder(m_ponderFen, engineGo);
+
+    qDebug() << "Pondering on" << m_ponderFen << "hit rate" << QString::number(m_ponderStatistics.hitRate() * 100.0, 'f', 1)
+             << "% saved" << m_ponderStatistics.savedNs / 1000000 << "ms, average reply"
+             << m_ponderStatistics.replyNs / qMax<qint64>(1, m_ponderStatistics.replies) / 1000000 << "ms";
 }
 
 // Converts a chess move to algebraic notation.
@@ -1177,271 +617,3 @@ QPoint ChessAlgorithm::toCoordinates(QString move)
 
     return QPoint(colTo, rankTo);
 }
-
-bool ChessAlgorithm::onBoard(int colTo, int rankTo)
-{
-    bool onBoard = false;
-    if (colTo < 1 || colTo > board()->columns())
-    {
-        return onBoard;
-    }
-    if (rankTo < 1 || rankTo > board()->ranks())
-    {
-        return onBoard;
-    }
-
-    return true;
-}
-
-bool ChessAlgorithm::check(bool switchplayer)
-{   
-    // Store the current values.
-    bool enpassentWhite = m_enpassent_white;
-    bool enpassentBlack = m_enpassent_black;
-    bool shortcastleWhite = m_shortcastle_white;
-    bool longcastleWhite = m_longcastle_white;
-
-    bool shortcastle_white = m_shortcastle_white;
-    bool longcastle_white = m_longcastle_white;
-    bool shortcastle_black = m_shortcastle_black;
-    bool longcastle_black = m_longcastle_black;
-
-    QString pieces = "PRNBQK";
-    if (switchplayer)
-    {
-        if (currentPlayer() == WhitePlayer)
-        {
-            m_copy_currentPlayer = BlackPlayer;
-            pieces = "prnbqk";
-        }
-    }
-    else if (!switchplayer)
-    {
-        if (currentPlayer() == BlackPlayer)
-        {
-            m_copy_currentPlayer = BlackPlayer;
-            pieces = "prnbqk";
-        }
-    }
-
-    QHash<QPoint, QChar> pos;
-
-    // The current board setup without the outpost which is from.
-    for (auto piece: pieces)
-    {
-        pos.insert(board()->points(piece));
-    }
-
-    // Remove any old moves.
-    if (!m_moves.empty()) m_moves.clear();
-
-    for (auto iter = pos.constBegin(); iter != pos.constEnd(); ++iter)
-    {
-        QChar source = iter.value();
-        QPoint p = iter.key();
-        switch (source.toLatin1())
-        {
-        case 'P': case 'p':
-            setPawnMoves(source, p.x(), p.y());
-            break;
-        case 'N': case 'n':
-            setKnightMoves(source, p.x(), p.y());
-            break;
-        case 'B': case 'b':
-            setBishopMoves(source, p.x(), p.y());
-            break;
-        case 'R': case 'r':
-            setRookMoves(source, p.x(), p.y());
-            break;
-        case 'Q': case 'q':
-            setQueenMoves(source, p.x(), p.y());
-            break;
-        case 'K': case 'k':
-            setKingMoves(source, p.x(), p.y());
-            break;
-        }
-    }
-
-    // Revert.
-    if (enpassentWhite != m_enpassent_white)
-        m_enpassent_white = enpassentWhite;
-    if (enpassentBlack != m_enpassent_black)
-        m_enpassent_black = enpassentBlack;
-    if (shortcastleWhite != m_shortcastle_white)
-        m_shortcastle_white = shortcastleWhite;
-    if (longcastleWhite != m_longcastle_white)
-        m_longcastle_white = longcastleWhite;
-
-    if (shortcastle_white != m_shortcastle_white)
-        m_shortcastle_white = shortcastle_white;
-    if (longcastle_white != m_longcastle_white)
-        m_longcastle_white = longcastle_white;
-    if (shortcastle_black != m_shortcastle_black)
-        m_shortcastle_black = shortcastle_black;
-    if (longcastle_black != m_longcastle_black)
-        m_longcastle_black = longcastle_black;
-
-
-    // Get the current position of Black King.
-    QPoint p = board()->point('k');
-    if (m_copy_currentPlayer == BlackPlayer)
-        p = board()->point('K');
-    QString kingPos =  QChar('a' + p.y() - 1) + QString::number(p.x());
-
-    bool check = false;
-    const QList keys = m_moves.keys();
-
-    // Removed warning based on https://stackoverflow.com/questions/35811053/using-c11-range-based-for-loop-correctly-in-qt
-    for (auto&&item: keys)
-    {
-        // We need the current position of the King.
-        if (item.contains(kingPos))
-        {
-            qDebug() << "Check!";
-            check = true;
-            break;
-        }
-    }
-
-    // Revert the player.
-    if (switchplayer)
-    {
-        if (m_copy_currentPlayer == BlackPlayer)
-        {
-            m_copy_currentPlayer = WhitePlayer;
-        }
-    }
-
-    return check;
-}
-
-bool ChessAlgorithm::checkMate()
-{
-    QString pieces = "prnbqk";
-    if (currentPlayer() == BlackPlayer)
-    {
-        pieces = "PRNBQK";
-    }
-
-    QHash<QPoint, QChar> pos;
-    for (auto piece: pieces)
-    {
-        pos.insert(board()->points(piece));
-    }
-
-    if (!m_moves.empty()) m_moves.clear();
-    for (auto iter = pos.constBegin(); iter != pos.constEnd(); ++iter)
-    {
-        QChar source = iter.value();
-        QPoint from = iter.key();
-        switch (source.toLatin1())
-        {
-        case 'P': case 'p':
-            setPawnMoves(source, from.x(), from.y());
-            break;
-        case 'N': case 'n':
-            setKnightMoves(source, from.x(), from.y());
-            break;
-        case 'B': case 'b':
-            setBishopMoves(source, from.x(), from.y());
-            break;
-        case 'R': case 'r':
-            setRookMoves(source, from.x(), from.y());
-            break;
-        case 'Q': case 'q':
-            setQueenMoves(source, from.x(), from.y());
-            break;
-        case 'K': case 'k':
-            setKingMoves(source, from.x(), from.y());
-            break;
-        }
-
-        QHash<QString, bool> m_potential_moves = m_moves;
-        if (!m_moves.empty()) m_moves.clear();
-
-        // Get the current position of the piece.
-        for (auto i=m_potential_moves.cbegin(), end=m_potential_moves.cend(); i != end; i++)
-        {
-            // Do the move and call check().
-            QPoint to = toCoordinates(i.key());
-            qDebug() << "From " << from << " to " << to;
-
-            // Do the "UNREAL" move.
-            QChar pieceOnToSource = board()->data(to.x(), to.y());
-            board()->setDataInternal(to.x(), to.y(), board()->data(from.x(), from.y()));
-            board()->setDataInternal(from.x(), from.y(), ' ');
-
-            // Get all current positions of the current player.
-            pieces = "PRNBQK";
-            if (currentPlayer() == BlackPlayer)
-            {
-                pieces = "prnbqk";
-            }
-            QHash<QPoint, QChar> otherPos;
-            for (auto piece: pieces)
-            {
-                otherPos.insert(board()->points(piece));
-            }
-            // For each of these positions get all possible moves and check if that move delivers a check.
-            // If not, this can't be a checkmate.
-            for (auto iter = otherPos.constBegin(); iter != otherPos.constEnd(); ++iter)
-            {
-                source = iter.value();
-                QPoint pt = iter.key();
-                switch (source.toLatin1())
-                {
-                case 'P': case 'p':
-                    setPawnMoves(source, pt.x(), pt.y());
-                    break;
-                case 'N': case 'n':
-                    setKnightMoves(source, pt.x(), pt.y());
-                    break;
-                case 'B': case 'b':
-                    setBishopMoves(source, pt.x(), pt.y());
-                    break;
-                case 'R': case 'r':
-                    setRookMoves(source, pt.x(), pt.y());
-                    break;
-                case 'Q': case 'q':
-                    setQueenMoves(source, pt.x(), pt.y());
-                    break;
-                case 'K': case 'k':
-                    setKingMoves(source, pt.x(), pt.y());
-                    break;
-                }
-            }
-
-            // Get the current position of Black King.
-            QPoint p = board()->point('k');
-            if (currentPlayer() == BlackPlayer)
-                p = board()->point('K');
-            QString kingPos =  QChar('a' + p.y() - 1) + QString::number(p.x());
-
-            QList keyList = m_moves.keys();
-            if (!keyList.contains("Qx"+kingPos) && !keyList.contains("Px"+kingPos) && !keyList.contains("Nx"+kingPos)
-                && !keyList.contains("Rx"+kingPos) && !keyList.contains("Bx"+kingPos))
-            {
-                board()->setDataInternal(from.x(), from.y(), board()->data(to.x(), to.y()));
-                board()->setDataInternal(to.x(), to.y(), ' ');
-                if (!m_moves.empty()) m_moves.clear();
-
-                return false;
-            }
-
-            // Revert the "UNREAL" move.
-            // Check if there was a piece on that spot and get the source.
-            board()->setDataInternal(from.x(), from.y(), board()->data(to.x(), to.y()));
-            board()->setDataInternal(to.x(), to.y(), pieceOnToSource);
-
-            if (!m_moves.empty()) m_moves.clear();
-            if (!keyList.empty()){
-                keyList.clear();
-            }
-        }
-
-        // Clear
-        if (!m_potential_moves.empty()) m_potential_moves.clear();
-    }
-
-    return true;
-}
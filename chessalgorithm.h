@@ -1,11 +1,14 @@
 #ifndef CHESSALGORITHM_H
 #define CHESSALGORITHM_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPoint>
 #include <QPointer>
-#include <QHash>
+#include <QThread>
+#include "analysiscache.h"
 #include "chessboard.h"
+#include "rulesworker.h"
 #include "uciengine.h"
 
 
@@ -19,24 +22,6 @@ class ChessAlgorithm : public QObject
 
     QPointer<ChessBoard> m_board;
 
-    bool m_enpassent_black;
-    bool m_enpassent_white;
-
-    bool m_shortcastle_white;
-    bool m_longcastle_white;
-    bool m_shortcastle_black;
-    bool m_longcastle_black;
-    bool m_whitecastled;
-    bool m_blackcastled;
-
-    bool m_whiteRookMoved;
-    bool m_blackRookMoved ;
-    bool m_whiteKingMoved;
-    bool m_blackKingMoves;
-
-    bool m_whiteCannotCastle;
-    bool m_blackCannotCastle;
-
 public:
     enum Result {NoResult, WhiteWin, BlackWin, Draw, StaleMate};
     Q_ENUM(Result)
@@ -44,7 +29,21 @@ public:
     enum Player {NoPlayer, WhitePlayer, BlackPlayer};
     Q_ENUM(Player)
 
+    // Engine replies over the session. savedNs is search time spent before the move was played.
+    struct PonderStatistics
+    {
+        qint64 ponders = 0;
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 savedNs = 0;
+        qint64 replies = 0;
+        qint64 replyNs = 0;
+
+        inline double hitRate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0; }
+    };
+
     ChessAlgorithm(QObject *parent = nullptr);
+    ~ChessAlgorithm();
 
     // Getter method to the board.
     ChessBoard* board() const;
@@ -53,15 +52,37 @@ public:
     inline UciEngine* engine() const { return m_engine; }
     inline Player currentPlayer() const { return m_currentPlayer; }
     inline QString currentMove() const { return m_currentMove; }
+    inline const PonderStatistics &ponderStatistics() const { return m_ponderStatistics; }
 
-    // Sets the possible player moves, and engine moves.
-    void setMoves(int colFrom, int rankFrom);
+    // Asks the engine for its move, answered with engineMove().
+    // Engine moves come from the analysis cache when the position was analysed before.
+    // After each answer the engine ponders on the position after its own suggestion.
     void setEngineMoves(QString fen);
     QString getFENBoard();
-    bool check(bool type);
-    bool checkMate();
 
-    QHash<QString, bool> getMoves() const {return m_moves;}
+    // Legal moves of the side to move, generated by the rules worker when the player changes.
+    // Asked for before the worker answered, they are generated here; see rules().
+    // Targets are square masks, bit (rank - 1) * 8 + column - 1 as in Position.
+    inline const MoveList &legalMoves() { return rules().legalMoves; }
+    inline MoveGen::Status legalStatus() { return rules().status; }
+
+    // False until the rules worker answered for the current position, asking then costs a generation.
+    inline bool hasRules() const { return m_rules.generation == m_rulesGeneration; }
+    inline quint64 legalTargets(int column, int rank)
+    {
+        return onBoard8(column, rank) ? rules().targets[Position::square(column, rank)] : 0;
+    }
+    inline quint64 captureTargets(int column, int rank)
+    {
+        return onBoard8(column, rank) ? rules().captures[Position::square(column, rank)] : 0;
+    }
+
+    // The legal move between the squares, a pawn promotes to a queen. A null move when there is none.
+    Move legalMove(int colFrom, int rankFrom, int colTo, int rankTo);
+
+    // Notation helpers.
+    QString toAlgebraic(QChar piece, int colFrom, int rankFrom, int colTo, int rankTo, bool canTake);
+    QString toAlgebraicCastle(QChar piece, int colFrom, int rankFrom, int colTo, int rankTo, bool canCastle);
 
 public slots:
     virtual void newGame();
@@ -69,6 +90,9 @@ public slots:
     bool move(const QPoint &from, const QPoint &to);
     QPoint toCoordinates(QString move);
 
+    // Searches the best move for the side to move on the rules worker, answered with hintReady().
+    void requestHint();
+
 signals:
     void boardChanged(ChessBoard*);
     void gameOver(ChessAlgorithm::Result);
@@ -77,6 +101,10 @@ signals:
     void currentPlayerChanged(Player);
     void currentMoveChanged(QString);
     void checkYourself();
+    void engineMove(QString);
+
+    // The hint in algebraic notation, only for the position it was asked for.
+    void hintReady(QString);
 
 protected:
     virtual void setupBoard();
@@ -88,29 +116,54 @@ protected:
 private:
     Result m_result;
 
-    // A copy is needed for doing some checks.
     Player m_currentPlayer;
-    Player m_copy_currentPlayer;
 
     QString m_currentMove;
-    QHash<QString, bool> m_moves;
-    QHash<QString, bool> m_engineMoves;
     QPointer<UciEngine> m_engine;
-    bool m_check;
-    bool m_whiteCastling;
-
-    // GamePlay functions.
-    void setPawnMoves(QChar piece, int colFrom, int rankFrom);
-    void setKnightMoves(QChar piece, int colFrom, int rankFrom);
-    void setBishopMoves(QChar piece, int colFrom, int rankFrom);
-    void setRookMoves(QChar piece, int colFrom, int rankFrom);
-    void setQueenMoves(QChar piece, int colFrom, int rankFrom);
-    void setKingMoves(QChar piece, int colFrom, int rankFrom);
-
-    QString toAlgebraic(QChar piece, int colFrom, int rankFrom, int colTo, int rankTo, bool canTake);
-    QString toAlgebraicCastle(QChar piece, int colFrom, int rankFrom, int colTo, int rankTo, bool canCastle);
-
-    bool onBoard(int colTo, int rankTo);
+    QString m_enginePath;
+
+    // Results of earlier engine searches, the key is the position the engine is searching.
+    AnalysisCache m_analysisCache;
+    AnalysisCache::Limits m_analysisLimits;
+    quint64 m_analysisKey;
+    Position m_analysisPosition;
+    UciInfo m_analysisInfo;
+
+    // Generation of the search m_analysisKey belongs to, output of any other search is dropped.
+    // 0 when no search is wanted, e.g. after a cache hit.
+    quint32 m_analysisGeneration;
+
+    // The position the engine ponders on, as it was sent.
+    QString m_ponderFen;
+    quint64 m_ponderKey;
+    bool m_pondering;
+    QElapsedTimer m_replyTimer;
+    PonderStatistics m_ponderStatistics;
+
+    // Rules work runs on a snapshot of the position per turn, m_rulesGeneration numbers them.
+    // m_rules holds the legal moves once they are known for the current generation.
+    QThread m_rulesThread;
+    RulesWorker *m_rulesWorker;
+    quint64 m_rulesGeneration;
+    Position m_rulesPosition;
+    RulesResult m_rules;
+    qint64 m_staleResults;
+    qint64 m_rulesFallbacks;
+    qint64 m_rulesFallbackNs;
+
+    // The generation whose check, mate or stalemate was reported last, so each is reported once.
+    quint64 m_reportedGeneration;
+
+    void startPondering(Move expected);
+    void updateLegalMoves();
+    const RulesResult &rules();
+    void rulesReady(const RulesResult &result);
+    void reportStatus();
+
+    static inline bool onBoard8(int column, int rank)
+    {
+        return column >= 1 && column <= 8 && rank >= 1 && rank <= 8;
+    }
 };
 
 #endif // CHESSALGORITHM_H
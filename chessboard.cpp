@@ -1,31 +1,26 @@
 #include "chessboard.h"
+#include <cstring>
+#include "fen.h"
+#include "squaresets.h"
+#include "zobrist.h"
 #include <QDebug>
 #include <QPoint>
 
-ChessBoard::ChessBoard(int ranks, int columns, QObject *parent)
+ChessBoard::ChessBoard(QObject *parent)
     : QObject{parent}
 {
-    m_ranks = ranks;
-    m_columns = columns;
     m_nrOfMoves = 0;
     m_nrOfEngMoves = 0;
     m_whiteCastled = CastleType::None;
     m_blackCastled = CastleType::None;
+    m_changeDepth = 0;
+    m_nrOfMovesPending = false;
+    m_nrOfEngMovesPending = false;
+    m_keyPending = false;
 
-    // Once ranks and columns are set, make an empty board.
     initBoard();
 }
 
-int ChessBoard::ranks() const
-{
-    return m_ranks;
-}
-
-int ChessBoard::columns() const
-{
-    return m_columns;
-}
-
 int ChessBoard::nrOfMoves() const
 {
     return m_nrOfMoves;
@@ -97,40 +92,15 @@ void ChessBoard::setBlackCastled(ChessBoard::CastleType type)
     emit blackHasCastled(type);
 }
 
-void ChessBoard::setRanks(int newRanks)
-{
-    // If ranks is already equal, do nothing.
-    if (ranks() == newRanks) return;
-
-    m_ranks = newRanks;
-
-    // Not 100% sure if that's really needed.
-    initBoard();
-
-    // Emit signal that ranks has changed.
-    emit ranksChanged(m_ranks);
-}
-
-void ChessBoard::setColumns(int newColumns)
-{
-    // If columns is already equal, do nothing.
-    if (columns() == newColumns) return;
-
-    m_columns = newColumns;
-
-    // Not 100% sure if that's really needed.
-    initBoard();
-
-    // Emit signal that columns has changed.
-    emit columnsChanged(m_columns);
-}
-
 void ChessBoard::setNrOfMoves(int nr)
 {
     m_nrOfMoves += nr;
 
     // Emit signal that number of moves has changed.
-    emit nrOfMovesChanged();
+    if (isChanging())
+        m_nrOfMovesPending = true;
+    else
+        emit nrOfMovesChanged();
 }
 
 void ChessBoard::setNrOfEngMoves(int nr)
@@ -138,53 +108,74 @@ void ChessBoard::setNrOfEngMoves(int nr)
     m_nrOfEngMoves += nr;
 
     // Emit signal that number of moves has changed.
-    emit nrOfEngMovesChanged();
+    if (isChanging())
+        m_nrOfEngMovesPending = true;
+    else
+        emit nrOfEngMovesChanged();
 }
 
 /*
- * One dimensional QVector of chars that gets filled to empty board.
+ * Empty board, white to move, no castling rights.
  * No pieces are placed yet!
  */
 void ChessBoard::initBoard()
 {
-    m_boardData.fill(' ', ranks() * columns());
+    m_position.clear();
 
     emit boardReset();
 }
 
 /*
- * Returns position on the board.
- * Based on return value of character we are able to identify a chess piece.
+ * Returns the (column, rank) of the first square holding piece,
+ * or a null point when the piece is not on the board.
  */
-QChar ChessBoard::data(int column, int rank) const
-{
-    return m_boardData.at((rank - 1) * columns() + (column - 1));
-}
-
 QPoint ChessBoard::point(QChar piece) const
 {
-    int index = m_boardData.indexOf(piece);
+    const char letter = piece.toLatin1();
+    const int type = Position::pieceType(letter);
+    if (type >= 0)
+    {
+        const Position::Color color = Position::isWhite(letter) ? Position::White : Position::Black;
+        const quint64 squares = m_position.bitboard(color, Position::PieceType(type));
+        if (!squares)
+            return QPoint();
+        const int square = SquareSets::lowestSquare(squares);
+        return QPoint(Position::column(square), Position::rank(square));
+    }
 
-    return QPoint(index / 8 + 1, index % 8 + 1);
+    const char *field = static_cast<const char *>(std::memchr(m_position.board, letter, sizeof(m_position.board)));
+    if (!field)
+        return QPoint();
 
+    const int square = int(field - m_position.board);
+    return QPoint(Position::column(square), Position::rank(square));
 }
 
+/*
+ * Returns every square holding piece, keyed by (column, rank).
+ * Pieces come from their bitboard, only empty squares are looked for on the board.
+ */
 QHash<QPoint, QChar> ChessBoard::points(QChar piece) const
 {
     QHash<QPoint, QChar> points;
-    int index;
 
-    QVector<QChar> board(m_boardData);
-    while (board.contains(piece))
+    const char letter = piece.toLatin1();
+    const int type = Position::pieceType(letter);
+    if (type >= 0)
     {
-        index = board.indexOf(piece);
-        board[index] = '?';
-        qDebug() << "Piece " << piece << " at index " << index;
-
-        int rank = index / 8 + 1;
-        int col = index % 8 + 1;
+        const Position::Color color = Position::isWhite(letter) ? Position::White : Position::Black;
+        for (quint64 squares = m_position.bitboard(color, Position::PieceType(type)); squares; )
+        {
+            const int square = SquareSets::popLowestSquare(squares);
+            points[QPoint(Position::column(square), Position::rank(square))] = piece;
+        }
+        return points;
+    }
 
-        points[QPoint(col, rank)] = piece;
+    for (int square = 0; square < 64; ++square)
+    {
+        if (m_position.board[square] == letter)
+            points[QPoint(Position::column(square), Position::rank(square))] = piece;
     }
 
     return points;
@@ -192,42 +183,103 @@ QHash<QPoint, QChar> ChessBoard::points(QChar piece) const
 
 /*
  * Sets chess piece on postion at (rank, column)
- * and emits that data change.
+ * and emits that data change, right away or with the open transaction.
  */
 void ChessBoard::setData(int column, int rank, QChar value)
 {
-    if (setDataInternal(column, rank, value))
+    beginChange();
+    setDataInternal(column, rank, value);
+    commitChange();
+}
+
+void ChessBoard::beginChange()
+{
+    if (m_changeDepth++ > 0)
+        return;
+
+    std::memcpy(m_changeOriginal, m_position.board, sizeof(m_changeOriginal));
+    m_nrOfMovesPending = false;
+    m_nrOfEngMovesPending = false;
+}
+
+/*
+ * The changed squares follow from comparing with the board at beginChange(), which costs one
+ * pass over the board per transaction instead of bookkeeping in every setDataInternal() call.
+ */
+void ChessBoard::commitChange()
+{
+    if (m_changeDepth == 0)
+    {
+        qWarning() << "commitChange() without beginChange()";
+        return;
+    }
+    if (--m_changeDepth > 0)
+        return;
+
+    if (m_keyPending)
     {
-        emit dataChanged(column, rank);
+        m_keyPending = false;
+        m_position.key = Zobrist::key(m_position);
+    }
+
+    QList<QPoint> changedSquares;
+    for (int square = 0; square < 64; ++square)
+    {
+        if (m_position.board[square] != m_changeOriginal[square])
+            changedSquares.append(QPoint(Position::column(square), Position::rank(square)));
+    }
+
+    for (const QPoint &square : std::as_const(changedSquares))
+        emit dataChanged(square.x(), square.y());
+    if (!changedSquares.isEmpty())
+        emit positionChanged(changedSquares);
+
+    if (m_nrOfMovesPending)
+    {
+        m_nrOfMovesPending = false;
+        emit nrOfMovesChanged();
+    }
+    if (m_nrOfEngMovesPending)
+    {
+        m_nrOfEngMovesPending = false;
+        emit nrOfEngMovesChanged();
     }
 }
 
 /*
- * Helper function that returns true if piece can be moved to
- * given (rank, column).
+ * Puts value on (column, rank), returns false if it was there already.
+ * Side to move, castling rights and en-passant square stay as they are; the key follows
+ * right away, or with the outermost commit of an open transaction.
  */
 bool ChessBoard::setDataInternal(int column, int rank, QChar value)
 {
-    int index = (rank - 1) * columns() + (column - 1);
+    const int square = Position::square(column, rank);
+    const char piece = value.toLatin1();
 
     // Check if we can actually put the piece there.
-    if (m_boardData.at(index) == value)
+    if (m_position.board[square] == piece)
         return false;
 
-    m_boardData[index] = value;
+    m_position.remove(square);
+    m_position.put(square, piece);
+    if (isChanging())
+        m_keyPending = true;
+    else
+        m_position.key = Zobrist::key(m_position);
 
     return true;
 }
 
 /*
- * Moves a chess piece and sets the previous value to a space.
+ * Plays move on the position, which keeps its bitboards, key and state up to date itself.
  */
-void ChessBoard::movePiece(int fromColumn, int fromRank, int toColumn, int toRank)
+void ChessBoard::makeMove(Move move)
 {
-    setData(toColumn, toRank, data(fromColumn, fromRank));
-    setData(fromColumn, fromRank, ' ');
+    beginChange();
+    m_position.makeMove(move);
     setNrOfMoves(1);
     setNrOfEngMoves(1);
+    commitChange();
 }
 
 /*
@@ -256,130 +308,62 @@ void ChessBoard::movePiece(int fromColumn, int fromRank, int toColumn, int toRan
  *    -----------------
  *     a b c d e f g h
  *
- * Got some inspiration from: https://codereview.stackexchange.com/questions/251795/parsing-a-chess-fen
+ * Parsing and validation of all six fields is done by Fen::parse().
+ * If the FEN is invalid the board is left as it was.
  */
-void ChessBoard::setFen(const QString &fen)
+bool ChessBoard::setFen(std::string_view fen)
 {
-    int index = 0;
-    int skip = 0;
-    const int columnCount = columns();
-    QChar ch;
-
-    // Start from top left a8 to h8 and go to h1.
-    for (auto rank = ranks(); rank > 0; --rank)
+    Position position;
+    Fen::Error error = Fen::parse(fen, position);
+    if (error != Fen::Error::None)
     {
-        for (auto column = 1; column <= columnCount; ++column)
-        {
-            // Matches a number (e.g. 8 in the example).
-            if (skip > 0)
-            {
-                ch = ' ';
-                skip--;
-            }
-            else
-            {
-                // Read the character.
-                ch = fen.at(index++);
-                if (ch.isDigit())
-                {
-                    // Convert character to an integer.
-                    skip = ch.toLatin1() - '0';
-                    ch = ' ';
-                    skip--;
-                }
-            }
-            setDataInternal(column, rank, ch.toLatin1());
-        }
+        qDebug() << "Invalid FEN:" << Fen::errorString(error);
+        return false;
+    }
 
-        // Skip the '/' and ' ' characters.
-        QChar next = fen.at(index++);
-        if (next != '/' && next != ' ')
-        {
-            qDebug() << "Bail out char = " << next;
+    setPosition(position);
+    return true;
+}
 
-            initBoard();
-            return;
-        }
-    }
+bool ChessBoard::setFen(const char *fen)
+{
+    return setFen(std::string_view(fen));
+}
 
-    // Emit signal that the board is set.
-    emit boardReset();
+bool ChessBoard::setFen(const QString &fen)
+{
+    const QByteArray latin1 = fen.toLatin1();
+    return setFen(std::string_view(latin1.constData(), std::size_t(latin1.size())));
 }
 
 /*
  * Helper function that gets a FEN code from the current pieces on the board.
- * Written based on documentation in https://www.chess.com/terms/fen-chess.
+ * The side to move is taken from player, all other fields from the board state.
  */
-QString ChessBoard::getFen(QChar player)
+QString ChessBoard::getFen(QChar player) const
 {
-    QString fen = "";
-    int size = m_boardData.size();
-    int nrEmptyFields;
+    char buffer[Fen::BufferSize];
+    Position current = m_position;
+    current.sideToMove = player == 'b' ? Position::Black : Position::White;
 
-    for (auto i=1; i<=8; i++)
-    {
-        nrEmptyFields = 0;
-        int startIndex = size - 8*i;
-        int iter = 0;
-        while (iter < 8)
-        {
-            fen = fen;
-            int index = startIndex + iter;
-            QChar ch = m_boardData.at(index);
-            if (ch == ' ') // TODO: CHeck this...
-            {
-                nrEmptyFields += 1;
-            }
-            else
-            {
-                if (nrEmptyFields > 0)
-                {
-                    fen += QString::number(nrEmptyFields);
-                    nrEmptyFields = 0;
-                }
-                fen += ch;
-            }
-            iter++;
-        }
-        if (iter == 8)
-        {
-            if (nrEmptyFields > 0)
-            {
-                fen += QString::number(nrEmptyFields);
-            }
-            fen += "/";
-        }
-    }
-    // Remove last / from fen string.
-    fen.chop(1);
-    fen += " ";
-    // Add current player info.
-    fen += player;
-    fen += " ";
-    // For now keep it simple...
-    // Add castling info.
-    fen += "KQkq - 0 1";
-
-    /*
-     * if Player::whitePlayer:
-          if (canCastleShort() && canCastleLong())
-          {
-            fen += 'KQ';
-          }
-          else if (canCastleShort() && !canCastleLong())
-          {
-            fen += 'K'
-          }
-          else if (!canCastleShort() && canCastleLong())
-          {
-            fen += 'Q';
-          }
-          else
-          {
-            fen += '-';
-          }
-        }
-        else { // Do same for Black Player}
-    */
-    return fen;
+    const std::size_t length = Fen::write(current, buffer, sizeof(buffer));
+    return QString::fromLatin1(buffer, qsizetype(length));
+}
+
+/*
+ * Writes the FEN of the current position into a caller provided buffer without allocating.
+ * Returns the length, or 0 if the buffer is too small.
+ */
+std::size_t ChessBoard::writeFen(char *buffer, std::size_t size) const
+{
+    return Fen::write(m_position, buffer, size);
+}
+
+void ChessBoard::setPosition(const Position &position)
+{
+    m_position = position;
+    m_position.refresh();
+
+    // Emit signal that the board is set.
+    emit boardReset();
 }
@@ -3,8 +3,14 @@
 
 #include <QObject>
 #include <QHash>
+#include <QList>
+#include <QPoint>
+#include <string_view>
+#include "move.h"
+#include "position.h"
 
 // Datastructure that contains the chess board mappings.
+// The pieces and the game state live in one Position, the board is always 8x8.
 class ChessBoard : public QObject
 {
     // Use macro so moc can produce a C++ source file containing the meta-object code for QObject class.
@@ -12,8 +18,8 @@ class ChessBoard : public QObject
     Q_OBJECT
 
     // Board properties.
-    Q_PROPERTY(int ranks MEMBER m_ranks READ ranks NOTIFY ranksChanged)
-    Q_PROPERTY(int columns MEMBER m_columns READ columns NOTIFY columnsChanged)
+    Q_PROPERTY(int ranks READ ranks CONSTANT)
+    Q_PROPERTY(int columns READ columns CONSTANT)
 
     // Number of moves property.
     Q_PROPERTY(int nrOfMoves MEMBER m_nrOfMoves READ nrOfMoves WRITE setNrOfMoves NOTIFY nrOfMovesChanged)
@@ -27,14 +33,14 @@ class ChessBoard : public QObject
     Q_PROPERTY(bool blackChecked MEMBER m_blackChecked READ blackChecked WRITE setBlackChecked NOTIFY blackIsChecked)
 
 public:
-    explicit ChessBoard(int ranks=8, int columns=8, QObject *parent = nullptr);
+    explicit ChessBoard(QObject *parent = nullptr);
 
     enum CastleType {Short, Long, None};
     Q_ENUM(CastleType)
 
     // Getter methods.
-    int ranks() const;
-    int columns() const;
+    inline int ranks() const { return 8; }
+    inline int columns() const { return 8; }
     int nrOfMoves() const;
     int nrOfEngMoves() const;
     bool whiteChecked() const;
@@ -50,38 +56,58 @@ public:
     void setWhiteChecked(bool isChecked);
     void setBlackChecked(bool isChecked);
 
-    QChar data(int column, int rank) const;
+    inline QChar data(int column, int rank) const { return QChar::fromLatin1(m_position.at(column, rank)); }
+
+    // Squares as (column, rank).
     QPoint point(QChar piece) const;
     QHash<QPoint, QChar> points(QChar piece) const;
     void setData(int column, int rank, QChar value);
-    void movePiece(int fromColumn, int fromRank, int toColumn, int toRank);
 
-    void setFen(const QString &fen);
-    QString getFen(const QChar player);
+    // Plays a legal move of the side to move, with the rook of a castling, the pawn taken
+    // en-passant and the promotion, and updates the game state as Position::makeMove() does.
+    void makeMove(Move move);
+
+    // Changes made between beginChange() and commitChange(), including those through
+    // setDataInternal(), are announced together by the outermost commit: dataChanged() for every
+    // square that ends up different, then one positionChanged(), then the move counters.
+    // Squares changed and changed back, as by a provisional move, are not reported.
+    void beginChange();
+    void commitChange();
+    inline bool isChanging() const { return m_changeDepth > 0; }
+
+    // FEN support. Invalid FENs leave the board untouched.
+    bool setFen(const QString &fen);
+    bool setFen(const char *fen);
+    bool setFen(std::string_view fen);
+    QString getFen(const QChar player) const;
+    std::size_t writeFen(char *buffer, std::size_t size) const;
+
+    // Complete position including side to move, castling rights, en-passant square and clocks.
+    // The board keeps its bitboards and key up to date, so this is a plain reference.
+    inline const Position &position() const { return m_position; }
+    void setPosition(const Position &position);
+
+    // Changes one square without touching the game state.
     bool setDataInternal(int column, int rank, QChar value);
 
 signals:
-    void ranksChanged(int);
-    void columnsChanged(int);
     void nrOfMovesChanged();
     void nrOfEngMovesChanged();
     void whiteHasCastled(CastleType);
     void blackHasCastled(CastleType);
     void dataChanged(int c, int r);
+
+    // The squares, as (column, rank), of one logical change; the board is consistent when it is emitted.
+    void positionChanged(const QList<QPoint> &changedSquares);
     void boardReset();
     void whiteIsChecked();
     void blackIsChecked();
 
 protected:
-    void setRanks(int newRanks);
-    void setColumns(int newColumns);
-
     // Initialises an empty chess board.
     void initBoard();
 
 private:
-    int m_ranks;
-    int m_columns;
     int m_nrOfMoves;
     int m_nrOfEngMoves;
     CastleType m_whiteCastled;
@@ -89,7 +115,15 @@ private:
     bool m_whiteChecked;
     bool m_blackChecked;
 
-    QVector<QChar> m_boardData;
+    Position m_position;
+
+    // Open transaction: nesting depth, the board when it began and the counter signals held back.
+    // Squares set through setDataInternal() leave the key to the outermost commit.
+    int m_changeDepth;
+    char m_changeOriginal[64];
+    bool m_nrOfMovesPending;
+    bool m_nrOfEngMovesPending;
+    bool m_keyPending;
 };
 
 #endif // CHESSBOARD_H
@@ -1,10 +1,30 @@
 #include "chessview.h"
-#include "highlight.h"
-#include "fieldhighlight.h"
+#include <algorithm>
+#include <QtAlgorithms>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
 #include <QPainter>
 #include <QMouseEvent>
 
-ChessView::ChessView(QWidget *parent): QWidget{parent} {}
+// Paint timings, enable with QT_LOGGING_RULES="chess.view.debug=true".
+Q_LOGGING_CATEGORY(lcView, "chess.view", QtInfoMsg)
+
+namespace
+{
+    // Frames per timing report.
+    const int reportFrames = 60;
+}
+
+ChessView::ChessView(QWidget *parent)
+    : QWidget{parent}
+{
+    m_pixmapRatio = 0.0;
+    m_cachePixmaps = qEnvironmentVariable("CHESS_VIEW_PIXMAP_CACHE") != "0";
+    m_frames = 0;
+    m_frameNs = 0;
+    m_maxFrameNs = 0;
+    std::fill(std::begin(m_highlights), std::end(m_highlights), 0);
+}
 
 void ChessView::setBoard(ChessBoard *board)
 {
@@ -30,9 +50,10 @@ void ChessView::setBoard(ChessBoard *board)
     // And connect signals to chess board.
     if (board)
     {
-        connect(board, SIGNAL(dataChanged(int,int)), this, SLOT(update()));
+        connect(board, &ChessBoard::positionChanged, this, &ChessView::updateFields);
         connect(board, SIGNAL(boardReset()), this, SLOT(update()));
     }
+    invalidateBackground();
 
     // Notify the layout system that this widget has changed and may need to change geometry.
     // Draw pieces on board.
@@ -56,6 +77,8 @@ void ChessView::setFieldSize(const QSize &newFieldSize)
         return;
 
     m_fieldSize = newFieldSize;
+    m_piecePixmaps.clear();
+    invalidateBackground();
     //emit fieldSizeChanged();
     updateGeometry();
 }
@@ -125,10 +148,66 @@ void ChessView::paintEvent(QPaintEvent *event)
 {
     if (!m_board) return;
 
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
     // Instantiate the painter on the widget.
     // this is a reference to ChessView instance.
     QPainter painter(this);
 
+    // Only the damaged part of the background layer is copied.
+    renderBackground();
+    const qreal ratio = m_background.devicePixelRatio();
+    for (const QRect &rect : event->region())
+    {
+        painter.drawPixmap(QRectF(rect), m_background,
+                           QRectF(rect.x() * ratio, rect.y() * ratio, rect.width() * ratio, rect.height() * ratio));
+    }
+    painter.setClipRegion(event->region());
+
+    // Highlight the square before the piece is rendered.
+    drawHighlights(&painter);
+
+    // Render the pieces.
+    const QRect dirty = event->rect();
+    for (int r=m_board->ranks(); r > 0 ; --r)
+    {
+        for (int c=1; c <= m_board->columns(); ++c)
+        {
+            if (dirty.intersects(fieldRect(c, r)))
+                drawPiece(&painter, c, r);
+        }
+    }
+
+    painter.end();
+    const qint64 frameNs = frameTimer.nsecsElapsed();
+    m_frameNs += frameNs;
+    m_maxFrameNs = qMax(m_maxFrameNs, frameNs);
+    if (++m_frames == reportFrames)
+    {
+        qCDebug(lcView) << "Paint average" << m_frameNs / m_frames / 1000 << "us, max" << m_maxFrameNs / 1000
+                        << "us over" << m_frames << "frames," << (m_cachePixmaps ? "cached pixmaps" : "icons");
+        m_frames = 0;
+        m_frameNs = 0;
+        m_maxFrameNs = 0;
+    }
+}
+
+void ChessView::renderBackground()
+{
+    const qreal ratio = devicePixelRatioF();
+    if (!m_background.isNull() && m_background.size() == size() * ratio && m_background.devicePixelRatio() == ratio)
+        return;
+
+    m_background = QPixmap(size() * ratio);
+    m_background.setDevicePixelRatio(ratio);
+    m_background.fill(Qt::transparent);
+
+    // A painter on a pixmap does not pick up the widget font and text colour by itself.
+    QPainter painter(&m_background);
+    painter.setFont(font());
+    painter.setPen(palette().color(QPalette::WindowText));
+
     for (int r=m_board->ranks(); r > 0; --r)
     {
         // Save current Painter state.
@@ -155,20 +234,27 @@ void ChessView::paintEvent(QPaintEvent *event)
             painter.restore();
         }
     }
+}
 
-    // Highlight the square before the piece is rendered.
-    drawHighlights(&painter);
+void ChessView::invalidateBackground()
+{
+    m_background = QPixmap();
+    update();
+}
 
-    // Highlight the possible moves squares.
+void ChessView::updateFields(const QList<QPoint> &changedSquares)
+{
+    QRegion region;
+    for (const QPoint &square : changedSquares)
+        region += fieldRect(square.x(), square.y());
+    update(region);
+}
 
-    // Render the pieces.
-    for (int r=m_board->ranks(); r > 0 ; --r)
-    {
-        for (int c=1; c <= m_board->columns(); ++c)
-        {
-           drawPiece(&painter, c, r);
-        }
-    }
+void ChessView::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::PaletteChange || event->type() == QEvent::FontChange)
+        invalidateBackground();
+    QWidget::changeEvent(event);
 }
 
 void ChessView::drawRank(QPainter *painter, int rank)
@@ -206,6 +292,7 @@ void ChessView::drawField(QPainter *painter, int column, int rank)
 void ChessView::setPiece(QChar type, const QIcon &icon)
 {
     m_pieces.insert(type, icon);
+    m_piecePixmaps.remove(type);
 
     // Schedules a repaint event.
     update();
@@ -216,6 +303,36 @@ QIcon ChessView::piece(QChar type) const
     return m_pieces.value(type, QIcon());
 }
 
+const QPixmap &ChessView::piecePixmap(QChar type)
+{
+    // A new field size or a move to a screen with another scale factor renders everything again.
+    const qreal ratio = devicePixelRatioF();
+    if (m_pixmapSize != fieldSize() || m_pixmapRatio != ratio)
+    {
+        m_piecePixmaps.clear();
+        m_pixmapSize = fieldSize();
+        m_pixmapRatio = ratio;
+    }
+
+    auto cached = m_piecePixmaps.find(type);
+    if (cached == m_piecePixmaps.end())
+    {
+        // Rendered the way QIcon::paint() draws into a field, at the resolution of the screen.
+        QPixmap pixmap;
+        const QIcon icon = piece(type);
+        if (!icon.isNull() && !m_pixmapSize.isEmpty())
+        {
+            pixmap = QPixmap(m_pixmapSize * ratio);
+            pixmap.setDevicePixelRatio(ratio);
+            pixmap.fill(Qt::transparent);
+            QPainter painter(&pixmap);
+            icon.paint(&painter, QRect(QPoint(0, 0), m_pixmapSize), Qt::AlignCenter);
+        }
+        cached = m_piecePixmaps.insert(type, pixmap);
+    }
+    return cached.value();
+}
+
 void ChessView::mouseReleaseEvent(QMouseEvent *event)
 {
     QPoint pt = fieldAt(event->pos());
@@ -231,50 +348,79 @@ void ChessView::drawPiece(QPainter *painter, int column, int rank)
     QChar value = m_board->data(column, rank);
 
     // Check if we are on empty field.
-    if (value != ' ')
+    if (value == ' ')
+        return;
+
+    if (m_cachePixmaps)
     {
-        QIcon icon = piece(value);
-        if (!icon.isNull())
-        {
-            icon.paint(painter, rect, Qt::AlignCenter);
-        }
+        const QPixmap &pixmap = piecePixmap(value);
+        if (!pixmap.isNull())
+            painter->drawPixmap(rect.topLeft(), pixmap);
+        return;
+    }
+
+    QIcon icon = piece(value);
+    if (!icon.isNull())
+    {
+        icon.paint(painter, rect, Qt::AlignCenter);
     }
 }
 
-void ChessView::addHighlight(Highlight *hl)
+void ChessView::setHighlights(HighlightStyle style, quint64 squares)
 {
-    m_highlights.append(hl);
-    update();
+    const quint64 changed = m_highlights[style] ^ squares;
+    m_highlights[style] = squares;
+
+    QRegion region;
+    for (quint64 bits = changed; bits; bits &= bits - 1)
+    {
+        const int square = qCountTrailingZeroBits(bits);
+        region += highlightRect(square % 8 + 1, square / 8 + 1);
+    }
+    update(region);
 }
 
-void ChessView::removeHighlight(Highlight *hl)
+void ChessView::clearHighlights()
 {
-    m_highlights.removeOne(hl);
-    update();
+    for (int style = 0; style < HighlightStyleCount; ++style)
+        setHighlights(HighlightStyle(style), 0);
+}
+
+QRect ChessView::highlightRect(int column, int rank) const
+{
+    return fieldRect(column, rank) | fieldCircle(column, rank).adjusted(-1, -1, 1, 1);
 }
 
 void ChessView::drawHighlights(QPainter *painter)
 {
-    // Get the highlights.
-    for (int idx=0; idx < highlightCount(); ++idx)
+    // Highlights outside the area being repainted are skipped.
+    const QRect clip = painter->hasClipping() ? painter->clipBoundingRect().toAlignedRect() : rect();
+
+    // Styles are drawn in order, later ones on top.
+    for (int style = 0; style < HighlightStyleCount; ++style)
     {
-        Highlight *hl = highlight(idx);
-        FieldHighlight *fhl = static_cast<FieldHighlight*>(hl);
-        if (hl->type() == FieldHighlight::HighLightType::Rectangle)
+        for (quint64 bits = m_highlights[style]; bits; bits &= bits - 1)
         {
-            QRect rect = fieldRect(fhl->column(), fhl->rank());
-            painter->fillRect(rect, fhl->color());
-        }
-        if (hl->type() == FieldHighlight::HighLightType::Circle)
-        {
-            QPen pen(QColor(214,214,188));
-            painter->setPen(pen);
-
-            QBrush brush(QColor(214,214,188));
-            painter->setBrush(brush);
-
-            QRect rect = fieldCircle(fhl->column(), fhl->rank());
-            painter->drawEllipse(rect);
+            const int square = qCountTrailingZeroBits(bits);
+            const int column = square % 8 + 1;
+            const int rank = square / 8 + 1;
+            if (!clip.intersects(highlightRect(column, rank)))
+                continue;
+
+            switch (style)
+            {
+            case SelectedField:
+                painter->fillRect(fieldRect(column, rank), QColor(246, 246, 132));
+                break;
+            case CaptureTarget:
+                painter->fillRect(fieldRect(column, rank), QColor(250, 244, 220));
+                break;
+            case MoveTarget:
+                painter->setPen(QColor(214, 214, 188));
+                painter->setBrush(QColor(214, 214, 188));
+                painter->drawEllipse(fieldCircle(column, rank));
+                break;
+            }
         }
     }
 }
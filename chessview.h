@@ -4,11 +4,17 @@
 #include <QWidget>
 #include <QPointer>
 #include <QList>
+#include <QHash>
+#include <QPixmap>
 #include "chessboard.h"
-#include "highlight.h"
 
 // Custom QWidget that represents the chess Board.
 // The view renders the current state of the chess board and emits signals of the board.
+// Pieces are rasterised once per field size and device pixel ratio and blitted from then on.
+// Labels and fields come from a cached background layer; a changed field or highlight only
+// repaints its own rectangle.
+// Frame times are logged with QT_LOGGING_RULES="chess.view.debug=true"; setting
+// CHESS_VIEW_PIXMAP_CACHE=0 paints the icons directly, for comparison.
 class ChessView : public QWidget
 {
     // Macro.
@@ -43,33 +49,71 @@ public:
     void setPiece(QChar type, const QIcon &icon);
     QIcon piece(QChar type) const;
 
+    // The rendered piece, empty when there is no icon for type.
+    const QPixmap &piecePixmap(QChar type);
+
     void mouseReleaseEvent(QMouseEvent *event);
 
     // Highlight feature.
-    void addHighlight(Highlight *hl);
-    void removeHighlight(Highlight *hl);
-    inline Highlight *highlight(int index) const
+    // Every style is a mask of squares, bit (rank - 1) * 8 + column - 1 as in Position, so a1 is
+    // bit 0 and only the first 8 columns and ranks can be highlighted.
+    enum HighlightStyle {
+        SelectedField,
+        MoveTarget,
+        CaptureTarget,
+        HighlightStyleCount
+    };
+
+    static inline quint64 squareMask(int column, int rank)
     {
-        return m_highlights.at(index);
+        return column >= 1 && column <= 8 && rank >= 1 && rank <= 8 ? quint64(1) << ((rank - 1) * 8 + column - 1) : 0;
     }
 
-    inline int highlightCount() const
+    // Replaces the squares of style, only the squares that changed are repainted.
+    void setHighlights(HighlightStyle style, quint64 squares);
+    inline quint64 highlights(HighlightStyle style) const
     {
-        return m_highlights.size();
+        return m_highlights[style];
     }
+    void clearHighlights();
     virtual void drawHighlights(QPainter *painter);
 
 protected:
     void drawPiece(QPainter *painter, int column, int rank);
+    void changeEvent(QEvent *event);
+
+private slots:
+    void updateFields(const QList<QPoint> &changedSquares);
+    void invalidateBackground();
 
 private:
+    // Draws labels and empty fields into m_background when it is null or no longer fits the widget.
+    void renderBackground();
+
+    // Area a highlight on the field paints on, whatever its style.
+    QRect highlightRect(int column, int rank) const;
+
     // QPointer intialised m_board to NULL.
     QPointer<ChessBoard> m_board;
     QSize m_fieldSize;
 
     // Key is char and value is the icon.
     QMap<QChar, QIcon> m_pieces;
-    QList<Highlight*> m_highlights;
+    quint64 m_highlights[HighlightStyleCount];
+
+    // Labels and empty fields at the widget size and device pixel ratio.
+    QPixmap m_background;
+
+    // Rasterised pieces, valid for m_pixmapSize at m_pixmapRatio.
+    QHash<QChar, QPixmap> m_piecePixmaps;
+    QSize m_pixmapSize;
+    qreal m_pixmapRatio;
+    bool m_cachePixmaps;
+
+    // Paint statistics since the last report.
+    int m_frames;
+    qint64 m_frameNs;
+    qint64 m_maxFrameNs;
 
 signals:
     void fieldSizeChanged();
@@ -0,0 +1,192 @@
+#include "enginepool.h"
+#include <QDebug>
+
+EnginePool::EnginePool(const QString &enginePath, int engines, QObject *parent)
+    : QObject{parent}
+{
+    m_enginePath = enginePath;
+    m_busyCount = 0;
+    m_completed = 0;
+    m_runNs = 0;
+
+    engines = qMax(1, engines);
+    m_slots.resize(engines);
+    for (int index = 0; index < engines; ++index)
+    {
+        UciEngine *engine = new UciEngine(this);
+        engine->setOption("Threads", "1");
+        m_slots[index].engine = engine;
+
+        // The last scored main line is the one reported with the result.
+        connect(engine, &UciEngine::info, this, [this, index](const UciInfo &info) {
+            Slot &slot = m_slots[index];
+            if (slot.busy && info.multiPv == 1 && info.scoreType != UciInfo::NoScore)
+                slot.info = info;
+        });
+        connect(engine, &UciEngine::bestMove, this, [this, index](const UciBestMove &bestMove) {
+            searchFinished(index, bestMove);
+        });
+        connect(engine, &UciEngine::stateChanged, this, [this, index](UciEngine::State state) {
+            if (state == UciEngine::NotRunning)
+                engineStopped(index);
+        });
+
+        engine->startEngine(m_enginePath);
+    }
+}
+
+void EnginePool::setOption(const QString &name, const QString &value)
+{
+    for (Slot &slot : m_slots)
+        slot.engine->setOption(name, value);
+}
+
+int EnginePool::engineCount() const
+{
+    return int(m_slots.size());
+}
+
+int EnginePool::queuedCount() const
+{
+    return int(m_queue.size());
+}
+
+bool EnginePool::isIdle() const
+{
+    return m_queue.isEmpty() && m_busyCount == 0;
+}
+
+qint64 EnginePool::completedCount() const
+{
+    return m_completed;
+}
+
+qint64 EnginePool::runNs() const
+{
+    if (!m_runTimer.isValid())
+        return 0;
+    return isIdle() ? m_runNs : m_runTimer.nsecsElapsed();
+}
+
+double EnginePool::positionsPerSecond() const
+{
+    const qint64 ns = runNs();
+    return ns > 0 ? m_completed * 1e9 / ns : 0.0;
+}
+
+QList<EnginePool::EngineStatistics> EnginePool::statistics() const
+{
+    const qint64 ns = runNs();
+
+    QList<EngineStatistics> result;
+    result.reserve(m_slots.size());
+    for (const Slot &slot : m_slots)
+    {
+        EngineStatistics statistics = slot.statistics;
+        if (slot.busy)
+            statistics.busyNs += slot.busyTimer.nsecsElapsed();
+        statistics.utilization = ns > 0 ? qMin(1.0, double(statistics.busyNs) / ns) : 0.0;
+        result.append(statistics);
+    }
+    return result;
+}
+
+void EnginePool::resetStatistics()
+{
+    m_completed = 0;
+    m_runNs = 0;
+    m_runTimer.invalidate();
+    for (Slot &slot : m_slots)
+        slot.statistics = EngineStatistics();
+}
+
+void EnginePool::submit(qint64 positionId, const QString &fen, const QString &goCommand)
+{
+    if (!m_runTimer.isValid())
+        m_runTimer.start();
+
+    m_queue.enqueue({positionId, fen, goCommand});
+    dispatch();
+}
+
+void EnginePool::clearQueue()
+{
+    m_queue.clear();
+    if (m_busyCount == 0)
+        runFinished();
+}
+
+void EnginePool::dispatch()
+{
+    for (Slot &slot : m_slots)
+    {
+        if (m_queue.isEmpty())
+            return;
+        if (slot.busy)
+            continue;
+
+        const Job job = m_queue.dequeue();
+        slot.busy = true;
+        slot.positionId = job.positionId;
+        slot.info = UciInfo();
+        slot.busyTimer.start();
+        ++m_busyCount;
+
+        // Does nothing for a running engine, restarts one that quit after an earlier failure.
+        slot.engine->startEngine(m_enginePath);
+        slot.engine->analyse(job.fen, job.goCommand);
+    }
+}
+
+void EnginePool::finishJob(Slot &slot)
+{
+    slot.statistics.busyNs += slot.busyTimer.nsecsElapsed();
+    slot.busy = false;
+    slot.positionId = -1;
+    --m_busyCount;
+}
+
+void EnginePool::searchFinished(int index, const UciBestMove &bestMove)
+{
+    Slot &slot = m_slots[index];
+    if (!slot.busy)
+        return;
+
+    // Copied, a receiver may submit the next position and reuse the slot.
+    const qint64 positionId = slot.positionId;
+    const UciInfo info = slot.info;
+    ++slot.statistics.positions;
+    slot.statistics.nodes += info.nodes;
+    ++m_completed;
+    finishJob(slot);
+
+    emit resultReady(positionId, bestMove, info);
+
+    dispatch();
+    if (isIdle())
+        runFinished();
+}
+
+void EnginePool::engineStopped(int index)
+{
+    Slot &slot = m_slots[index];
+    if (!slot.busy)
+        return;
+
+    qWarning() << "Engine" << index << "stopped while analysing position" << slot.positionId;
+    const qint64 positionId = slot.positionId;
+    finishJob(slot);
+
+    emit positionFailed(positionId);
+
+    dispatch();
+    if (isIdle())
+        runFinished();
+}
+
+// Busy time is measured against the wall time up to the moment the pool ran dry.
+void EnginePool::runFinished()
+{
+    m_runNs = m_runTimer.isValid() ? m_runTimer.nsecsElapsed() : 0;
+    emit finished();
+}
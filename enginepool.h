@@ -0,0 +1,102 @@
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include "uciengine.h"
+#include "uciparser.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+
+/**
+ * @brief Analyses many positions on a fixed set of engine processes.
+ *
+ * Every engine runs with Threads=1, so a pool of one engine per core keeps the machine busy
+ * without the engines competing for it. Engines are started once and kept warm: the next
+ * position goes to the first idle engine without ucinewgame, so hash and process start up
+ * are paid once per engine instead of once per position.
+ *
+ * Results come back in completion order, tagged with the id given to submit().
+ */
+class EnginePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct EngineStatistics
+    {
+        qint64 positions = 0;
+        quint64 nodes = 0;
+        qint64 busyNs = 0;
+
+        // Share of the run this engine spent searching, 0 .. 1.
+        double utilization = 0.0;
+    };
+
+    explicit EnginePool(const QString &enginePath, int engines = QThread::idealThreadCount(), QObject *parent = nullptr);
+
+    // Applied to every engine, before its next search when it is already running.
+    void setOption(const QString &name, const QString &value);
+
+    int engineCount() const;
+    int queuedCount() const;
+    bool isIdle() const;
+
+    // Statistics since the first submit after construction or resetStatistics().
+    qint64 completedCount() const;
+    double positionsPerSecond() const;
+    QList<EngineStatistics> statistics() const;
+    void resetStatistics();
+
+public slots:
+    void submit(qint64 positionId, const QString &fen, const QString &goCommand = "go depth 12");
+
+    // Drops the positions that have not been handed to an engine yet.
+    void clearQueue();
+
+signals:
+    // info is the last scored multipv 1 line of the search, its scoreType is NoScore if there was none.
+    void resultReady(qint64 positionId, const UciBestMove &bestMove, const UciInfo &info);
+
+    // The engine quit or crashed while analysing the position.
+    void positionFailed(qint64 positionId);
+
+    // The queue is empty and every engine is idle.
+    void finished();
+
+private:
+    struct Job
+    {
+        qint64 positionId;
+        QString fen;
+        QString goCommand;
+    };
+
+    struct Slot
+    {
+        UciEngine *engine = nullptr;
+        bool busy = false;
+        qint64 positionId = -1;
+        UciInfo info;
+        QElapsedTimer busyTimer;
+        EngineStatistics statistics;
+    };
+
+    void dispatch();
+    void runFinished();
+    qint64 runNs() const;
+    void searchFinished(int slot, const UciBestMove &bestMove);
+    void engineStopped(int slot);
+    void finishJob(Slot &slot);
+
+    QString m_enginePath;
+    QList<Slot> m_slots;
+    QQueue<Job> m_queue;
+    int m_busyCount;
+    qint64 m_completed;
+    QElapsedTimer m_runTimer;
+    qint64 m_runNs;
+};
+
+#endif // ENGINEPOOL_H
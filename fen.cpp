@@ -0,0 +1,320 @@
+#include "fen.h"
+#include <charconv>
+
+namespace
+{
+    bool isPiece(char ch)
+    {
+        switch (ch)
+        {
+        case 'P': case 'N': case 'B': case 'R': case 'Q': case 'K':
+        case 'p': case 'n': case 'b': case 'r': case 'q': case 'k':
+            return true;
+        }
+        return false;
+    }
+
+    // Splits off the next space separated field and advances fen past it.
+    std::string_view nextField(std::string_view &fen)
+    {
+        std::size_t start = fen.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+        {
+            fen = std::string_view();
+            return fen;
+        }
+        fen.remove_prefix(start);
+
+        std::size_t end = fen.find(' ');
+        std::string_view field = fen.substr(0, end);
+        fen.remove_prefix(field.size());
+        return field;
+    }
+
+    bool parseNumber(std::string_view field, unsigned min, std::uint16_t &value)
+    {
+        if (field.empty())
+            return false;
+
+        unsigned number = 0;
+        auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), number);
+        if (ec != std::errc() || end != field.data() + field.size() || number < min || number > 0xffff)
+            return false;
+
+        value = static_cast<std::uint16_t>(number);
+        return true;
+    }
+
+    char *writeNumber(char *out, char *end, unsigned number)
+    {
+        auto [ptr, ec] = std::to_chars(out, end, number);
+        return ec == std::errc() ? ptr : nullptr;
+    }
+}
+
+/*
+ * The board is read from a8 to h8 and then rank by rank down to h1,
+ * exactly as it is written in the FEN.
+ */
+static Fen::Error parseRecord(std::string_view fen, Position &position, std::string_view *operations)
+{
+    using Error = Fen::Error;
+
+    Position result;
+    result.clear();
+
+    // Ignore surrounding white space and line endings.
+    while (!fen.empty() && (fen.back() == '\n' || fen.back() == '\r' || fen.back() == ' ' || fen.back() == '\t'))
+        fen.remove_suffix(1);
+
+    // Piece placement.
+    std::string_view placement = nextField(fen);
+    int rank = 8;
+    int column = 1;
+    bool lastWasDigit = false;
+    int whiteKings = 0;
+    int blackKings = 0;
+
+    for (char ch : placement)
+    {
+        if (ch == '/')
+        {
+            if (column != 9)
+                return Error::BadRankLength;
+            if (--rank < 1)
+                return Error::BadRankCount;
+            column = 1;
+            lastWasDigit = false;
+        }
+        else if (ch >= '1' && ch <= '8')
+        {
+            // Two digits in a row ("44") is not a valid FEN.
+            if (lastWasDigit)
+                return Error::BadRankLength;
+            column += ch - '0';
+            if (column > 9)
+                return Error::BadRankLength;
+            lastWasDigit = true;
+        }
+        else if (isPiece(ch))
+        {
+            if (column > 8)
+                return Error::BadRankLength;
+            if ((ch == 'P' || ch == 'p') && (rank == 1 || rank == 8))
+                return Error::PawnOnBackRank;
+            whiteKings += ch == 'K';
+            blackKings += ch == 'k';
+            result.board[Position::square(column++, rank)] = ch;
+            lastWasDigit = false;
+        }
+        else
+        {
+            return Error::BadPiece;
+        }
+    }
+    if (column != 9)
+        return Error::BadRankLength;
+    if (rank != 1)
+        return Error::BadRankCount;
+    if (whiteKings != 1 || blackKings != 1)
+        return Error::BadKings;
+
+    // Side to move.
+    std::string_view side = nextField(fen);
+    if (side == "w")
+        result.sideToMove = Position::White;
+    else if (side == "b")
+        result.sideToMove = Position::Black;
+    else
+        return Error::BadSideToMove;
+
+    // Castling rights, "-" or any combination of KQkq without repeats, each backed by its king and rook.
+    std::string_view castling = nextField(fen);
+    if (castling.empty())
+        return Error::BadCastling;
+    if (castling != "-")
+    {
+        for (char ch : castling)
+        {
+            std::uint8_t right = 0;
+            switch (ch)
+            {
+            case 'K': right = Position::WhiteShort; break;
+            case 'Q': right = Position::WhiteLong; break;
+            case 'k': right = Position::BlackShort; break;
+            case 'q': right = Position::BlackLong; break;
+            default:
+                return Error::BadCastling;
+            }
+            if (result.castling & right)
+                return Error::BadCastling;
+            result.castling |= right;
+        }
+
+        // Every right needs its king and rook on their home squares.
+        if (((result.castling & Position::WhiteShort) && (result.board[4] != 'K' || result.board[7] != 'R'))
+            || ((result.castling & Position::WhiteLong) && (result.board[4] != 'K' || result.board[0] != 'R'))
+            || ((result.castling & Position::BlackShort) && (result.board[60] != 'k' || result.board[63] != 'r'))
+            || ((result.castling & Position::BlackLong) && (result.board[60] != 'k' || result.board[56] != 'r')))
+        {
+            return Error::BadCastling;
+        }
+    }
+
+    // En-passant target square, which must be behind a pawn that just made a double step.
+    std::string_view enPassant = nextField(fen);
+    if (enPassant.empty())
+        return Error::BadEnPassant;
+    if (enPassant != "-")
+    {
+        if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h')
+            return Error::BadEnPassant;
+
+        const int epColumn = enPassant[0] - 'a' + 1;
+        const int epRank = enPassant[1] - '0';
+        const bool whiteToMove = result.sideToMove == Position::White;
+        if (epRank != (whiteToMove ? 6 : 3))
+            return Error::BadEnPassant;
+        if (result.at(epColumn, whiteToMove ? 5 : 4) != (whiteToMove ? 'p' : 'P'))
+            return Error::BadEnPassant;
+
+        result.epSquare = static_cast<std::int8_t>(Position::square(epColumn, epRank));
+    }
+
+    // Half move clock and full move number, both optional.
+    // In an EPD record anything that does not start with a digit is the first operation.
+    std::string_view rest = fen;
+    std::string_view halfmove = nextField(rest);
+    const bool hasClocks = !halfmove.empty() && (!operations || (halfmove[0] >= '0' && halfmove[0] <= '9'));
+    if (hasClocks)
+    {
+        fen = rest;
+        if (!parseNumber(halfmove, 0, result.halfmoveClock))
+            return Error::BadHalfmoveClock;
+
+        std::string_view fullmove = nextField(fen);
+        if (!parseNumber(fullmove, 1, result.fullmoveNumber))
+            return Error::BadFullmoveNumber;
+    }
+
+    if (operations)
+    {
+        const std::size_t start = fen.find_first_not_of(' ');
+        *operations = start == std::string_view::npos ? std::string_view() : fen.substr(start);
+    }
+    else if (!nextField(fen).empty())
+    {
+        return Error::TrailingCharacters;
+    }
+
+    result.refresh();
+    position = result;
+    return Error::None;
+}
+
+Fen::Error Fen::parse(std::string_view fen, Position &position)
+{
+    return parseRecord(fen, position, nullptr);
+}
+
+Fen::Error Fen::parseEpd(std::string_view line, Position &position, std::string_view &operations)
+{
+    operations = std::string_view();
+    return parseRecord(line, position, &operations);
+}
+
+std::size_t Fen::write(const Position &position, char *buffer, std::size_t size)
+{
+    char *out = buffer;
+    char *const end = buffer + size;
+
+    // Worst case piece placement is 71 characters, check the fixed part up front.
+    if (size < 72)
+        return 0;
+
+    for (int rank = 8; rank > 0; --rank)
+    {
+        int nrEmptyFields = 0;
+        for (int column = 1; column <= 8; ++column)
+        {
+            const char ch = position.at(column, rank);
+            if (ch == ' ')
+            {
+                ++nrEmptyFields;
+                continue;
+            }
+            if (nrEmptyFields > 0)
+            {
+                *out++ = static_cast<char>('0' + nrEmptyFields);
+                nrEmptyFields = 0;
+            }
+            *out++ = ch;
+        }
+        if (nrEmptyFields > 0)
+            *out++ = static_cast<char>('0' + nrEmptyFields);
+        if (rank > 1)
+            *out++ = '/';
+    }
+
+    // Side, castling and en-passant take at most 11 characters.
+    if (end - out < 11)
+        return 0;
+
+    *out++ = ' ';
+    *out++ = position.sideToMove == Position::White ? 'w' : 'b';
+    *out++ = ' ';
+    if (position.castling == 0)
+    {
+        *out++ = '-';
+    }
+    else
+    {
+        if (position.castling & Position::WhiteShort) *out++ = 'K';
+        if (position.castling & Position::WhiteLong) *out++ = 'Q';
+        if (position.castling & Position::BlackShort) *out++ = 'k';
+        if (position.castling & Position::BlackLong) *out++ = 'q';
+    }
+    *out++ = ' ';
+    if (position.epSquare == Position::NoSquare)
+    {
+        *out++ = '-';
+    }
+    else
+    {
+        *out++ = static_cast<char>('a' + position.epSquare % 8);
+        *out++ = static_cast<char>('1' + position.epSquare / 8);
+    }
+
+    // The clocks.
+    *out++ = ' ';
+    out = writeNumber(out, end, position.halfmoveClock);
+    if (!out || out == end)
+        return 0;
+    *out++ = ' ';
+    out = writeNumber(out, end, position.fullmoveNumber);
+    if (!out || out == end)
+        return 0;
+
+    *out = '\0';
+    return static_cast<std::size_t>(out - buffer);
+}
+
+const char *Fen::errorString(Error error)
+{
+    switch (error)
+    {
+    case Error::None: return "no error";
+    case Error::BadPiece: return "unknown piece letter";
+    case Error::BadRankLength: return "rank does not have 8 fields";
+    case Error::BadRankCount: return "board does not have 8 ranks";
+    case Error::BadKings: return "each side needs exactly one king";
+    case Error::PawnOnBackRank: return "pawn on first or last rank";
+    case Error::BadSideToMove: return "side to move is not 'w' or 'b'";
+    case Error::BadCastling: return "invalid castling rights";
+    case Error::BadEnPassant: return "invalid en-passant square";
+    case Error::BadHalfmoveClock: return "invalid half move clock";
+    case Error::BadFullmoveNumber: return "invalid full move number";
+    case Error::TrailingCharacters: return "unexpected characters after the FEN";
+    }
+    return "unknown error";
+}
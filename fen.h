@@ -0,0 +1,51 @@
+#ifndef FEN_H
+#define FEN_H
+
+#include <cstddef>
+#include <string_view>
+#include "position.h"
+
+/*
+ * Allocation free FEN reader and writer.
+ * Written based on documentation in https://www.chess.com/terms/fen-chess.
+ *
+ * Example: rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1
+ *
+ * All six fields are read and validated. The two clock fields may be left out,
+ * as in EPD records, in which case they default to "0 1".
+ */
+namespace Fen
+{
+    enum class Error {
+        None,
+        BadPiece,
+        BadRankLength,
+        BadRankCount,
+        BadKings,
+        PawnOnBackRank,
+        BadSideToMove,
+        BadCastling,
+        BadEnPassant,
+        BadHalfmoveClock,
+        BadFullmoveNumber,
+        TrailingCharacters
+    };
+
+    // Longest possible FEN including the terminating zero.
+    constexpr std::size_t BufferSize = 96;
+
+    // Parses fen into position. On error position is left untouched.
+    Error parse(std::string_view fen, Position &position);
+
+    // Parses an EPD record: the four position fields, optional clocks, then operations such as "bm e4; id \"x\";".
+    // operations points into line and is empty when there are none.
+    Error parseEpd(std::string_view line, Position &position, std::string_view &operations);
+
+    // Writes position into buffer and terminates it with a zero.
+    // Returns the length written, or 0 if the buffer is too small.
+    std::size_t write(const Position &position, char *buffer, std::size_t size);
+
+    const char *errorString(Error error);
+}
+
+#endif // FEN_H
@@ -0,0 +1,305 @@
+#include "gamecodec.h"
+#include "movegen.h"
+#include <algorithm>
+
+namespace
+{
+    // Probabilities are 11 bit, adapted by 1/32 of the distance after every bit.
+    constexpr int probabilityBits = 11;
+    constexpr std::uint16_t probabilityInit = 1 << (probabilityBits - 1);
+    constexpr int adaptShift = 5;
+    constexpr std::uint32_t topValue = 1u << 24;
+
+    // index + 1 lies in [2^k, 2^(k+1)): k is sent in unary, then the k low bits through a bit tree.
+    struct IndexModel
+    {
+        std::uint16_t bucket[9];
+        std::uint16_t tree[9][256];
+
+        IndexModel()
+        {
+            std::fill(std::begin(bucket), std::end(bucket), probabilityInit);
+            for (auto &bits : tree)
+                std::fill(std::begin(bits), std::end(bits), probabilityInit);
+        }
+    };
+
+    class RangeEncoder
+    {
+    public:
+        explicit RangeEncoder(std::vector<std::uint8_t> &out) : m_out(out), m_start(out.size()) {}
+
+        void encodeBit(std::uint16_t &probability, int bit)
+        {
+            const std::uint32_t bound = (m_range >> probabilityBits) * probability;
+            if (bit == 0)
+            {
+                m_range = bound;
+                probability += ((1 << probabilityBits) - probability) >> adaptShift;
+            }
+            else
+            {
+                m_low += bound;
+                m_range -= bound;
+                probability -= probability >> adaptShift;
+            }
+            while (m_range < topValue)
+            {
+                m_range <<= 8;
+                shiftLow();
+            }
+        }
+
+        // The decoder reads zeros past the end, so trailing zero bytes are left out.
+        void flush()
+        {
+            for (int i = 0; i < 5; ++i)
+                shiftLow();
+            while (m_out.size() > m_start && m_out.back() == 0)
+                m_out.pop_back();
+        }
+
+    private:
+        // Bytes are held back while they could still receive a carry.
+        void shiftLow()
+        {
+            if (static_cast<std::uint32_t>(m_low) < 0xff000000u || (m_low >> 32) != 0)
+            {
+                const std::uint8_t carry = static_cast<std::uint8_t>(m_low >> 32);
+                std::uint8_t byte = m_cache;
+                do
+                {
+                    // The very first byte is always zero and is not stored.
+                    if (!m_first)
+                        m_out.push_back(static_cast<std::uint8_t>(byte + carry));
+                    m_first = false;
+                    byte = 0xff;
+                } while (--m_cacheSize != 0);
+                m_cache = static_cast<std::uint8_t>(m_low >> 24);
+            }
+            ++m_cacheSize;
+            m_low = (m_low & 0x00ffffffu) << 8;
+        }
+
+        std::vector<std::uint8_t> &m_out;
+        std::size_t m_start;
+        bool m_first = true;
+        std::uint64_t m_low = 0;
+        std::uint32_t m_range = 0xffffffffu;
+        std::uint8_t m_cache = 0;
+        std::uint64_t m_cacheSize = 1;
+    };
+
+    class RangeDecoder
+    {
+    public:
+        RangeDecoder(const std::uint8_t *data, std::size_t size) : m_data(data), m_end(data + size)
+        {
+            for (int i = 0; i < 4; ++i)
+                m_code = (m_code << 8) | nextByte();
+        }
+
+        int decodeBit(std::uint16_t &probability)
+        {
+            const std::uint32_t bound = (m_range >> probabilityBits) * probability;
+            int bit;
+            if (m_code < bound)
+            {
+                m_range = bound;
+                probability += ((1 << probabilityBits) - probability) >> adaptShift;
+                bit = 0;
+            }
+            else
+            {
+                m_code -= bound;
+                m_range -= bound;
+                probability -= probability >> adaptShift;
+                bit = 1;
+            }
+            while (m_range < topValue)
+            {
+                m_range <<= 8;
+                m_code = (m_code << 8) | nextByte();
+            }
+            return bit;
+        }
+
+    private:
+        std::uint8_t nextByte()
+        {
+            return m_data < m_end ? *m_data++ : 0;
+        }
+
+        const std::uint8_t *m_data;
+        const std::uint8_t *m_end;
+        std::uint32_t m_code = 0;
+        std::uint32_t m_range = 0xffffffffu;
+    };
+
+    void encodeIndex(RangeEncoder &encoder, IndexModel &model, int index)
+    {
+        const unsigned value = static_cast<unsigned>(index) + 1;
+        int bits = 0;
+        while ((value >> (bits + 1)) != 0)
+            ++bits;
+
+        for (int k = 0; k < bits; ++k)
+            encoder.encodeBit(model.bucket[k], 1);
+        if (bits < 8)
+            encoder.encodeBit(model.bucket[bits], 0);
+
+        unsigned node = 1;
+        for (int k = bits - 1; k >= 0; --k)
+        {
+            const int bit = (value >> k) & 1;
+            encoder.encodeBit(model.tree[bits][node], bit);
+            node = (node << 1) | static_cast<unsigned>(bit);
+        }
+    }
+
+    int decodeIndex(RangeDecoder &decoder, IndexModel &model)
+    {
+        int bits = 0;
+        while (bits < 8 && decoder.decodeBit(model.bucket[bits]))
+            ++bits;
+
+        unsigned node = 1;
+        for (int k = 0; k < bits; ++k)
+            node = (node << 1) | static_cast<unsigned>(decoder.decodeBit(model.tree[bits][node]));
+
+        // node now holds 2^bits + low bits, which is index + 1.
+        return static_cast<int>(node) - 1;
+    }
+
+    int pieceValue(char piece)
+    {
+        switch (piece)
+        {
+        case 'P': case 'p': return 1;
+        case 'N': case 'n': case 'B': case 'b': return 3;
+        case 'R': case 'r': return 5;
+        case 'Q': case 'q': return 9;
+        case 'K': case 'k': return 10;
+        }
+        return 0;
+    }
+
+    int centralisation(int square)
+    {
+        const int column = square % 8;
+        const int rank = square / 8;
+        const int columnDistance = column < 4 ? 3 - column : column - 4;
+        const int rankDistance = rank < 4 ? 3 - rank : rank - 4;
+        return 3 - std::max(columnDistance, rankDistance);
+    }
+
+    // Higher is more likely to be played. Only depends on the position, so the decoder gets the same order.
+    int codingScore(const Position &position, Move move)
+    {
+        const char piece = position.board[move.from()];
+        const char victim = position.board[move.to()];
+
+        if (move.promotion() != Move::NoPromotion)
+            return move.promotion() == Move::Queen ? 200 : -200;
+        if (victim != ' ')
+            return 100 + 10 * pieceValue(victim) - pieceValue(piece);
+
+        const bool king = piece == 'K' || piece == 'k';
+        if (king && (move.to() - move.from() == 2 || move.from() - move.to() == 2))
+            return 90;
+
+        int score = centralisation(move.to()) - centralisation(move.from());
+        switch (piece)
+        {
+        case 'P': case 'p':
+            score += 2;
+            break;
+        case 'N': case 'n': case 'B': case 'b':
+            score += 3;
+            // Developing a minor piece from the back rank.
+            if (move.from() < 8 || move.from() >= 56)
+                score += 4;
+            break;
+        case 'K': case 'k':
+            score -= 4;
+            break;
+        }
+        return score;
+    }
+}
+
+void GameCodec::orderedMoves(const Position &position, MoveList &moves)
+{
+    // Equal scores keep the generator order, which is part of the file format.
+    MoveGen::generateLegalMailbox(position, moves);
+
+    int scores[256];
+    for (int i = 0; i < moves.size(); ++i)
+        scores[i] = codingScore(position, moves[i]);
+
+    // Insertion sort, stable and fast for the short lists seen here.
+    for (int i = 1; i < moves.size(); ++i)
+    {
+        const Move move = moves[i];
+        const int score = scores[i];
+        int j = i - 1;
+        for (; j >= 0 && scores[j] < score; --j)
+        {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+        }
+        moves[j + 1] = move;
+        scores[j + 1] = score;
+    }
+}
+
+bool GameCodec::encode(const Position &start, const std::vector<Move> &moves, std::vector<std::uint8_t> &out)
+{
+    IndexModel model;
+    RangeEncoder encoder(out);
+    Position position = start;
+
+    for (Move move : moves)
+    {
+        MoveList legal;
+        orderedMoves(position, legal);
+
+        const Move *found = std::find(legal.begin(), legal.end(), move);
+        if (found == legal.end())
+            return false;
+
+        // A forced move does not need any bits.
+        if (legal.size() > 1)
+            encodeIndex(encoder, model, static_cast<int>(found - legal.begin()));
+
+        position.makeMove(move);
+    }
+    encoder.flush();
+
+    return true;
+}
+
+bool GameCodec::decode(const Position &start, int plies, const std::uint8_t *data, std::size_t size, std::vector<Move> &moves)
+{
+    IndexModel model;
+    RangeDecoder decoder(data, size);
+    Position position = start;
+    moves.reserve(moves.size() + static_cast<std::size_t>(plies));
+
+    for (int ply = 0; ply < plies; ++ply)
+    {
+        MoveList legal;
+        orderedMoves(position, legal);
+        if (legal.empty())
+            return false;
+
+        const int index = legal.size() > 1 ? decodeIndex(decoder, model) : 0;
+        if (index >= legal.size())
+            return false;
+
+        moves.push_back(legal[index]);
+        position.makeMove(legal[index]);
+    }
+
+    return true;
+}
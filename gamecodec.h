@@ -0,0 +1,32 @@
+#ifndef GAMECODEC_H
+#define GAMECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "move.h"
+#include "position.h"
+
+/*
+ * Compresses the moves of one game.
+ *
+ * Every move is stored as its index in the legal move list of the position it is played in.
+ * The list is sorted with a cheap, deterministic guess of how likely each move is, so the
+ * index is usually small. Indexes are then coded with an adaptive binary range coder
+ * (the LZMA flavour), forced moves cost nothing.
+ *
+ * Every game is coded on its own, so any game can be decoded without its neighbours.
+ */
+namespace GameCodec
+{
+    // Appends the coded moves to out. Returns false if a move is not legal.
+    bool encode(const Position &start, const std::vector<Move> &moves, std::vector<std::uint8_t> &out);
+
+    // Decodes plies moves by replaying them through the move generator.
+    bool decode(const Position &start, int plies, const std::uint8_t *data, std::size_t size, std::vector<Move> &moves);
+
+    // Legal moves of position in coding order.
+    void orderedMoves(const Position &position, MoveList &moves);
+}
+
+#endif // GAMECODEC_H
@@ -0,0 +1,292 @@
+#include "gamedb.h"
+#include <cstring>
+#include "fen.h"
+#include "gamecodec.h"
+
+namespace
+{
+    constexpr char dataMagic[4] = {'C', 'G', 'D', 'B'};
+    constexpr char indexMagic[4] = {'C', 'G', 'D', 'I'};
+    constexpr quint32 version = 1;
+    constexpr qint64 fileHeaderSize = 8;
+
+    // Offsets are collected and written after the games they point to have been flushed.
+    constexpr std::size_t pendingLimit = 4096;
+
+    QString indexFileName(const QString &fileName)
+    {
+        return fileName + QStringLiteral(".idx");
+    }
+
+    // Writes the file header to an empty file, or checks it on an existing one.
+    bool prepareFile(QFile &file, const char *magic, QString &error)
+    {
+        if (file.size() == 0)
+        {
+            if (file.write(magic, 4) != 4 || file.write(reinterpret_cast<const char *>(&version), 4) != 4)
+            {
+                error = file.errorString();
+                return false;
+            }
+            return true;
+        }
+
+        char header[fileHeaderSize];
+        quint32 fileVersion = 0;
+        if (file.read(header, fileHeaderSize) != fileHeaderSize || std::memcmp(header, magic, 4) != 0)
+        {
+            error = QStringLiteral("%1 is not a game database").arg(file.fileName());
+            return false;
+        }
+        std::memcpy(&fileVersion, header + 4, 4);
+        if (fileVersion != version)
+        {
+            error = QStringLiteral("%1 has unsupported version %2").arg(file.fileName()).arg(fileVersion);
+            return false;
+        }
+        return file.seek(file.size());
+    }
+
+    bool isStartPosition(const Position &position)
+    {
+        static const Position start = Position::startPosition();
+        return std::memcmp(position.board, start.board, sizeof(start.board)) == 0
+                && position.sideToMove == start.sideToMove
+                && position.castling == start.castling
+                && position.epSquare == start.epSquare
+                && position.halfmoveClock == start.halfmoveClock
+                && position.fullmoveNumber == start.fullmoveNumber;
+    }
+}
+
+GameDbWriter::GameDbWriter(const QString &fileName)
+    : m_data(fileName), m_index(indexFileName(fileName))
+{
+    m_count = 0;
+}
+
+GameDbWriter::~GameDbWriter()
+{
+    flushIndex();
+}
+
+bool GameDbWriter::open()
+{
+    if (!m_data.open(QIODevice::ReadWrite))
+    {
+        m_error = m_data.errorString();
+        return false;
+    }
+    if (!m_index.open(QIODevice::ReadWrite))
+    {
+        m_error = m_index.errorString();
+        return false;
+    }
+    if (!prepareFile(m_data, dataMagic, m_error) || !prepareFile(m_index, indexMagic, m_error))
+        return false;
+
+    // Bytes after the last indexed game belong to an interrupted append and are overwritten.
+    m_count = (m_index.size() - fileHeaderSize) / qint64(sizeof(quint64));
+    if (m_count > 0)
+    {
+        quint64 last = 0;
+        GameDbHeader header;
+        m_index.seek(fileHeaderSize + (m_count - 1) * qint64(sizeof(quint64)));
+        m_index.read(reinterpret_cast<char *>(&last), sizeof(last));
+        m_data.seek(qint64(last));
+        m_data.read(reinterpret_cast<char *>(&header), sizeof(header));
+        const qint64 end = qint64(last) + qint64(sizeof(header)) + header.fenLength + header.moveBytes;
+        m_data.resize(end);
+        m_data.seek(end);
+    }
+    else
+    {
+        m_data.resize(fileHeaderSize);
+        m_data.seek(fileHeaderSize);
+    }
+    m_index.resize(fileHeaderSize + m_count * qint64(sizeof(quint64)));
+    m_index.seek(m_index.size());
+
+    return true;
+}
+
+void GameDbWriter::close()
+{
+    flushIndex();
+    m_data.close();
+    m_index.close();
+}
+
+QString GameDbWriter::errorString() const
+{
+    return m_error;
+}
+
+qint64 GameDbWriter::gameCount() const
+{
+    return m_count;
+}
+
+bool GameDbWriter::append(const PgnGame &game)
+{
+    if (game.moves.size() > 0xffff)
+    {
+        m_error = QStringLiteral("Game has too many moves");
+        return false;
+    }
+
+    m_buffer.clear();
+    if (!GameCodec::encode(game.start, game.moves, m_buffer))
+    {
+        m_error = QStringLiteral("Game contains an illegal move");
+        return false;
+    }
+
+    char fen[Fen::BufferSize];
+    std::size_t fenLength = 0;
+    if (!isStartPosition(game.start))
+        fenLength = Fen::write(game.start, fen, sizeof(fen));
+
+    GameDbHeader header;
+    header.moveBytes = quint32(m_buffer.size());
+    header.plies = quint16(game.moves.size());
+    header.whiteElo = game.whiteElo;
+    header.blackElo = game.blackElo;
+    header.result = game.result;
+    header.fenLength = quint8(fenLength);
+
+    const quint64 offset = quint64(m_data.pos());
+    const bool written = m_data.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header))
+            && m_data.write(fen, qint64(fenLength)) == qint64(fenLength)
+            && m_data.write(reinterpret_cast<const char *>(m_buffer.data()), qint64(m_buffer.size())) == qint64(m_buffer.size());
+    if (!written)
+    {
+        m_error = m_data.errorString();
+        return false;
+    }
+
+    m_pending.push_back(offset);
+    ++m_count;
+    return m_pending.size() < pendingLimit || flushIndex();
+}
+
+bool GameDbWriter::flushIndex()
+{
+    if (m_pending.empty())
+        return true;
+
+    const qint64 bytes = qint64(m_pending.size() * sizeof(quint64));
+    if (!m_data.flush() || m_index.write(reinterpret_cast<const char *>(m_pending.data()), bytes) != bytes || !m_index.flush())
+    {
+        m_error = m_data.error() != QFile::NoError ? m_data.errorString() : m_index.errorString();
+        return false;
+    }
+
+    m_pending.clear();
+    return true;
+}
+
+GameDbReader::GameDbReader(const QString &fileName)
+    : m_data(fileName), m_index(indexFileName(fileName))
+{
+    m_dataMap = nullptr;
+    m_offsets = nullptr;
+    m_dataSize = 0;
+    m_count = 0;
+}
+
+bool GameDbReader::open()
+{
+    for (QFile *file : {&m_data, &m_index})
+    {
+        if (!file->open(QIODevice::ReadOnly))
+        {
+            m_error = file->errorString();
+            return false;
+        }
+    }
+
+    m_dataSize = m_data.size();
+    const qint64 indexSize = m_index.size();
+    if (m_dataSize < fileHeaderSize || indexSize < fileHeaderSize)
+    {
+        m_error = QStringLiteral("%1 is not a game database").arg(m_data.fileName());
+        return false;
+    }
+
+    m_dataMap = m_data.map(0, m_dataSize);
+    const uchar *indexMap = m_index.map(0, indexSize);
+    if (!m_dataMap || !indexMap)
+    {
+        m_error = QStringLiteral("Could not map %1").arg(m_data.fileName());
+        return false;
+    }
+
+    quint32 dataVersion = 0;
+    quint32 indexVersion = 0;
+    std::memcpy(&dataVersion, m_dataMap + 4, 4);
+    std::memcpy(&indexVersion, indexMap + 4, 4);
+    if (std::memcmp(m_dataMap, dataMagic, 4) != 0 || std::memcmp(indexMap, indexMagic, 4) != 0
+            || dataVersion != version || indexVersion != version)
+    {
+        m_error = QStringLiteral("%1 is not a game database").arg(m_data.fileName());
+        return false;
+    }
+
+    m_offsets = reinterpret_cast<const quint64 *>(indexMap + fileHeaderSize);
+    m_count = (indexSize - fileHeaderSize) / qint64(sizeof(quint64));
+
+    return true;
+}
+
+QString GameDbReader::errorString() const
+{
+    return m_error;
+}
+
+qint64 GameDbReader::gameCount() const
+{
+    return m_count;
+}
+
+qint64 GameDbReader::size() const
+{
+    return m_dataSize + m_index.size();
+}
+
+GameDbHeader GameDbReader::header(qint64 index) const
+{
+    GameDbHeader header;
+    std::memcpy(&header, m_dataMap + m_offsets[index], sizeof(header));
+    return header;
+}
+
+bool GameDbReader::readGame(qint64 index, PgnGame &game) const
+{
+    if (index < 0 || index >= m_count)
+        return false;
+
+    const quint64 offset = m_offsets[index];
+    if (offset + sizeof(GameDbHeader) > quint64(m_dataSize))
+        return false;
+
+    const GameDbHeader header = this->header(index);
+    const uchar *fen = m_dataMap + offset + sizeof(GameDbHeader);
+    const uchar *moves = fen + header.fenLength;
+    if (quint64(moves - m_dataMap) + header.moveBytes > quint64(m_dataSize))
+        return false;
+
+    game.start = Position::startPosition();
+    if (header.fenLength > 0
+            && Fen::parse(std::string_view(reinterpret_cast<const char *>(fen), header.fenLength), game.start) != Fen::Error::None)
+        return false;
+
+    game.moves.clear();
+    game.result = PgnGame::Result(header.result);
+    game.whiteElo = header.whiteElo;
+    game.blackElo = header.blackElo;
+    game.offset = offset;
+    game.valid = GameCodec::decode(game.start, header.plies, moves, header.moveBytes, game.moves);
+
+    return game.valid;
+}
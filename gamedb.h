@@ -0,0 +1,85 @@
+#ifndef GAMEDB_H
+#define GAMEDB_H
+
+#include <vector>
+#include "pgn.h"
+#include <QFile>
+#include <QString>
+
+/*
+ * Compact game database made of two append-only files:
+ *
+ *   <name>      "CGDB" + version, then per game a GameDbHeader, the start FEN when the game
+ *               does not start from the initial position, and the GameCodec move stream.
+ *   <name>.idx  "CGDI" + version, then the 64 bit offset of every game in <name>.
+ *
+ * Index entries are written after the games they point to, so a game is only visible once it is complete.
+ * Both files use host byte order.
+ */
+struct GameDbHeader
+{
+    quint32 moveBytes;
+    quint16 plies;
+    quint16 whiteElo;
+    quint16 blackElo;
+    quint8 result;
+    quint8 fenLength;
+};
+static_assert(sizeof(GameDbHeader) == 12, "GameDbHeader is stored as is");
+
+class GameDbWriter
+{
+public:
+    explicit GameDbWriter(const QString &fileName);
+    ~GameDbWriter();
+
+    // Creates the files or opens them for appending.
+    bool open();
+    void close();
+    QString errorString() const;
+
+    // Returns false if the game holds an illegal move or could not be written.
+    bool append(const PgnGame &game);
+    qint64 gameCount() const;
+
+    // Makes all appended games visible to readers.
+    bool flushIndex();
+
+private:
+    QFile m_data;
+    QFile m_index;
+    std::vector<std::uint8_t> m_buffer;
+    std::vector<quint64> m_pending;
+    qint64 m_count;
+    QString m_error;
+};
+
+class GameDbReader
+{
+public:
+    explicit GameDbReader(const QString &fileName);
+
+    // Maps both files.
+    bool open();
+    QString errorString() const;
+
+    qint64 gameCount() const;
+    GameDbHeader header(qint64 index) const;
+
+    // Decodes game index, game.offset is set to its offset in the data file.
+    bool readGame(qint64 index, PgnGame &game) const;
+
+    // Size of both files in bytes.
+    qint64 size() const;
+
+private:
+    QFile m_data;
+    QFile m_index;
+    const uchar *m_dataMap;
+    const quint64 *m_offsets;
+    qint64 m_dataSize;
+    qint64 m_count;
+    QString m_error;
+};
+
+#endif // GAMEDB_H
@@ -0,0 +1,49 @@
+#ifndef KEYSEARCH_H
+#define KEYSEARCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Range of entries with the given key in an array sorted by a 64 bit hash key.
+ * Hash keys are close to uniform, so a few interpolation probes narrow the range
+ * before a binary search finds its exact bounds.
+ */
+template<typename Entry>
+std::pair<const Entry *, const Entry *> findKeyRange(const Entry *entries, std::int64_t count, std::uint64_t key)
+{
+    if (count == 0)
+        return {entries, entries};
+
+    // Everything before low is smaller than key, everything after high is larger.
+    std::int64_t low = 0;
+    std::int64_t high = count - 1;
+    for (int probe = 0; probe < 8 && high - low > 64; ++probe)
+    {
+        const std::uint64_t lowKey = entries[low].key;
+        const std::uint64_t highKey = entries[high].key;
+        if (key < lowKey || key > highKey)
+            return {entries, entries};
+        if (lowKey == highKey)
+            break;
+
+        const double fraction = double(key - lowKey) / double(highKey - lowKey);
+        const std::int64_t middle = low + std::clamp(std::int64_t(fraction * double(high - low)), std::int64_t(0), high - low);
+        if (entries[middle].key < key)
+            low = middle + 1;
+        else if (entries[middle].key > key)
+            high = middle - 1;
+        else
+            break;
+    }
+
+    const Entry *end = entries + high + 1;
+    const Entry *first = std::lower_bound(entries + low, end, key,
+                                          [](const Entry &entry, std::uint64_t value) { return entry.key < value; });
+    const Entry *last = std::upper_bound(first, end, key,
+                                         [](std::uint64_t value, const Entry &entry) { return value < entry.key; });
+    return {first, last};
+}
+
+#endif // KEYSEARCH_H
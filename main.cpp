@@ -8,5 +8,9 @@ int main(int argc, char *argv[])
     MainWindow w;
     w.show();
 
+    // Optional game database: chess [games.cgdb]
+    if (a.arguments().size() > 1)
+        w.openDatabase(a.arguments().at(1));
+
     return a.exec();
 }
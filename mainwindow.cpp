@@ -2,7 +2,11 @@
 #include "ui_mainwindow.h"
 #include "chessalgorithm.h"
 #include "chessview.h"
-#include "fieldhighlight.h"
+#include "zobrist.h"
+#include <QApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QThread>
 #include <QObject>
 #include <QLayout>
 #include <QPushButton>
@@ -18,6 +22,12 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
 
+    m_clicks = 0;
+    m_clickNs = 0;
+    m_maxClickNs = 0;
+    m_earlyClicks = 0;
+    m_earlyClickNs = 0;
+
     m_view = new ChessView(this);
 
     m_view->setPiece('P', QIcon(":/pieces/Chess_plt45.svg"));
@@ -99,6 +109,35 @@ MainWindow::MainWindow(QWidget *parent)
     m_lstCompMoves->resize(200, 180);
     m_lstCompMoves->show();
 
+    // Number of database games that reached the position on the board.
+    m_lblGames = new QLabel(this);
+    m_lblGames->move(860, 620);
+    m_lblGames->resize(250, 20);
+    m_lblGames->show();
+
+    // Moves played from the position on the board, with their results.
+    m_lstExplorer = new QListWidget(this);
+    m_lstExplorer->move(860, 645);
+    m_lstExplorer->resize(230, 190);
+    m_lstExplorer->show();
+
+    connect(m_algorithm->board(), &ChessBoard::nrOfMovesChanged, this, &MainWindow::updateDatabaseView);
+    connect(m_algorithm->board(), &ChessBoard::boardReset, this, &MainWindow::updateDatabaseView);
+
+    // Hint from a short search, computed next to the GUI.
+    QPushButton *btnHint = new QPushButton("Tip", this);
+    btnHint->move(860, 845);
+    btnHint->resize(80, 30);
+    btnHint->show();
+    m_lblHint = new QLabel(this);
+    m_lblHint->move(950, 845);
+    m_lblHint->resize(150, 30);
+    m_lblHint->show();
+    connect(btnHint, &QPushButton::clicked, m_algorithm, &ChessAlgorithm::requestHint);
+    connect(m_algorithm, &ChessAlgorithm::hintReady, this, [this](const QString &move) {
+        m_lblHint->setText("Tip: " + move);
+    });
+
     // Set first engine move.
     m_algorithm->board()->setNrOfEngMoves(1);
 
@@ -111,8 +150,8 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_algorithm, &ChessAlgorithm::checkYourself, this, &MainWindow::checkYourself);
 
 
-    // This needs to connect to the UCI engine.
-    connect(m_algorithm->engine(), &UciEngine::engineMove, this, &MainWindow::updateBestMoveList);
+    // Engine moves, from the UCI engine or the analysis cache.
+    connect(m_algorithm, &ChessAlgorithm::engineMove, this, &MainWindow::updateBestMoveList);
 
     // Connect SIGNAL when there is checkmate or stale mate.
     connect(m_algorithm, &ChessAlgorithm::gameOver, this, &MainWindow::gameOver);
@@ -166,6 +205,9 @@ void MainWindow::playerChanged()
 {
     qInfo() << Q_FUNC_INFO;
 
+    // A hint belongs to the previous position.
+    m_lblHint->setText("");
+
     ChessAlgorithm::Player player = m_algorithm->currentPlayer();
     if (player == ChessAlgorithm::BlackPlayer)
     {
@@ -186,6 +228,9 @@ void MainWindow::viewClicked(const QPoint &field)
 
     qInfo() << Q_FUNC_INFO;
 
+    QElapsedTimer clickTimer;
+    clickTimer.start();
+
 
     QString whitePieces = "PRNBQK";
     QString blackPieces = "prnbqk";
@@ -215,31 +260,32 @@ void MainWindow::viewClicked(const QPoint &field)
             m_clickPoint = field;
 
             // Highlight the selected piece.
-            m_selectedField = new FieldHighlight(field.x(), field.y(), QColor(246, 246, 132), FieldHighlight::Rectangle);
-            m_view->addHighlight(m_selectedField);
-
-            // Highlight possible moves for selected piece.
-            m_algorithm->setMoves(field.x(), field.y());
-            m_algorithm->setEngineMoves( m_algorithm->getFENBoard());
-
-            // Get the possible moves from the algorithm.
-            QHash<QString, bool> m_moves = m_algorithm->getMoves();
-            QHash<QString, bool>::iterator iter;
-            for (iter = m_moves.begin(); iter != m_moves.end(); ++iter)
+            m_view->setHighlights(ChessView::SelectedField, ChessView::squareMask(field.x(), field.y()));
+
+            // Highlight possible moves for selected piece, the algorithm has them ready for this turn
+            // unless the click came right after the position changed.
+            const bool early = !m_algorithm->hasRules();
+            const quint64 targets = m_algorithm->legalTargets(field.x(), field.y());
+            const quint64 captures = m_algorithm->captureTargets(field.x(), field.y());
+            m_view->setHighlights(ChessView::MoveTarget, targets & ~captures);
+            m_view->setHighlights(ChessView::CaptureTarget, captures);
+
+            const qint64 clickNs = clickTimer.nsecsElapsed();
+            ++m_clicks;
+            m_clickNs += clickNs;
+            m_maxClickNs = qMax(m_maxClickNs, clickNs);
+            qDebug() << "Click to highlight:" << clickNs / 1000 << "us, average" << m_clickNs / m_clicks / 1000
+                     << "us, max" << m_maxClickNs / 1000 << "us over" << m_clicks << "clicks";
+            if (early)
             {
-                qDebug() << iter.key() << ": " << iter.value();
-                QPoint p = m_algorithm->toCoordinates(iter.key());
-                if (iter.key().contains("x"))
-                {
-                    m_possibleField = new FieldHighlight(p.x(), p.y(), QColor(250,244,220), FieldHighlight::Rectangle);
-                }
-                else
-                {
-                    m_possibleField = new FieldHighlight(p.x(), p.y(), QColor(250,244,220), FieldHighlight::Circle);
-                }
-                m_view->addHighlight(m_possibleField);
+                ++m_earlyClicks;
+                m_earlyClickNs += clickNs;
+                qDebug() << "Click before the rules were ready:" << clickNs / 1000 << "us, average"
+                         << m_earlyClickNs / m_earlyClicks / 1000 << "us over" << m_earlyClicks << "clicks";
             }
 
+            m_algorithm->setEngineMoves( m_algorithm->getFENBoard());
+
         }
     }
     else
@@ -250,16 +296,9 @@ void MainWindow::viewClicked(const QPoint &field)
             m_algorithm->move(m_clickPoint, field);
         }
 
-        // Clean up piece highlight.
+        // Clean up piece and moves highlight.
         m_clickPoint = QPoint();
-        m_view->removeHighlight(m_selectedField);
-
-        // Clean up moves highlight.
-        int hlCount = m_view->highlightCount();
-        for (size_t i=0; i<hlCount; i++)
-        {
-            m_view->removeHighlight(m_view->highlight(0));
-        }
+        m_view->clearHighlights();
     }
 }
 
@@ -289,7 +328,9 @@ void MainWindow::highlightCheck(const QPoint &p)
         item->setText(text + "\t" + move);
     }
 
-    emit m_view->clicked(p);
+    // The status arrives after the move, so the king is only marked; a piece the player already selected keeps its mark.
+    if (m_clickPoint.isNull())
+        m_view->setHighlights(ChessView::SelectedField, ChessView::squareMask(p.x(), p.y()));
 }
 
 void MainWindow::unCheck()
@@ -314,6 +355,113 @@ void MainWindow::gameOver(ChessAlgorithm::Result result)
     QApplication::quit();
 }
 
+bool MainWindow::openDatabase(const QString &fileName)
+{
+    auto database = std::make_unique<GameDbReader>(fileName);
+    if (!database->open())
+    {
+        QMessageBox::warning(this, "Database", database->errorString());
+        return false;
+    }
+
+    // Derived files are rebuilt when the database index was written after them.
+    const QDateTime databaseModified = QFileInfo(fileName + ".idx").lastModified();
+    const auto isStale = [&](const QString &derivedFileName) {
+        const QFileInfo info(derivedFileName);
+        return !info.exists() || info.lastModified() < databaseModified;
+    };
+
+    const QString indexFileName = PositionIndex::fileNameFor(fileName);
+    const QString explorerFileName = OpeningExplorer::fileNameFor(fileName);
+    if (isStale(indexFileName) || isStale(explorerFileName))
+    {
+        QString error;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool built = true;
+        if (isStale(indexFileName))
+        {
+            qDebug() << "Building position index" << indexFileName;
+            built = PositionIndex::build(*database, indexFileName, QThread::idealThreadCount(), &error);
+        }
+        if (built && isStale(explorerFileName))
+        {
+            qDebug() << "Building opening explorer" << explorerFileName;
+            built = OpeningExplorer::build(*database, explorerFileName, QThread::idealThreadCount(), 40, &error);
+        }
+        QApplication::restoreOverrideCursor();
+        if (!built)
+        {
+            QMessageBox::warning(this, "Database", error);
+            return false;
+        }
+    }
+
+    auto index = std::make_unique<PositionIndex>(indexFileName);
+    if (!index->open())
+    {
+        QMessageBox::warning(this, "Database", index->errorString());
+        return false;
+    }
+
+    auto explorer = std::make_unique<OpeningExplorer>(explorerFileName);
+    if (!explorer->open())
+    {
+        QMessageBox::warning(this, "Database", explorer->errorString());
+        return false;
+    }
+
+    m_database = std::move(database);
+    m_positionIndex = std::move(index);
+    m_explorer = std::move(explorer);
+    updateDatabaseView();
+
+    return true;
+}
+
+void MainWindow::updateDatabaseView()
+{
+    if (!m_positionIndex || !m_explorer)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    const Position position = m_view->board()->position();
+    const quint64 key = Zobrist::key(position);
+    const qint64 count = m_positionIndex->find(key).gameCount();
+    const OpeningExplorer::Range continuations = m_explorer->find(key);
+    qDebug() << "Database lookup:" << count << "games," << continuations.size() << "moves in" << timer.nsecsElapsed() / 1000 << "us";
+
+    m_lblGames->setText(QStringLiteral("Partijen met deze stelling: %1").arg(count));
+
+    // One row per move: games, white wins / draws / black wins in percent and the average rating.
+    m_lstExplorer->clear();
+    for (const OpeningExplorerEntry &entry : continuations)
+    {
+        const Move move = Move::fromData(entry.move);
+        const QChar piece = position.board[move.from()];
+        const int fromColumn = Position::column(move.from());
+        const int fromRank = Position::rank(move.from());
+        const int toColumn = Position::column(move.to());
+        const int toRank = Position::rank(move.to());
+        const bool castle = (piece == 'K' || piece == 'k') && qAbs(toColumn - fromColumn) == 2;
+        const bool capture = position.board[move.to()] != ' ' || ((piece == 'P' || piece == 'p') && fromColumn != toColumn);
+        QString notation = castle
+                ? m_algorithm->toAlgebraicCastle(piece, fromColumn, fromRank, toColumn, toRank, toColumn > fromColumn)
+                : m_algorithm->toAlgebraic(piece, fromColumn, fromRank, toColumn, toRank, capture);
+        if (move.promotion() != Move::NoPromotion)
+            notation += "=" + QString(QChar::fromLatin1(move.promotionLetter()).toUpper());
+
+        const double games = entry.games();
+        m_lstExplorer->addItem(QStringLiteral("%1\t%2\t%3/%4/%5%\t%6")
+                               .arg(notation)
+                               .arg(entry.games())
+                               .arg(qRound(100 * entry.whiteWins / games))
+                               .arg(qRound(100 * entry.draws / games))
+                               .arg(qRound(100 * entry.blackWins / games))
+                               .arg(entry.averageRating ? QString::number(entry.averageRating) : QString("-")));
+    }
+}
+
 void MainWindow::checkYourself()
 {
     QMessageBox::information(this, "Illegal move!", QStringLiteral("Illegal move! You are checking yourself"));
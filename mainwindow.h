@@ -1,11 +1,15 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <memory>
 #include <QMainWindow>
 #include <QLabel>
 #include <QListWidget>
 #include "chessview.h"
 #include "chessalgorithm.h"
+#include "gamedb.h"
+#include "openingexplorer.h"
+#include "positionindex.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,11 +29,15 @@ public slots:
     void highlightCheck(const QPoint &field);
     void unCheck();
 
+    // Opens a game database, its position index and explorer are built when missing or out of date.
+    bool openDatabase(const QString &fileName);
+
 private slots:
     void gameOver(ChessAlgorithm::Result);
     void updateList();
     void updateBestMoveList(QString move);
     void checkYourself();
+    void updateDatabaseView();
 
 private:
     Ui::MainWindow *ui;
@@ -38,11 +46,25 @@ private:
     QPointer<QLabel> m_lblCheck;
     QPointer<QListWidget> m_lstMoves;
     QPointer<QListWidget> m_lstCompMoves;
+    QPointer<QLabel> m_lblGames;
+    QPointer<QListWidget> m_lstExplorer;
+    QPointer<QLabel> m_lblHint;
+
+    std::unique_ptr<GameDbReader> m_database;
+    std::unique_ptr<PositionIndex> m_positionIndex;
+    std::unique_ptr<OpeningExplorer> m_explorer;
 
     QPointer<ChessAlgorithm> m_algorithm;
     QPoint m_clickPoint;
-    Highlight *m_selectedField;
-    Highlight *m_possibleField;
+
+    // Time from a click on a piece until its moves are highlighted.
+    qint64 m_clicks;
+    qint64 m_clickNs;
+    qint64 m_maxClickNs;
+
+    // The same for clicks that came before the rules worker answered for the position.
+    qint64 m_earlyClicks;
+    qint64 m_earlyClickNs;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,817 @@
+/**
+ * @brief chess-match: plays games between two UCI engines and rates the first against the second.
+ * Build together with fen.cpp, movegen.cpp, pgn.cpp, position.cpp, san.cpp, zobrist.cpp,
+ * uciengine.cpp, uciengineworker.cpp and uciparser.cpp.
+ *
+ *   chess-match --engine "cmd=path [name=A] [option.Hash=64 ...]" --engine "cmd=path [name=B] ..."
+ *               [--openings file] [--games n] [--concurrency n] [--tc [moves/]seconds[+increment]]
+ *               [--pgn file]
+ *
+ * Every slot keeps a warm process of both engines and plays one game at a time, so with the
+ * default of one slot per core every core runs one search. Each opening of the EPD/FEN file is
+ * played twice with the colours swapped.
+ *
+ * Clocks are charged the time between writing "go" and reading "bestmove" on the engine I/O
+ * thread, so queueing in this process is not counted against the engines. An engine that
+ * exceeds its time by more than the margin loses, one that does not answer at all is restarted.
+ *
+ * Games end by the rules (mate, stalemate, fifty moves, threefold repetition, dead position)
+ * or are adjudicated by score once both engines agree on the outcome for some moves.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../fen.h"
+#include "../movegen.h"
+#include "../pgn.h"
+#include "../uciengine.h"
+#include "../zobrist.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+struct EngineConfig
+{
+    QString name;
+    QString command;
+    QList<QPair<QString, QString>> options;
+};
+
+// Times in nanoseconds. moves is 0 for a game in base time plus increment.
+struct TimeControl
+{
+    int moves = 0;
+    qint64 baseNs = 0;
+    qint64 incrementNs = 0;
+    QString text;
+};
+
+// Thresholds in centipawns, a count of 0 switches the rule off.
+struct Adjudication
+{
+    int resignScore = 0;
+    int resignMoves = 0;
+    int drawMoveNumber = 0;
+    int drawScore = 0;
+    int drawMoves = 0;
+};
+
+// Game state of one slot. Engine indices refer to the configurations, colours to the board.
+struct Game
+{
+    // One based, 0 while the slot is idle.
+    int number = 0;
+
+    // Configuration playing white; the engine for a colour is colour ^ white.
+    int white = 0;
+
+    Position position;
+    std::vector<Move> moves;
+    std::vector<std::uint64_t> keys;
+    Position start;
+    QString startFen;
+    QString moveText;
+
+    qint64 clockNs[2] = {0, 0};
+    int movesPlayed[2] = {0, 0};
+
+    // Engine whose search is running, -1 between searches.
+    int searching = -1;
+    bool hasScore = false;
+    int score = 0;
+
+    // Consecutive moves per colour with a score beyond the resign threshold, and within the draw one.
+    int losingMoves[2] = {0, 0};
+    int winningMoves[2] = {0, 0};
+    int drawPlies = 0;
+};
+
+struct Slot
+{
+    std::unique_ptr<UciEngine> engines[2];
+
+    // Reached Idle once, so a later exit is a crash and not a bad command.
+    bool started[2] = {false, false};
+
+    // Stopped on purpose, the next game waits until the engine reports it has gone.
+    bool restarting[2] = {false, false};
+
+    QTimer watchdog;
+    Game game;
+};
+
+// A mate score beyond every centipawn score, closer mates score higher.
+static constexpr int MateScore = 100000;
+
+// Extra time before an engine that does not answer is given up on.
+static constexpr qint64 WatchdogGraceMs = 5000;
+
+static int scoreOf(const UciInfo &info)
+{
+    if (info.scoreType == UciInfo::Mate)
+        return info.score > 0 ? MateScore - info.score : -MateScore - info.score;
+    return info.score;
+}
+
+static bool isBareKing(const Position &position, Position::Color color)
+{
+    for (const char piece : position.board)
+    {
+        if (piece != ' ' && Position::isWhite(piece) == (color == Position::White) && piece != 'K' && piece != 'k')
+            return false;
+    }
+    return true;
+}
+
+// Neither side can mate: at most one minor piece, or only bishops that all stand on one square colour.
+static bool isDeadPosition(const Position &position)
+{
+    int minors = 0;
+    int knights = 0;
+    int bishopColours = 0;
+    for (int square = 0; square < 64; ++square)
+    {
+        switch (position.board[square])
+        {
+        case ' ': case 'K': case 'k':
+            break;
+        case 'N': case 'n':
+            ++knights;
+            ++minors;
+            break;
+        case 'B': case 'b':
+            bishopColours |= 1 << ((square / 8 + square % 8) % 2);
+            ++minors;
+            break;
+        default:
+            return false;
+        }
+    }
+    return minors <= 1 || (knights == 0 && bishopColours != 3);
+}
+
+// "cmd=path name=A option.Hash=64", the name defaults to the file name of the command.
+static bool parseEngine(const QString &spec, EngineConfig &config)
+{
+    for (const QString &field : spec.split(' ', Qt::SkipEmptyParts))
+    {
+        const qsizetype equals = field.indexOf('=');
+        if (equals <= 0)
+            return false;
+
+        const QString key = field.left(equals);
+        const QString value = field.mid(equals + 1);
+        if (key == "cmd")
+            config.command = value;
+        else if (key == "name")
+            config.name = value;
+        else if (key.startsWith("option."))
+            config.options.append(qMakePair(key.mid(7), value));
+        else
+            return false;
+    }
+
+    if (config.name.isEmpty())
+        config.name = config.command.section('/', -1);
+    return !config.command.isEmpty();
+}
+
+// "[moves/]seconds[+increment]", seconds may have a fraction.
+static bool parseTimeControl(const QString &text, TimeControl &timeControl)
+{
+    QString rest = text;
+    bool ok = true;
+    timeControl.text = text;
+
+    const qsizetype slash = rest.indexOf('/');
+    if (slash >= 0)
+    {
+        timeControl.moves = rest.left(slash).toInt(&ok);
+        if (!ok || timeControl.moves <= 0)
+            return false;
+        rest = rest.mid(slash + 1);
+    }
+
+    const qsizetype plus = rest.indexOf('+');
+    if (plus >= 0)
+    {
+        timeControl.incrementNs = qint64(rest.mid(plus + 1).toDouble(&ok) * 1e9);
+        if (!ok || timeControl.incrementNs < 0)
+            return false;
+        rest = rest.left(plus);
+    }
+
+    timeControl.baseNs = qint64(rest.toDouble(&ok) * 1e9);
+    return ok && timeControl.baseNs > 0;
+}
+
+static bool loadOpenings(const QString &fileName, std::vector<Position> &openings, QTextStream &err)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        err << "Cannot open " << fileName << ": " << file.errorString() << Qt::endl;
+        return false;
+    }
+
+    int lineNumber = 0;
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        Position position;
+        std::string_view operations;
+        const Fen::Error error = Fen::parseEpd(std::string_view(line.constData(), std::size_t(line.size())), position, operations);
+        if (error != Fen::Error::None)
+        {
+            err << fileName << ":" << lineNumber << ": " << Fen::errorString(error) << Qt::endl;
+            continue;
+        }
+        openings.push_back(position);
+    }
+
+    if (openings.empty())
+    {
+        err << fileName << " holds no usable positions" << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+static QString fenString(const Position &position)
+{
+    char fen[Fen::BufferSize];
+    const std::size_t length = Fen::write(position, fen, sizeof(fen));
+    return QString::fromLatin1(fen, qsizetype(length));
+}
+
+/*
+ * Runs the games on the slots from the event loop of the main thread. The engines do their
+ * I/O on threads of their own and report back with queued signals.
+ */
+class Match
+{
+public:
+    Match(QCoreApplication &app, const EngineConfig *engines, std::vector<Position> openings, int games,
+          int concurrency, const TimeControl &timeControl, const Adjudication &adjudication, qint64 marginNs,
+          QFile *pgn);
+
+    void start();
+    inline bool isFinished() const { return m_finished == m_games || m_failed; }
+    inline bool hasFailed() const { return m_failed; }
+
+    void printSummary(QTextStream &out) const;
+
+private:
+    void startGame(Slot &slot);
+    void requestMove(Slot &slot);
+    void moveReceived(Slot &slot, int engine, const UciBestMove &bestMove);
+    void infoReceived(Slot &slot, int engine, const UciInfo &info);
+    void stateChanged(Slot &slot, int engine, UciEngine::State state);
+    void searchTimedOut(Slot &slot);
+
+    // True when the game is over after the last move.
+    bool checkGameEnd(Slot &slot);
+    void updateAdjudication(Game &game, Position::Color color);
+    void finishGame(Slot &slot, PgnGame::Result result, const char *termination, const QString &reason);
+    void writePgn(const Game &game, PgnGame::Result result, const char *termination);
+
+    static PgnGame::Result winFor(Position::Color color);
+
+    QCoreApplication &m_app;
+    EngineConfig m_engines[2];
+    std::vector<Position> m_openings;
+    TimeControl m_timeControl;
+    Adjudication m_adjudication;
+    qint64 m_marginNs;
+    QFile *m_pgn;
+    QTextStream m_out;
+
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    int m_games;
+    int m_nextGame;
+    int m_finished;
+    bool m_failed;
+
+    // From the point of view of the first engine.
+    int m_wins;
+    int m_losses;
+    int m_draws;
+    QElapsedTimer m_timer;
+};
+
+Match::Match(QCoreApplication &app, const EngineConfig *engines, std::vector<Position> openings, int games,
+             int concurrency, const TimeControl &timeControl, const Adjudication &adjudication, qint64 marginNs,
+             QFile *pgn)
+    : m_app(app), m_openings(std::move(openings)), m_timeControl(timeControl), m_adjudication(adjudication),
+      m_out(stdout)
+{
+    m_engines[0] = engines[0];
+    m_engines[1] = engines[1];
+    m_marginNs = marginNs;
+    m_pgn = pgn;
+    m_games = games;
+    m_nextGame = 0;
+    m_finished = 0;
+    m_failed = false;
+    m_wins = 0;
+    m_losses = 0;
+    m_draws = 0;
+
+    for (int index = 0; index < qMin(concurrency, games); ++index)
+    {
+        auto slot = std::make_unique<Slot>();
+        Slot *current = slot.get();
+        for (int engine = 0; engine < 2; ++engine)
+        {
+            slot->engines[engine] = std::make_unique<UciEngine>();
+            UciEngine *uci = slot->engines[engine].get();
+
+            // One search thread per engine, the slots are what use the cores.
+            uci->setOption("Threads", "1");
+            for (const QPair<QString, QString> &option : std::as_const(m_engines[engine].options))
+                uci->setOption(option.first, option.second);
+
+            QObject::connect(uci, &UciEngine::bestMove, uci, [this, current, engine](const UciBestMove &bestMove) {
+                moveReceived(*current, engine, bestMove);
+            });
+            QObject::connect(uci, &UciEngine::info, uci, [this, current, engine](const UciInfo &info) {
+                infoReceived(*current, engine, info);
+            });
+            QObject::connect(uci, &UciEngine::stateChanged, uci, [this, current, engine](UciEngine::State state) {
+                stateChanged(*current, engine, state);
+            });
+        }
+
+        slot->watchdog.setSingleShot(true);
+        QObject::connect(&slot->watchdog, &QTimer::timeout, &slot->watchdog, [this, current] {
+            searchTimedOut(*current);
+        });
+        m_slots.push_back(std::move(slot));
+    }
+}
+
+void Match::start()
+{
+    m_timer.start();
+    for (const std::unique_ptr<Slot> &slot : m_slots)
+        startGame(*slot);
+}
+
+PgnGame::Result Match::winFor(Position::Color color)
+{
+    return color == Position::White ? PgnGame::WhiteWin : PgnGame::BlackWin;
+}
+
+void Match::startGame(Slot &slot)
+{
+    if (m_failed || m_nextGame >= m_games || slot.restarting[0] || slot.restarting[1])
+        return;
+
+    const int index = m_nextGame++;
+    Game &game = slot.game;
+    game = Game();
+    game.number = index + 1;
+    game.white = index % 2;
+    game.start = m_openings[std::size_t(index / 2) % m_openings.size()];
+    game.startFen = fenString(game.start);
+    game.position = game.start;
+    game.keys.push_back(Zobrist::key(game.position));
+    game.clockNs[Position::White] = game.clockNs[Position::Black] = m_timeControl.baseNs;
+
+    for (int engine = 0; engine < 2; ++engine)
+    {
+        slot.engines[engine]->startEngine(m_engines[engine].command);
+        slot.engines[engine]->newGame();
+    }
+
+    // An opening may already be decided.
+    if (!checkGameEnd(slot))
+        requestMove(slot);
+}
+
+void Match::requestMove(Slot &slot)
+{
+    Game &game = slot.game;
+    const Position::Color color = game.position.sideToMove;
+    const auto milliseconds = [](qint64 ns) { return QString::number(qMax<qint64>(1, ns / 1000000)); };
+
+    QString go = QStringLiteral("go wtime %1 btime %2 winc %3 binc %3")
+                     .arg(milliseconds(game.clockNs[Position::White]), milliseconds(game.clockNs[Position::Black]),
+                          QString::number(m_timeControl.incrementNs / 1000000));
+    if (m_timeControl.moves > 0)
+        go += " movestogo " + QString::number(m_timeControl.moves - game.movesPlayed[color] % m_timeControl.moves);
+
+    game.searching = color ^ game.white;
+    game.hasScore = false;
+    slot.watchdog.start(int(qMax<qint64>(0, game.clockNs[color] + m_marginNs) / 1000000 + WatchdogGraceMs));
+    slot.engines[game.searching]->analyse(game.startFen + game.moveText, go);
+}
+
+void Match::infoReceived(Slot &slot, int engine, const UciInfo &info)
+{
+    Game &game = slot.game;
+    if (game.number == 0 || engine != game.searching || info.multiPv != 1 || info.scoreType == UciInfo::NoScore
+            || info.lowerBound || info.upperBound)
+        return;
+
+    game.hasScore = true;
+    game.score = scoreOf(info);
+}
+
+void Match::moveReceived(Slot &slot, int engine, const UciBestMove &bestMove)
+{
+    Game &game = slot.game;
+    if (game.number == 0 || engine != game.searching)
+        return;
+
+    slot.watchdog.stop();
+    game.searching = -1;
+
+    const Position::Color color = game.position.sideToMove;
+    const QString &name = m_engines[engine].name;
+    game.clockNs[color] -= bestMove.elapsedNs;
+    if (game.clockNs[color] < -m_marginNs)
+    {
+        // Flag fall against a bare king is a draw, that side can never mate.
+        const Position::Color opponent = game.position.opponent();
+        const bool draw = isBareKing(game.position, opponent);
+        finishGame(slot, draw ? PgnGame::Draw : winFor(opponent), "time forfeit", name + " loses on time");
+        return;
+    }
+
+    MoveList legal;
+    MoveGen::generateLegal(game.position, legal);
+    if (std::find(legal.begin(), legal.end(), bestMove.move) == legal.end() || bestMove.move.isNull())
+    {
+        char text[6];
+        bestMove.move.writeUci(text);
+        finishGame(slot, winFor(game.position.opponent()), "rules infraction",
+                   name + " plays an illegal move: " + QString::fromLatin1(text));
+        return;
+    }
+
+    game.clockNs[color] += m_timeControl.incrementNs;
+    ++game.movesPlayed[color];
+    if (m_timeControl.moves > 0 && game.movesPlayed[color] % m_timeControl.moves == 0)
+        game.clockNs[color] += m_timeControl.baseNs;
+    updateAdjudication(game, color);
+
+    char text[6];
+    const std::size_t length = bestMove.move.writeUci(text);
+    if (game.moveText.isEmpty())
+        game.moveText = " moves";
+    game.moveText += ' ';
+    game.moveText += QLatin1String(text, qsizetype(length));
+    game.moves.push_back(bestMove.move);
+    game.position.makeMove(bestMove.move);
+    game.keys.push_back(Zobrist::key(game.position));
+
+    if (!checkGameEnd(slot))
+        requestMove(slot);
+}
+
+// Streaks use the score the mover reported for its own move, from its own point of view.
+void Match::updateAdjudication(Game &game, Position::Color color)
+{
+    const int score = game.score;
+    const bool scored = game.hasScore;
+
+    if (m_adjudication.resignMoves > 0)
+    {
+        game.losingMoves[color] = scored && score <= -m_adjudication.resignScore ? game.losingMoves[color] + 1 : 0;
+        game.winningMoves[color] = scored && score >= m_adjudication.resignScore ? game.winningMoves[color] + 1 : 0;
+    }
+    if (m_adjudication.drawMoves > 0)
+        game.drawPlies = scored && std::abs(score) <= m_adjudication.drawScore ? game.drawPlies + 1 : 0;
+}
+
+bool Match::checkGameEnd(Slot &slot)
+{
+    const Game &game = slot.game;
+    const Position &position = game.position;
+
+    MoveList legal;
+    MoveGen::generateLegal(position, legal);
+    switch (MoveGen::status(position, legal))
+    {
+    case MoveGen::Status::Checkmate:
+        finishGame(slot, winFor(position.opponent()), "normal",
+                   position.sideToMove == Position::White ? "Black mates" : "White mates");
+        return true;
+    case MoveGen::Status::Stalemate:
+        finishGame(slot, PgnGame::Draw, "normal", "Stalemate");
+        return true;
+    default:
+        break;
+    }
+
+    if (position.halfmoveClock >= 100)
+    {
+        finishGame(slot, PgnGame::Draw, "normal", "Fifty move rule");
+        return true;
+    }
+
+    // Only positions since the last capture or pawn move can repeat, and only with the same side to move.
+    const std::uint64_t key = game.keys.back();
+    const int last = int(game.keys.size()) - 1;
+    int repetitions = 1;
+    for (int index = last - 2; index >= qMax(0, last - int(position.halfmoveClock)); index -= 2)
+    {
+        if (game.keys[std::size_t(index)] == key)
+            ++repetitions;
+    }
+    if (repetitions >= 3)
+    {
+        finishGame(slot, PgnGame::Draw, "normal", "Threefold repetition");
+        return true;
+    }
+
+    if (isDeadPosition(position))
+    {
+        finishGame(slot, PgnGame::Draw, "normal", "Insufficient mating material");
+        return true;
+    }
+
+    for (const Position::Color color : {Position::White, Position::Black})
+    {
+        const int other = color == Position::White ? Position::Black : Position::White;
+        if (m_adjudication.resignMoves > 0 && game.losingMoves[color] >= m_adjudication.resignMoves
+                && game.winningMoves[other] >= m_adjudication.resignMoves)
+        {
+            finishGame(slot, winFor(Position::Color(other)), "adjudication",
+                       color == Position::White ? "White resigns" : "Black resigns");
+            return true;
+        }
+    }
+
+    if (m_adjudication.drawMoves > 0 && position.fullmoveNumber > m_adjudication.drawMoveNumber
+            && game.drawPlies >= 2 * m_adjudication.drawMoves)
+    {
+        finishGame(slot, PgnGame::Draw, "adjudication", "Draw by adjudication");
+        return true;
+    }
+
+    return false;
+}
+
+// Hangs are handled like a flag fall; the engine is restarted before the slot plays on.
+void Match::searchTimedOut(Slot &slot)
+{
+    Game &game = slot.game;
+    if (game.number == 0 || game.searching < 0)
+        return;
+
+    const Position::Color opponent = game.position.opponent();
+    const bool draw = isBareKing(game.position, opponent);
+    finishGame(slot, draw ? PgnGame::Draw : winFor(opponent), "time forfeit",
+               m_engines[game.searching].name + " does not answer");
+}
+
+void Match::stateChanged(Slot &slot, int engine, UciEngine::State state)
+{
+    if (state == UciEngine::Idle)
+    {
+        slot.started[engine] = true;
+        return;
+    }
+    if (state != UciEngine::NotRunning)
+        return;
+
+    if (slot.restarting[engine])
+    {
+        slot.restarting[engine] = false;
+        startGame(slot);
+        return;
+    }
+
+    if (!slot.started[engine])
+    {
+        QTextStream(stderr) << "Cannot start " << m_engines[engine].name << " (" << m_engines[engine].command << ")" << Qt::endl;
+        m_failed = true;
+        m_app.exit(1);
+        return;
+    }
+
+    // A crash loses the game, the engine is started again for the next one.
+    Game &game = slot.game;
+    if (game.number == 0)
+        return;
+    slot.watchdog.stop();
+    game.searching = -1;
+    const Position::Color color = Position::Color(engine ^ game.white);
+    finishGame(slot, winFor(color == Position::White ? Position::Black : Position::White), "abandoned",
+               m_engines[engine].name + " disconnects");
+}
+
+void Match::finishGame(Slot &slot, PgnGame::Result result, const char *termination, const QString &reason)
+{
+    Game &game = slot.game;
+    const QString &white = m_engines[game.white].name;
+    const QString &black = m_engines[game.white ^ 1].name;
+
+    if (result == PgnGame::Draw)
+        ++m_draws;
+    else if ((result == PgnGame::WhiteWin) == (game.white == 0))
+        ++m_wins;
+    else
+        ++m_losses;
+    ++m_finished;
+
+    writePgn(game, result, termination);
+
+    const int played = m_wins + m_losses + m_draws;
+    m_out << "Game " << game.number << " (" << white << " vs " << black << "): " << Pgn::resultString(result)
+          << " {" << reason << "}" << Qt::endl;
+    m_out << "Score of " << m_engines[0].name << " vs " << m_engines[1].name << ": " << m_wins << " - " << m_losses
+          << " - " << m_draws << " [" << QString::number((m_wins + m_draws / 2.0) / played, 'f', 3) << "] "
+          << played << Qt::endl;
+
+    // An engine still searching is stuck, it is replaced by a fresh process.
+    if (game.searching >= 0 && slot.engines[game.searching]->isRunning())
+    {
+        slot.restarting[game.searching] = true;
+        slot.engines[game.searching]->stopEngine();
+    }
+    slot.watchdog.stop();
+    game.number = 0;
+    game.searching = -1;
+
+    if (isFinished())
+        m_app.quit();
+    else
+        startGame(slot);
+}
+
+void Match::writePgn(const Game &game, PgnGame::Result result, const char *termination)
+{
+    if (!m_pgn)
+        return;
+
+    std::string pgn;
+    Pgn::appendTag(pgn, "Event", "chess-match");
+    Pgn::appendTag(pgn, "Site", "?");
+    Pgn::appendTag(pgn, "Date", QDate::currentDate().toString("yyyy.MM.dd").toStdString());
+    Pgn::appendTag(pgn, "Round", std::to_string(game.number));
+    Pgn::appendTag(pgn, "White", m_engines[game.white].name.toStdString());
+    Pgn::appendTag(pgn, "Black", m_engines[game.white ^ 1].name.toStdString());
+    Pgn::appendTag(pgn, "Result", Pgn::resultString(result));
+    if (game.startFen != fenString(Position::startPosition()))
+    {
+        Pgn::appendTag(pgn, "SetUp", "1");
+        Pgn::appendTag(pgn, "FEN", game.startFen.toStdString());
+    }
+    Pgn::appendTag(pgn, "TimeControl", m_timeControl.text.toStdString());
+    Pgn::appendTag(pgn, "Termination", termination);
+    Pgn::appendTag(pgn, "PlyCount", std::to_string(game.moves.size()));
+    pgn += '\n';
+    Pgn::appendMoveText(pgn, game.start, game.moves, result);
+
+    m_pgn->write(pgn.data(), qint64(pgn.size()));
+    m_pgn->flush();
+}
+
+/*
+ * The Elo difference follows from the mean score s as -400 log10(1 / s - 1). Its 95% interval
+ * comes from the standard error of the mean game score, mapped through the same curve.
+ * LOS is the chance that the first engine is the stronger one, from wins and losses alone.
+ */
+void Match::printSummary(QTextStream &out) const
+{
+    const int games = m_wins + m_losses + m_draws;
+    if (games == 0)
+        return;
+
+    const double score = (m_wins + m_draws / 2.0) / games;
+    const double variance = (m_wins * (1.0 - score) * (1.0 - score) + m_losses * score * score
+                             + m_draws * (0.5 - score) * (0.5 - score)) / games;
+    const double error = std::sqrt(variance / games);
+    const auto elo = [](double s) {
+        return s <= 0.0 ? -INFINITY : s >= 1.0 ? INFINITY : -400.0 * std::log10(1.0 / s - 1.0);
+    };
+    const double margin = (elo(score + 1.96 * error) - elo(score - 1.96 * error)) / 2.0;
+    const double los = m_wins + m_losses > 0 ? 0.5 * (1.0 + std::erf((m_wins - m_losses) / std::sqrt(2.0 * (m_wins + m_losses)))) : 0.5;
+
+    out << "Elo difference: " << QString::number(elo(score), 'f', 1) << " +/- " << QString::number(margin, 'f', 1)
+        << ", LOS: " << QString::number(los * 100.0, 'f', 1) << "%, draw ratio: "
+        << QString::number(100.0 * m_draws / games, 'f', 1) << "%" << Qt::endl;
+    out << games << " games in " << QString::number(m_timer.elapsed() / 1000.0, 'f', 1) << " s on "
+        << m_slots.size() << " slots" << Qt::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chess-match");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Plays games between two UCI engines and reports the Elo difference.");
+    parser.addHelpOption();
+
+    QCommandLineOption engineOption("engine", "Engine configuration, given twice: \"cmd=path name=A option.Hash=64\".", "spec");
+    QCommandLineOption openingsOption("openings", "EPD or FEN file with start positions, each played with both colours.", "file");
+    QCommandLineOption gamesOption("games", "Number of games, twice the number of openings if not given.", "n");
+    QCommandLineOption concurrencyOption("concurrency", "Games played at the same time.", "n",
+                                         QString::number(QThread::idealThreadCount()));
+    QCommandLineOption timeControlOption("tc", "Time control, [moves/]seconds[+increment].", "tc", "10+0.1");
+    QCommandLineOption marginOption("timemargin", "Milliseconds an engine may exceed its time.", "ms", "50");
+    QCommandLineOption pgnOption("pgn", "PGN file the games are appended to.", "file");
+    QCommandLineOption resignScoreOption("resign-score", "Centipawns both engines must agree on to end a game.", "cp", "1000");
+    QCommandLineOption resignMovesOption("resign-moves", "Moves of each side beyond the resign score, 0 disables.", "n", "3");
+    QCommandLineOption drawMoveOption("draw-after", "First move number a game may be adjudicated a draw.", "move", "40");
+    QCommandLineOption drawScoreOption("draw-score", "Centipawns around zero that count as a drawn score.", "cp", "10");
+    QCommandLineOption drawMovesOption("draw-moves", "Moves of each side within the draw score, 0 disables.", "n", "8");
+    parser.addOption(engineOption);
+    parser.addOption(openingsOption);
+    parser.addOption(gamesOption);
+    parser.addOption(concurrencyOption);
+    parser.addOption(timeControlOption);
+    parser.addOption(marginOption);
+    parser.addOption(pgnOption);
+    parser.addOption(resignScoreOption);
+    parser.addOption(resignMovesOption);
+    parser.addOption(drawMoveOption);
+    parser.addOption(drawScoreOption);
+    parser.addOption(drawMovesOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList engineSpecs = parser.values(engineOption);
+    if (engineSpecs.size() != 2)
+        parser.showHelp(1);
+
+    EngineConfig engines[2];
+    for (int index = 0; index < 2; ++index)
+    {
+        if (!parseEngine(engineSpecs[index], engines[index]))
+        {
+            err << "Invalid engine configuration: " << engineSpecs[index] << Qt::endl;
+            return 1;
+        }
+    }
+    if (engines[0].name == engines[1].name)
+        engines[1].name += " 2";
+
+    TimeControl timeControl;
+    if (!parseTimeControl(parser.value(timeControlOption), timeControl))
+    {
+        err << "Invalid time control: " << parser.value(timeControlOption) << Qt::endl;
+        return 1;
+    }
+
+    std::vector<Position> openings;
+    if (parser.isSet(openingsOption))
+    {
+        if (!loadOpenings(parser.value(openingsOption), openings, err))
+            return 1;
+    }
+    else
+    {
+        openings.push_back(Position::startPosition());
+    }
+
+    const int games = parser.isSet(gamesOption) ? parser.value(gamesOption).toInt() : int(openings.size()) * 2;
+    const int concurrency = qMax(1, parser.value(concurrencyOption).toInt());
+    if (games <= 0)
+        parser.showHelp(1);
+
+    Adjudication adjudication;
+    adjudication.resignScore = parser.value(resignScoreOption).toInt();
+    adjudication.resignMoves = qMax(0, parser.value(resignMovesOption).toInt());
+    adjudication.drawMoveNumber = parser.value(drawMoveOption).toInt();
+    adjudication.drawScore = parser.value(drawScoreOption).toInt();
+    adjudication.drawMoves = qMax(0, parser.value(drawMovesOption).toInt());
+
+    // Appending lets an interrupted match be continued into the same file.
+    QFile pgn;
+    if (parser.isSet(pgnOption))
+    {
+        pgn.setFileName(parser.value(pgnOption));
+        if (!pgn.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            err << "Cannot write " << pgn.fileName() << ": " << pgn.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+
+    Match match(app, engines, std::move(openings), games, concurrency, timeControl, adjudication,
+                parser.value(marginOption).toLongLong() * 1000000, pgn.isOpen() ? &pgn : nullptr);
+    match.start();
+    if (!match.isFinished())
+        app.exec();
+
+    QTextStream out(stdout);
+    match.printSummary(out);
+    return match.hasFailed() ? 1 : 0;
+}
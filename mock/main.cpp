@@ -0,0 +1,530 @@
+/**
+ * @brief chess-mock-engine: a fake UCI engine with scripted or recorded output, for benchmarks and tests.
+ * Build together with fen.cpp, position.cpp, movegen.cpp and zobrist.cpp.
+ *
+ *   chess-mock-engine [--InfoLines n] [--InfoInterval ms] [--MultiPV n] [--PvLength n]
+ *                     [--StringBytes n] [--Replay transcript] [--ReplaySpeed factor]
+ *
+ * Every command line option is also a UCI option, so the engine can be configured through
+ * UciEngine::setOption() when it is started without arguments. A GUI that cannot do either,
+ * such as the board with CHESS_ENGINE_PATH pointing here, can pass the same options in the
+ * CHESS_MOCK_OPTIONS environment variable, for example "--InfoLines 500 --InfoInterval 0".
+ *
+ * Scripted searches send InfoLines depths of MultiPV info lines, InfoInterval milliseconds apart,
+ * and then a bestmove. Moves and scores are picked from the position key, so the same position
+ * always gets the same, legal, answer. StringBytes adds an "info string" of that size to every
+ * depth to stress the reading side.
+ *
+ * A transcript replays recorded searches instead, one per "go", in order and wrapping around.
+ * Every "info" or "bestmove" line of the file is sent as is; a line may start with a delay in
+ * milliseconds and a tab. A search ends at its bestmove line, other lines are ignored:
+ *
+ *   12<tab>info depth 1 score cp 20 pv e2e4
+ *   30<tab>info depth 2 score cp 15 pv e2e4 e7e5
+ *   bestmove e2e4 ponder e7e5
+ *
+ * "stop" cuts a search short and answers at once, "go ponder" and "go infinite" hold the answer
+ * until "stop" or "ponderhit".
+ */
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../fen.h"
+#include "../movegen.h"
+#include "../zobrist.h"
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+namespace
+{
+    constexpr int MaxMultiPv = 8;
+    constexpr int MaxPvLength = 64;
+
+    struct ReplayLine
+    {
+        int delayMs = 0;
+        std::string text;
+    };
+
+    using ReplaySearch = std::vector<ReplayLine>;
+
+    struct Settings
+    {
+        int infoLines = 10;
+        int infoInterval = 1;
+        int multiPv = 1;
+        int pvLength = 8;
+        int stringBytes = 0;
+        double replaySpeed = 1.0;
+        std::string replayFile;
+    };
+
+    std::string_view nextToken(std::string_view &text)
+    {
+        const std::size_t start = std::min(text.find_first_not_of(" \t\r"), text.size());
+        const std::size_t end = std::min(text.find_first_of(" \t\r", start), text.size());
+        const std::string_view token = text.substr(start, end - start);
+        text.remove_prefix(end);
+        return token;
+    }
+
+    template<typename T>
+    T toNumber(std::string_view token, T fallback = 0)
+    {
+        T value = fallback;
+        std::from_chars(token.data(), token.data() + token.size(), value);
+        return value;
+    }
+
+    std::string moveText(Move move)
+    {
+        char buffer[6];
+        return std::string(buffer, move.writeUci(buffer));
+    }
+
+    // Mixes the key so neighbouring choices do not follow the same bits.
+    std::uint64_t mix(std::uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // Legal move chosen by the position key, offset picks another one for the other multipv lines.
+    Move chooseMove(const Position &position, int offset)
+    {
+        MoveList moves;
+        MoveGen::generateLegal(position, moves);
+        if (moves.empty())
+            return Move();
+        const std::uint64_t index = mix(Zobrist::key(position)) + std::uint64_t(offset);
+        return moves[int(index % std::uint64_t(moves.size()))];
+    }
+
+    bool loadReplay(const std::string &fileName, std::vector<ReplaySearch> &searches)
+    {
+        std::ifstream file(fileName);
+        if (!file)
+            return false;
+
+        searches.clear();
+        ReplaySearch search;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            ReplayLine entry;
+            std::string_view text(line);
+            const std::size_t tab = text.find('\t');
+            const auto isDigit = [](char ch) { return ch >= '0' && ch <= '9'; };
+            if (tab != std::string_view::npos && tab > 0 && std::all_of(text.begin(), text.begin() + tab, isDigit))
+            {
+                entry.delayMs = toNumber<int>(text.substr(0, tab));
+                text.remove_prefix(tab + 1);
+            }
+
+            const bool bestMove = text.substr(0, 8) == "bestmove";
+            if (!bestMove && text.substr(0, 5) != "info ")
+                continue;
+
+            entry.text = std::string(text);
+            search.push_back(std::move(entry));
+            if (bestMove)
+            {
+                searches.push_back(std::move(search));
+                search.clear();
+            }
+        }
+        return !searches.empty();
+    }
+}
+
+class MockEngine
+{
+public:
+    MockEngine();
+    ~MockEngine();
+
+    // "--Name value" pairs, the same names as the UCI options.
+    bool setOption(std::string_view name, std::string_view value);
+
+    // Reads commands until "quit" or the end of the input.
+    void run();
+
+private:
+    void send(const std::string &line);
+    void setPosition(std::string_view arguments);
+    void go(std::string_view arguments);
+    void search(const Position &position, const Settings &settings, const ReplaySearch *replay);
+    void searchScripted(const Position &position, const Settings &settings);
+    void searchReplay(const ReplaySearch &replay, double speed);
+    void stopSearch();
+
+    // Sleeps for the given time unless the search is stopped first, false when it was.
+    bool pause(int milliseconds);
+
+    // Blocks a ponder or infinite search until stop or ponderhit.
+    void holdResult();
+
+    Position m_position;
+    Settings m_settings;
+    std::vector<ReplaySearch> m_replay;
+    std::size_t m_nextReplay;
+    std::unique_ptr<QThread> m_searchThread;
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_stop;
+    bool m_holdResult;
+
+    QMutex m_outputMutex;
+};
+
+MockEngine::MockEngine()
+{
+    m_position = Position::startPosition();
+    m_nextReplay = 0;
+    m_stop = false;
+    m_holdResult = false;
+}
+
+MockEngine::~MockEngine()
+{
+    stopSearch();
+}
+
+void MockEngine::send(const std::string &line)
+{
+    QMutexLocker locker(&m_outputMutex);
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+bool MockEngine::setOption(std::string_view name, std::string_view value)
+{
+    if (name == "InfoLines")
+        m_settings.infoLines = std::clamp(toNumber<int>(value, 10), 0, 1000000);
+    else if (name == "InfoInterval")
+        m_settings.infoInterval = std::clamp(toNumber<int>(value, 1), 0, 60000);
+    else if (name == "MultiPV")
+        m_settings.multiPv = std::clamp(toNumber<int>(value, 1), 1, MaxMultiPv);
+    else if (name == "PvLength")
+        m_settings.pvLength = std::clamp(toNumber<int>(value, 8), 1, MaxPvLength);
+    else if (name == "StringBytes")
+        m_settings.stringBytes = std::clamp(toNumber<int>(value), 0, 1 << 20);
+    else if (name == "ReplaySpeed")
+        m_settings.replaySpeed = std::max(0.0, std::strtod(std::string(value).c_str(), nullptr));
+    else if (name == "Hash" || name == "Threads" || name == "Ponder")
+    {
+        // Set by most sessions, accepted and ignored.
+    }
+    else if (name == "Replay")
+    {
+        m_settings.replayFile = std::string(value);
+        m_nextReplay = 0;
+        if (m_settings.replayFile.empty())
+        {
+            m_replay.clear();
+        }
+        else if (!loadReplay(m_settings.replayFile, m_replay))
+        {
+            send("info string cannot read transcript " + m_settings.replayFile);
+            m_replay.clear();
+        }
+    }
+    else
+        return false;
+    return true;
+}
+
+void MockEngine::run()
+{
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::string_view arguments(line);
+        const std::string_view command = nextToken(arguments);
+
+        if (command == "uci")
+        {
+            send("id name chess-mock-engine");
+            send("id author the chess project");
+            send("option name InfoLines type spin default 10 min 0 max 1000000");
+            send("option name InfoInterval type spin default 1 min 0 max 60000");
+            send("option name MultiPV type spin default 1 min 1 max " + std::to_string(MaxMultiPv));
+            send("option name PvLength type spin default 8 min 1 max " + std::to_string(MaxPvLength));
+            send("option name StringBytes type spin default 0 min 0 max 1048576");
+            send("option name Hash type spin default 16 min 1 max 4096");
+            send("option name Threads type spin default 1 min 1 max 256");
+            send("option name Ponder type check default false");
+            send("option name Replay type string default <empty>");
+            send("option name ReplaySpeed type string default 1");
+            send("uciok");
+        }
+        else if (command == "isready")
+        {
+            send("readyok");
+        }
+        else if (command == "setoption")
+        {
+            // Values may contain spaces, such as a transcript path.
+            std::string_view name;
+            std::string_view value;
+            if (nextToken(arguments) == "name")
+                name = nextToken(arguments);
+            if (nextToken(arguments) == "value")
+            {
+                const std::size_t start = std::min(arguments.find_first_not_of(" \t"), arguments.size());
+                value = arguments.substr(start);
+                while (!value.empty() && (value.back() == '\r' || value.back() == ' '))
+                    value.remove_suffix(1);
+            }
+            stopSearch();
+            if (!setOption(name, value == "<empty>" ? std::string_view() : value))
+                send("info string unknown option " + std::string(name));
+        }
+        else if (command == "position")
+        {
+            setPosition(arguments);
+        }
+        else if (command == "go")
+        {
+            go(arguments);
+        }
+        else if (command == "stop" || command == "ucinewgame")
+        {
+            stopSearch();
+        }
+        else if (command == "ponderhit")
+        {
+            QMutexLocker locker(&m_mutex);
+            m_holdResult = false;
+            m_wake.wakeAll();
+        }
+        else if (command == "quit")
+        {
+            break;
+        }
+    }
+
+    stopSearch();
+}
+
+void MockEngine::setPosition(std::string_view arguments)
+{
+    Position position;
+    const std::string_view type = nextToken(arguments);
+    if (type == "startpos")
+    {
+        position = Position::startPosition();
+    }
+    else if (type == "fen")
+    {
+        const std::size_t movesAt = arguments.find(" moves");
+        const std::string_view fen = arguments.substr(0, movesAt);
+        const std::size_t first = std::min(fen.find_first_not_of(" \t\r"), fen.size());
+        const std::size_t last = fen.find_last_not_of(" \t\r");
+        if (Fen::parse(fen.substr(first, last == std::string_view::npos ? 0 : last + 1 - first), position) != Fen::Error::None)
+        {
+            send("info string invalid fen");
+            return;
+        }
+        arguments.remove_prefix(movesAt == std::string_view::npos ? arguments.size() : movesAt);
+    }
+    else
+    {
+        return;
+    }
+
+    // The moves are trusted, this engine is only as strict as the tests need it to be.
+    if (nextToken(arguments) == "moves")
+    {
+        for (std::string_view text = nextToken(arguments); !text.empty(); text = nextToken(arguments))
+            position.makeMove(Move::fromUci(text));
+    }
+
+    stopSearch();
+    m_position = position;
+}
+
+void MockEngine::go(std::string_view arguments)
+{
+    bool hold = false;
+    for (std::string_view token = nextToken(arguments); !token.empty(); token = nextToken(arguments))
+    {
+        if (token == "ponder" || token == "infinite")
+            hold = true;
+    }
+
+    stopSearch();
+    m_stop = false;
+    m_holdResult = hold;
+
+    const ReplaySearch *replay = nullptr;
+    if (!m_replay.empty())
+        replay = &m_replay[m_nextReplay++ % m_replay.size()];
+
+    m_searchThread.reset(QThread::create([this, position = m_position, settings = m_settings, replay] {
+        search(position, settings, replay);
+    }));
+    m_searchThread->start();
+}
+
+void MockEngine::stopSearch()
+{
+    if (!m_searchThread)
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_holdResult = false;
+        m_wake.wakeAll();
+    }
+    m_searchThread->wait();
+    m_searchThread.reset();
+}
+
+bool MockEngine::pause(int milliseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    QDeadlineTimer deadline(milliseconds);
+    while (!m_stop)
+    {
+        if (!m_wake.wait(&m_mutex, deadline))
+            return true;
+    }
+    return false;
+}
+
+void MockEngine::holdResult()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_holdResult)
+        m_wake.wait(&m_mutex);
+}
+
+// Runs on the search thread.
+void MockEngine::search(const Position &position, const Settings &settings, const ReplaySearch *replay)
+{
+    if (replay)
+        searchReplay(*replay, settings.replaySpeed);
+    else
+        searchScripted(position, settings);
+}
+
+void MockEngine::searchScripted(const Position &position, const Settings &settings)
+{
+    MoveList moves;
+    MoveGen::generateLegal(position, moves);
+    if (moves.empty())
+    {
+        send(MoveGen::inCheck(position) ? "info depth 0 score mate 0" : "info depth 0 score cp 0");
+        holdResult();
+        send("bestmove (none)");
+        return;
+    }
+
+    const std::uint64_t key = Zobrist::key(position);
+    const int lines = std::min(settings.multiPv, moves.size());
+    const std::string padding = settings.stringBytes > 0 ? "info string " + std::string(std::size_t(settings.stringBytes), 'x') : std::string();
+    std::vector<Move> bestLine;
+    std::uint64_t nodes = 0;
+
+    for (int depth = 1; depth <= settings.infoLines; ++depth)
+    {
+        for (int line = 0; line < lines; ++line)
+        {
+            // Lines grow by a move per depth, so the answer does not depend on when the search stops.
+            std::vector<Move> pv;
+            Position next = position;
+            for (int ply = 0; ply < std::min(depth, settings.pvLength); ++ply)
+            {
+                const Move move = chooseMove(next, ply == 0 ? line : 0);
+                if (move.isNull())
+                    break;
+                pv.push_back(move);
+                next.makeMove(move);
+            }
+            if (line == 0)
+                bestLine = pv;
+
+            nodes += std::uint64_t(depth) * 1000;
+            const int score = int(mix(key + std::uint64_t(depth)) % 61) - 30 - line * 10;
+            std::string info = "info depth " + std::to_string(depth) + " seldepth " + std::to_string(depth + 2)
+                    + " multipv " + std::to_string(line + 1) + " score cp " + std::to_string(score)
+                    + " nodes " + std::to_string(nodes) + " nps 1000000 hashfull 0 time "
+                    + std::to_string(depth * settings.infoInterval) + " pv";
+            for (Move move : pv)
+                info += ' ' + moveText(move);
+            send(info);
+        }
+        if (!padding.empty())
+            send(padding);
+
+        if (!pause(settings.infoInterval))
+            break;
+    }
+
+    holdResult();
+    const Move best = bestLine.empty() ? chooseMove(position, 0) : bestLine.front();
+    std::string answer = "bestmove " + moveText(best);
+    if (bestLine.size() > 1)
+        answer += " ponder " + moveText(bestLine[1]);
+    send(answer);
+}
+
+// A stopped replay skips the rest of its info lines and answers with the recorded move.
+void MockEngine::searchReplay(const ReplaySearch &replay, double speed)
+{
+    for (std::size_t index = 0; index + 1 < replay.size(); ++index)
+    {
+        if (!pause(int(replay[index].delayMs * speed)))
+            break;
+        send(replay[index].text);
+    }
+
+    pause(int(replay.back().delayMs * speed));
+    holdResult();
+    send(replay.back().text);
+}
+
+int main(int argc, char *argv[])
+{
+    // The environment first, so the command line wins.
+    std::vector<std::string> arguments;
+    if (const char *options = std::getenv("CHESS_MOCK_OPTIONS"))
+    {
+        std::string_view text(options);
+        for (std::string_view token = nextToken(text); !token.empty(); token = nextToken(text))
+            arguments.emplace_back(token);
+    }
+    arguments.insert(arguments.end(), argv + 1, argv + argc);
+
+    MockEngine engine;
+    for (std::size_t index = 0; index + 1 < arguments.size(); index += 2)
+    {
+        const std::string_view name(arguments[index]);
+        if (name.substr(0, 2) != "--" || !engine.setOption(name.substr(2), arguments[index + 1]))
+        {
+            std::fprintf(stderr, "Unknown option %s\n", arguments[index].c_str());
+            return 1;
+        }
+    }
+
+    engine.run();
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Compact 16 bit move: from square, to square and promotion piece.
+ * Squares use the Position numbering (a1 = 0 ... h8 = 63).
+ * Captures, castling and en-passant are not stored; they follow from the position the move is played in.
+ */
+class Move
+{
+public:
+    enum Promotion : std::uint8_t {NoPromotion, Knight, Bishop, Rook, Queen};
+
+    constexpr Move() : m_data(0) {}
+    constexpr Move(int from, int to, Promotion promotion = NoPromotion)
+        : m_data(static_cast<std::uint16_t>(from | (to << 6) | (promotion << 12))) {}
+
+    constexpr int from() const { return m_data & 63; }
+    constexpr int to() const { return (m_data >> 6) & 63; }
+    constexpr Promotion promotion() const { return static_cast<Promotion>((m_data >> 12) & 7); }
+
+    // a1a1 can never be played, so the all zero move doubles as "no move".
+    constexpr bool isNull() const { return m_data == 0; }
+
+    constexpr std::uint16_t data() const { return m_data; }
+    static constexpr Move fromData(std::uint16_t data)
+    {
+        Move move;
+        move.m_data = data;
+        return move;
+    }
+
+    constexpr bool operator==(Move other) const { return m_data == other.m_data; }
+    constexpr bool operator!=(Move other) const { return m_data != other.m_data; }
+
+    // Lowercase promotion letter as used by UCI ('q', 'r', 'b', 'n'), or 0.
+    constexpr char promotionLetter() const
+    {
+        constexpr char letters[] = {0, 'n', 'b', 'r', 'q', 0, 0, 0};
+        return letters[promotion()];
+    }
+
+    // Writes the move in UCI coordinate notation ("e2e4", "e7e8q", "0000").
+    // buffer must hold at least 6 characters, the result is zero terminated.
+    std::size_t writeUci(char *buffer) const
+    {
+        if (isNull())
+        {
+            buffer[0] = buffer[1] = buffer[2] = buffer[3] = '0';
+            buffer[4] = '\0';
+            return 4;
+        }
+
+        buffer[0] = static_cast<char>('a' + from() % 8);
+        buffer[1] = static_cast<char>('1' + from() / 8);
+        buffer[2] = static_cast<char>('a' + to() % 8);
+        buffer[3] = static_cast<char>('1' + to() / 8);
+        std::size_t length = 4;
+        if (char letter = promotionLetter())
+            buffer[length++] = letter;
+        buffer[length] = '\0';
+        return length;
+    }
+
+    // Reads UCI coordinate notation. Returns a null move if the text is not a move.
+    static Move fromUci(std::string_view text)
+    {
+        if (text.size() < 4 || text.size() > 5)
+            return Move();
+
+        for (int i = 0; i < 4; i += 2)
+        {
+            if (text[i] < 'a' || text[i] > 'h' || text[i + 1] < '1' || text[i + 1] > '8')
+                return Move();
+        }
+
+        Promotion promotion = NoPromotion;
+        if (text.size() == 5)
+        {
+            switch (text[4])
+            {
+            case 'n': case 'N': promotion = Knight; break;
+            case 'b': case 'B': promotion = Bishop; break;
+            case 'r': case 'R': promotion = Rook; break;
+            case 'q': case 'Q': promotion = Queen; break;
+            default:
+                return Move();
+            }
+        }
+
+        const int from = (text[1] - '1') * 8 + (text[0] - 'a');
+        const int to = (text[3] - '1') * 8 + (text[2] - 'a');
+        return Move(from, to, promotion);
+    }
+
+private:
+    std::uint16_t m_data;
+};
+
+// Fixed capacity move list that lives on the stack. 256 is above the maximum of 218 legal moves.
+struct MoveList
+{
+    Move moves[256];
+    int count = 0;
+
+    inline void add(Move move) { moves[count++] = move; }
+    inline int size() const { return count; }
+    inline bool empty() const { return count == 0; }
+    inline void clear() { count = 0; }
+    inline const Move &operator[](int index) const { return moves[index]; }
+    inline Move &operator[](int index) { return moves[index]; }
+    inline const Move *begin() const { return moves; }
+    inline const Move *end() const { return moves + count; }
+    inline Move *begin() { return moves; }
+    inline Move *end() { return moves + count; }
+};
+
+#endif // MOVE_H
@@ -0,0 +1,779 @@
+#include "movegen.h"
+#include "squaresets.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using MoveGen::GenType;
+
+namespace
+{
+    using Bitboard = std::uint64_t;
+
+    constexpr Bitboard FileA = 0x0101010101010101ULL;
+    constexpr Bitboard FileH = FileA << 7;
+    constexpr Bitboard Rank2 = 0xffULL << 8;
+    constexpr Bitboard Rank3 = 0xffULL << 16;
+    constexpr Bitboard Rank6 = 0xffULL << 40;
+    constexpr Bitboard Rank7 = 0xffULL << 48;
+
+    struct Offset
+    {
+        int column;
+        int rank;
+    };
+
+    constexpr Offset knightOffsets[] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    constexpr Offset kingOffsets[] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    constexpr Offset bishopOffsets[] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+    constexpr Offset rookOffsets[] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+    // Ray directions, the first four run towards higher squares.
+    enum Direction {North, NorthEast, East, NorthWest, South, SouthWest, West, SouthEast};
+    constexpr Offset directionOffsets[] = {{0, 1}, {1, 1}, {1, 0}, {-1, 1}, {0, -1}, {-1, -1}, {-1, 0}, {1, -1}};
+
+    // Returns the target square or -1 when stepping off the board.
+    inline int step(int square, Offset offset)
+    {
+        const int column = square % 8 + offset.column;
+        const int rank = square / 8 + offset.rank;
+        if (column < 0 || column > 7 || rank < 0 || rank > 7)
+            return -1;
+        return rank * 8 + column;
+    }
+
+    constexpr Bitboard bit(int square)
+    {
+        return Bitboard(1) << square;
+    }
+
+    using SquareSets::lowestSquare;
+    using SquareSets::popLowestSquare;
+
+    // Highest square of a non-empty bitboard.
+    inline int highestSquare(Bitboard bitboard)
+    {
+#if defined(_MSC_VER)
+        unsigned long square;
+        _BitScanReverse64(&square, bitboard);
+        return int(square);
+#else
+        return 63 - __builtin_clzll(bitboard);
+#endif
+    }
+
+    struct Tables
+    {
+        Bitboard knight[64];
+        Bitboard king[64];
+
+        // Squares a pawn of each colour attacks.
+        Bitboard pawn[2][64];
+
+        // Squares along each direction up to the edge of the board.
+        Bitboard rays[8][64];
+
+        // Squares strictly between two squares on one line, and the whole line through both.
+        // Both are 0 for squares that do not share a line.
+        Bitboard between[64][64];
+        Bitboard line[64][64];
+    };
+
+    Bitboard stepTargets(int square, const Offset *offsets, int count)
+    {
+        Bitboard targets = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            const int to = step(square, offsets[i]);
+            if (to >= 0)
+                targets |= bit(to);
+        }
+        return targets;
+    }
+
+    Tables makeTables()
+    {
+        Tables tables = {};
+        const Offset whitePawn[] = {{-1, 1}, {1, 1}};
+        const Offset blackPawn[] = {{-1, -1}, {1, -1}};
+
+        for (int square = 0; square < 64; ++square)
+        {
+            tables.knight[square] = stepTargets(square, knightOffsets, 8);
+            tables.king[square] = stepTargets(square, kingOffsets, 8);
+            tables.pawn[Position::White][square] = stepTargets(square, whitePawn, 2);
+            tables.pawn[Position::Black][square] = stepTargets(square, blackPawn, 2);
+
+            for (int direction = 0; direction < 8; ++direction)
+            {
+                for (int to = step(square, directionOffsets[direction]); to >= 0; to = step(to, directionOffsets[direction]))
+                    tables.rays[direction][square] |= bit(to);
+            }
+        }
+
+        for (int square = 0; square < 64; ++square)
+        {
+            for (int direction = 0; direction < 8; ++direction)
+            {
+                const Bitboard line = tables.rays[direction][square] | tables.rays[(direction + 4) % 8][square] | bit(square);
+                Bitboard passed = 0;
+                for (int to = step(square, directionOffsets[direction]); to >= 0; to = step(to, directionOffsets[direction]))
+                {
+                    tables.between[square][to] = passed;
+                    tables.line[square][to] = line;
+                    passed |= bit(to);
+                }
+            }
+        }
+        return tables;
+    }
+
+    const Tables tables = makeTables();
+
+    // The ray up to and including the first blocker.
+    inline Bitboard rayAttacks(Direction direction, int square, Bitboard occupied)
+    {
+        Bitboard attacks = tables.rays[direction][square];
+        const Bitboard blockers = attacks & occupied;
+        if (blockers)
+            attacks ^= tables.rays[direction][direction < South ? lowestSquare(blockers) : highestSquare(blockers)];
+        return attacks;
+    }
+
+    inline Bitboard bishopAttacks(int square, Bitboard occupied)
+    {
+        return rayAttacks(NorthEast, square, occupied) | rayAttacks(NorthWest, square, occupied)
+            | rayAttacks(SouthWest, square, occupied) | rayAttacks(SouthEast, square, occupied);
+    }
+
+    inline Bitboard rookAttacks(int square, Bitboard occupied)
+    {
+        return rayAttacks(North, square, occupied) | rayAttacks(East, square, occupied)
+            | rayAttacks(South, square, occupied) | rayAttacks(West, square, occupied);
+    }
+
+    template<Position::PieceType Type>
+    inline Bitboard attacks(int square, Bitboard occupied)
+    {
+        if constexpr (Type == Position::Knight)
+            return tables.knight[square];
+        else if constexpr (Type == Position::Bishop)
+            return bishopAttacks(square, occupied);
+        else if constexpr (Type == Position::Rook)
+            return rookAttacks(square, occupied);
+        else if constexpr (Type == Position::Queen)
+            return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+        else
+            return tables.king[square];
+    }
+
+    // Pieces of both colours that attack a square, with sliders seen through the given occupancy.
+    inline Bitboard attackersTo(const Position &position, int square, Bitboard occupied)
+    {
+        const Bitboard diagonal = position.pieces[Position::Bishop] | position.pieces[Position::Queen];
+        const Bitboard straight = position.pieces[Position::Rook] | position.pieces[Position::Queen];
+        return (tables.pawn[Position::Black][square] & position.bitboard(Position::White, Position::Pawn))
+            | (tables.pawn[Position::White][square] & position.bitboard(Position::Black, Position::Pawn))
+            | (tables.knight[square] & position.pieces[Position::Knight])
+            | (tables.king[square] & position.pieces[Position::King])
+            | (bishopAttacks(square, occupied) & diagonal)
+            | (rookAttacks(square, occupied) & straight);
+    }
+
+    template<Position::Color By>
+    inline bool isAttackedBy(const Position &position, int square, Bitboard occupied)
+    {
+        constexpr Position::Color Other = By == Position::White ? Position::Black : Position::White;
+        const Bitboard own = position.colors[By];
+        return (tables.pawn[Other][square] & position.pieces[Position::Pawn] & own)
+            || (tables.knight[square] & position.pieces[Position::Knight] & own)
+            || (tables.king[square] & position.pieces[Position::King] & own)
+            || (bishopAttacks(square, occupied) & (position.pieces[Position::Bishop] | position.pieces[Position::Queen]) & own)
+            || (rookAttacks(square, occupied) & (position.pieces[Position::Rook] | position.pieces[Position::Queen]) & own);
+    }
+
+    // Shifts every square one step, Delta is one of the eight king steps in square numbers.
+    template<int Delta>
+    constexpr Bitboard shift(Bitboard bitboard)
+    {
+        if constexpr (Delta == 9 || Delta == -7 || Delta == 1)
+            bitboard &= ~FileH;
+        else if constexpr (Delta == 7 || Delta == -9 || Delta == -1)
+            bitboard &= ~FileA;
+        return Delta > 0 ? bitboard << Delta : bitboard >> -Delta;
+    }
+
+    template<int Delta>
+    inline void addPawnMoves(MoveList &moves, Bitboard targets)
+    {
+        while (targets)
+        {
+            const int to = popLowestSquare(targets);
+            moves.add(Move(to - Delta, to));
+        }
+    }
+
+    template<int Delta>
+    inline void addPromotions(MoveList &moves, Bitboard targets)
+    {
+        while (targets)
+        {
+            const int to = popLowestSquare(targets);
+            moves.add(Move(to - Delta, to, Move::Queen));
+            moves.add(Move(to - Delta, to, Move::Rook));
+            moves.add(Move(to - Delta, to, Move::Bishop));
+            moves.add(Move(to - Delta, to, Move::Knight));
+        }
+    }
+
+    // Target limits where a move may end, evasions pass the checker and the squares to block.
+    // En-passant ignores it, generateLegal() looks at those captures one by one.
+    template<Position::Color Us, GenType Type>
+    void generatePawnMoves(const Position &position, MoveList &moves, Bitboard target)
+    {
+        constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+        constexpr int Up = Us == Position::White ? 8 : -8;
+        constexpr int UpWest = Us == Position::White ? 7 : -9;
+        constexpr int UpEast = Us == Position::White ? 9 : -7;
+        constexpr Bitboard PromotionRank = Us == Position::White ? Rank7 : Rank2;
+        constexpr Bitboard DoublePushRank = Us == Position::White ? Rank3 : Rank6;
+
+        const Bitboard pawns = position.bitboard(Us, Position::Pawn);
+        const Bitboard promoting = pawns & PromotionRank;
+        const Bitboard others = pawns & ~PromotionRank;
+        const Bitboard empty = ~position.occupied();
+        const Bitboard enemies = position.colors[Them] & target;
+
+        if constexpr (Type != GenType::Captures)
+        {
+            const Bitboard single = shift<Up>(others) & empty;
+            const Bitboard twice = shift<Up>(single & DoublePushRank) & empty;
+            addPawnMoves<Up>(moves, single & target);
+            addPawnMoves<2 * Up>(moves, twice & target);
+            addPromotions<Up>(moves, shift<Up>(promoting) & empty & target);
+        }
+
+        if constexpr (Type != GenType::Quiets)
+        {
+            addPawnMoves<UpWest>(moves, shift<UpWest>(others) & enemies);
+            addPawnMoves<UpEast>(moves, shift<UpEast>(others) & enemies);
+            addPromotions<UpWest>(moves, shift<UpWest>(promoting) & enemies);
+            addPromotions<UpEast>(moves, shift<UpEast>(promoting) & enemies);
+
+            if (position.epSquare != Position::NoSquare)
+            {
+                for (Bitboard from = others & tables.pawn[Them][position.epSquare]; from; )
+                    moves.add(Move(popLowestSquare(from), position.epSquare));
+            }
+        }
+    }
+
+    template<Position::Color Us, Position::PieceType Type>
+    void generatePieceMoves(const Position &position, MoveList &moves, Bitboard target)
+    {
+        const Bitboard occupied = position.occupied();
+        for (Bitboard pieces = position.bitboard(Us, Type); pieces; )
+        {
+            const int from = popLowestSquare(pieces);
+            for (Bitboard targets = attacks<Type>(from, occupied) & target; targets; )
+                moves.add(Move(from, popLowestSquare(targets)));
+        }
+    }
+
+    // Castling needs the right, an empty path, and a king that neither is in, passes or lands in check.
+    template<Position::Color Us>
+    void generateCastling(const Position &position, MoveList &moves)
+    {
+        constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+        constexpr int KingFrom = Us == Position::White ? 4 : 60;
+        constexpr std::uint8_t ShortRight = Us == Position::White ? Position::WhiteShort : Position::BlackShort;
+        constexpr std::uint8_t LongRight = Us == Position::White ? Position::WhiteLong : Position::BlackLong;
+
+        if (!(position.castling & (ShortRight | LongRight)))
+            return;
+        if (!(position.bitboard(Us, Position::King) & bit(KingFrom)))
+            return;
+        const Bitboard occupied = position.occupied();
+        if (isAttackedBy<Them>(position, KingFrom, occupied))
+            return;
+
+        const Bitboard rooks = position.bitboard(Us, Position::Rook);
+        if ((position.castling & ShortRight)
+            && (rooks & bit(KingFrom + 3))
+            && !(occupied & (bit(KingFrom + 1) | bit(KingFrom + 2)))
+            && !isAttackedBy<Them>(position, KingFrom + 1, occupied)
+            && !isAttackedBy<Them>(position, KingFrom + 2, occupied))
+        {
+            moves.add(Move(KingFrom, KingFrom + 2));
+        }
+        if ((position.castling & LongRight)
+            && (rooks & bit(KingFrom - 4))
+            && !(occupied & (bit(KingFrom - 1) | bit(KingFrom - 2) | bit(KingFrom - 3)))
+            && !isAttackedBy<Them>(position, KingFrom - 1, occupied)
+            && !isAttackedBy<Them>(position, KingFrom - 2, occupied))
+        {
+            moves.add(Move(KingFrom, KingFrom - 2));
+        }
+    }
+
+    // In double check only the king moves; otherwise the others capture the checker or block.
+    template<Position::Color Us>
+    void generateEvasions(const Position &position, MoveList &moves, int king, Bitboard checkers)
+    {
+        const Bitboard own = position.colors[Us];
+        for (Bitboard targets = tables.king[king] & ~own; targets; )
+            moves.add(Move(king, popLowestSquare(targets)));
+
+        if (checkers & (checkers - 1))
+            return;
+
+        const Bitboard target = tables.between[king][lowestSquare(checkers)] | checkers;
+        generatePawnMoves<Us, GenType::Evasions>(position, moves, target);
+        generatePieceMoves<Us, Position::Knight>(position, moves, target);
+        generatePieceMoves<Us, Position::Bishop>(position, moves, target);
+        generatePieceMoves<Us, Position::Rook>(position, moves, target);
+        generatePieceMoves<Us, Position::Queen>(position, moves, target);
+    }
+
+    // Own pieces that are the only piece between the king and an enemy slider.
+    template<Position::Color Us>
+    Bitboard pinnedPieces(const Position &position, int king)
+    {
+        constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+        const Bitboard occupied = position.occupied();
+        Bitboard snipers = ((rookAttacks(king, 0) & (position.pieces[Position::Rook] | position.pieces[Position::Queen]))
+                | (bishopAttacks(king, 0) & (position.pieces[Position::Bishop] | position.pieces[Position::Queen])))
+            & position.colors[Them];
+
+        Bitboard pinned = 0;
+        while (snipers)
+        {
+            const Bitboard blockers = tables.between[king][popLowestSquare(snipers)] & occupied;
+            if (blockers && !(blockers & (blockers - 1)))
+                pinned |= blockers;
+        }
+        return pinned & position.colors[Us];
+    }
+
+    /*
+     * Whether a pseudo legal move keeps the own king safe. King moves look at the target with the
+     * king taken off the board, pinned pieces have to stay on their line, and en-passant, which
+     * takes two pieces off one rank, is played on a copy. Castling was checked when generated.
+     */
+    template<Position::Color Us>
+    bool isLegal(const Position &position, Move move, int king, Bitboard pinned)
+    {
+        constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+        const int from = move.from();
+        const int to = move.to();
+
+        if (from == king)
+        {
+            if (to - from == 2 || from - to == 2)
+                return true;
+            return !(attackersTo(position, to, position.occupied() ^ bit(from)) & position.colors[Them]);
+        }
+
+        if (to == position.epSquare && (position.pieces[Position::Pawn] & bit(from)))
+        {
+            Position next = position;
+            next.makeMove(move);
+            return !isAttackedBy<Them>(next, king, next.occupied());
+        }
+
+        return !(pinned & bit(from)) || (tables.line[from][king] & bit(to));
+    }
+
+    inline bool isCapture(const Position &position, Move move)
+    {
+        return position.board[move.to()] != ' '
+            || (move.to() == position.epSquare && (position.pieces[Position::Pawn] & bit(move.from())));
+    }
+
+    template<Position::Color Us, GenType Type>
+    void generateLegalMoves(const Position &position, MoveList &moves)
+    {
+        constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+        constexpr GenType Unchecked = Type == GenType::Evasions ? GenType::All : Type;
+
+        // Without a king nothing can be left in check.
+        const Bitboard kings = position.bitboard(Us, Position::King);
+        if (!kings)
+        {
+            MoveGen::generate<Us, Unchecked>(position, moves);
+            return;
+        }
+
+        const int king = lowestSquare(kings);
+        const Bitboard checkers = attackersTo(position, king, position.occupied()) & position.colors[Them];
+        const Bitboard pinned = pinnedPieces<Us>(position, king);
+
+        MoveList pseudoLegal;
+        if (checkers)
+            generateEvasions<Us>(position, pseudoLegal, king, checkers);
+        else
+            MoveGen::generate<Us, Unchecked>(position, pseudoLegal);
+
+        for (Move move : pseudoLegal)
+        {
+            // Evasions are of both kinds.
+            if constexpr (Type == GenType::Captures || Type == GenType::Quiets)
+            {
+                if (checkers && isCapture(position, move) != (Type == GenType::Captures))
+                    continue;
+            }
+            if (isLegal<Us>(position, move, king, pinned))
+                moves.add(move);
+        }
+    }
+
+    template<Position::Color Us>
+    void generatePseudoLegalFor(const Position &position, MoveList &moves, GenType type)
+    {
+        switch (type)
+        {
+        case GenType::Captures: MoveGen::generate<Us, GenType::Captures>(position, moves); break;
+        case GenType::Quiets: MoveGen::generate<Us, GenType::Quiets>(position, moves); break;
+        case GenType::Evasions: MoveGen::generate<Us, GenType::Evasions>(position, moves); break;
+        case GenType::All: MoveGen::generate<Us, GenType::All>(position, moves); break;
+        }
+    }
+
+    template<Position::Color Us>
+    void generateLegalFor(const Position &position, MoveList &moves, GenType type)
+    {
+        switch (type)
+        {
+        case GenType::Captures: generateLegalMoves<Us, GenType::Captures>(position, moves); break;
+        case GenType::Quiets: generateLegalMoves<Us, GenType::Quiets>(position, moves); break;
+        case GenType::Evasions: generateLegalMoves<Us, GenType::Evasions>(position, moves); break;
+        case GenType::All: generateLegalMoves<Us, GenType::All>(position, moves); break;
+        }
+    }
+
+    // The mailbox generator behind generateLegalMailbox(), kept exactly as it was.
+
+    inline bool isOwn(char piece, bool white)
+    {
+        return white ? Position::isWhite(piece) : Position::isBlack(piece);
+    }
+
+    inline bool isEnemy(char piece, bool white)
+    {
+        return white ? Position::isBlack(piece) : Position::isWhite(piece);
+    }
+
+    inline char colored(char piece, bool white)
+    {
+        return white ? piece : static_cast<char>(piece - 'A' + 'a');
+    }
+
+    bool slidingAttack(const Position &position, int square, const Offset *offsets, char slider, char queen)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int from = step(square, offsets[i]); from >= 0; from = step(from, offsets[i]))
+            {
+                const char piece = position.board[from];
+                if (piece == slider || piece == queen)
+                    return true;
+                if (piece != ' ')
+                    break;
+            }
+        }
+        return false;
+    }
+
+    bool isSquareAttackedMailbox(const Position &position, int square, Position::Color by)
+    {
+        const bool white = by == Position::White;
+
+        // Pawns attack diagonally forward, so look diagonally backward from the square.
+        for (int side : {-1, 1})
+        {
+            const int from = step(square, {side, white ? -1 : 1});
+            if (from >= 0 && position.board[from] == colored('P', white))
+                return true;
+        }
+
+        for (const Offset &offset : knightOffsets)
+        {
+            const int from = step(square, offset);
+            if (from >= 0 && position.board[from] == colored('N', white))
+                return true;
+        }
+
+        for (const Offset &offset : kingOffsets)
+        {
+            const int from = step(square, offset);
+            if (from >= 0 && position.board[from] == colored('K', white))
+                return true;
+        }
+
+        const char queen = colored('Q', white);
+        return slidingAttack(position, square, bishopOffsets, colored('B', white), queen)
+            || slidingAttack(position, square, rookOffsets, colored('R', white), queen);
+    }
+
+    int kingSquareMailbox(const Position &position, Position::Color color)
+    {
+        const char king = color == Position::White ? 'K' : 'k';
+        for (int square = 0; square < 64; ++square)
+        {
+            if (position.board[square] == king)
+                return square;
+        }
+        return -1;
+    }
+
+    void addPawnMove(MoveList &moves, int from, int to)
+    {
+        if (to >= 56 || to < 8)
+        {
+            moves.add(Move(from, to, Move::Queen));
+            moves.add(Move(from, to, Move::Rook));
+            moves.add(Move(from, to, Move::Bishop));
+            moves.add(Move(from, to, Move::Knight));
+            return;
+        }
+        moves.add(Move(from, to));
+    }
+
+    void addPawnMoves(const Position &position, MoveList &moves, int from, bool white)
+    {
+        const int forward = white ? 8 : -8;
+        const int startRank = white ? 1 : 6;
+
+        const int to = from + forward;
+        if (position.board[to] == ' ')
+        {
+            addPawnMove(moves, from, to);
+            if (from / 8 == startRank && position.board[to + forward] == ' ')
+                moves.add(Move(from, to + forward));
+        }
+
+        for (int side : {-1, 1})
+        {
+            const int target = step(from, {side, white ? 1 : -1});
+            if (target < 0)
+                continue;
+            if (isEnemy(position.board[target], white) || target == position.epSquare)
+                addPawnMove(moves, from, target);
+        }
+    }
+
+    void addStepMoves(const Position &position, MoveList &moves, int from, bool white, const Offset *offsets)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            const int to = step(from, offsets[i]);
+            if (to >= 0 && !isOwn(position.board[to], white))
+                moves.add(Move(from, to));
+        }
+    }
+
+    void addSlidingMoves(const Position &position, MoveList &moves, int from, bool white, const Offset *offsets)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int to = step(from, offsets[i]); to >= 0; to = step(to, offsets[i]))
+            {
+                const char target = position.board[to];
+                if (isOwn(target, white))
+                    break;
+                moves.add(Move(from, to));
+                if (target != ' ')
+                    break;
+            }
+        }
+    }
+
+    void addCastlingMoves(const Position &position, MoveList &moves, bool white)
+    {
+        const int kingFrom = white ? 4 : 60;
+        const Position::Color enemy = white ? Position::Black : Position::White;
+        const std::uint8_t shortRight = white ? Position::WhiteShort : Position::BlackShort;
+        const std::uint8_t longRight = white ? Position::WhiteLong : Position::BlackLong;
+
+        if (!(position.castling & (shortRight | longRight)))
+            return;
+        if (position.board[kingFrom] != colored('K', white))
+            return;
+        if (isSquareAttackedMailbox(position, kingFrom, enemy))
+            return;
+
+        const char rook = colored('R', white);
+        if ((position.castling & shortRight)
+            && position.board[kingFrom + 3] == rook
+            && position.board[kingFrom + 1] == ' ' && position.board[kingFrom + 2] == ' '
+            && !isSquareAttackedMailbox(position, kingFrom + 1, enemy)
+            && !isSquareAttackedMailbox(position, kingFrom + 2, enemy))
+        {
+            moves.add(Move(kingFrom, kingFrom + 2));
+        }
+        if ((position.castling & longRight)
+            && position.board[kingFrom - 4] == rook
+            && position.board[kingFrom - 1] == ' ' && position.board[kingFrom - 2] == ' '
+            && position.board[kingFrom - 3] == ' '
+            && !isSquareAttackedMailbox(position, kingFrom - 1, enemy)
+            && !isSquareAttackedMailbox(position, kingFrom - 2, enemy))
+        {
+            moves.add(Move(kingFrom, kingFrom - 2));
+        }
+    }
+
+    void generatePseudoLegalMailbox(const Position &position, MoveList &moves)
+    {
+        const bool white = position.sideToMove == Position::White;
+
+        for (int from = 0; from < 64; ++from)
+        {
+            const char piece = position.board[from];
+            if (!isOwn(piece, white))
+                continue;
+
+            switch (piece)
+            {
+            case 'P': case 'p':
+                addPawnMoves(position, moves, from, white);
+                break;
+            case 'N': case 'n':
+                addStepMoves(position, moves, from, white, knightOffsets);
+                break;
+            case 'B': case 'b':
+                addSlidingMoves(position, moves, from, white, bishopOffsets);
+                break;
+            case 'R': case 'r':
+                addSlidingMoves(position, moves, from, white, rookOffsets);
+                break;
+            case 'Q': case 'q':
+                addSlidingMoves(position, moves, from, white, bishopOffsets);
+                addSlidingMoves(position, moves, from, white, rookOffsets);
+                break;
+            case 'K': case 'k':
+                addStepMoves(position, moves, from, white, kingOffsets);
+                break;
+            }
+        }
+
+        addCastlingMoves(position, moves, white);
+    }
+}
+
+template<Position::Color Us, GenType Type>
+void MoveGen::generate(const Position &position, MoveList &moves)
+{
+    constexpr Position::Color Them = Us == Position::White ? Position::Black : Position::White;
+
+    if constexpr (Type == GenType::Evasions)
+    {
+        const Bitboard kings = position.bitboard(Us, Position::King);
+        const int king = kings ? lowestSquare(kings) : -1;
+        const Bitboard checkers = king >= 0 ? attackersTo(position, king, position.occupied()) & position.colors[Them] : 0;
+        if (checkers)
+            generateEvasions<Us>(position, moves, king, checkers);
+        else
+            generate<Us, GenType::All>(position, moves);
+    }
+    else
+    {
+        const Bitboard target = Type == GenType::Captures ? position.colors[Them]
+                : Type == GenType::Quiets ? ~position.occupied() : ~position.colors[Us];
+
+        generatePawnMoves<Us, Type>(position, moves, ~Bitboard(0));
+        generatePieceMoves<Us, Position::Knight>(position, moves, target);
+        generatePieceMoves<Us, Position::Bishop>(position, moves, target);
+        generatePieceMoves<Us, Position::Rook>(position, moves, target);
+        generatePieceMoves<Us, Position::Queen>(position, moves, target);
+        generatePieceMoves<Us, Position::King>(position, moves, target);
+        if constexpr (Type != GenType::Captures)
+            generateCastling<Us>(position, moves);
+    }
+}
+
+template void MoveGen::generate<Position::White, GenType::Captures>(const Position &, MoveList &);
+template void MoveGen::generate<Position::White, GenType::Quiets>(const Position &, MoveList &);
+template void MoveGen::generate<Position::White, GenType::Evasions>(const Position &, MoveList &);
+template void MoveGen::generate<Position::White, GenType::All>(const Position &, MoveList &);
+template void MoveGen::generate<Position::Black, GenType::Captures>(const Position &, MoveList &);
+template void MoveGen::generate<Position::Black, GenType::Quiets>(const Position &, MoveList &);
+template void MoveGen::generate<Position::Black, GenType::Evasions>(const Position &, MoveList &);
+template void MoveGen::generate<Position::Black, GenType::All>(const Position &, MoveList &);
+
+void MoveGen::generatePseudoLegal(const Position &position, MoveList &moves, GenType type)
+{
+    if (position.sideToMove == Position::White)
+        generatePseudoLegalFor<Position::White>(position, moves, type);
+    else
+        generatePseudoLegalFor<Position::Black>(position, moves, type);
+}
+
+void MoveGen::generateLegal(const Position &position, MoveList &moves, GenType type)
+{
+    if (position.sideToMove == Position::White)
+        generateLegalFor<Position::White>(position, moves, type);
+    else
+        generateLegalFor<Position::Black>(position, moves, type);
+}
+
+/*
+ * Plays every pseudo legal move on a copy of the position
+ * and keeps the ones that do not leave the own king attacked.
+ */
+void MoveGen::generateLegalMailbox(const Position &position, MoveList &moves)
+{
+    MoveList pseudoLegal;
+    generatePseudoLegalMailbox(position, pseudoLegal);
+
+    const Position::Color us = position.sideToMove;
+    const Position::Color them = position.opponent();
+    for (Move move : pseudoLegal)
+    {
+        Position next = position;
+        next.makeMove(move);
+        const int king = kingSquareMailbox(next, us);
+        if (king < 0 || !isSquareAttackedMailbox(next, king, them))
+            moves.add(move);
+    }
+}
+
+bool MoveGen::isSquareAttacked(const Position &position, int square, Position::Color by)
+{
+    const Bitboard occupied = position.occupied();
+    return by == Position::White ? isAttackedBy<Position::White>(position, square, occupied)
+                                 : isAttackedBy<Position::Black>(position, square, occupied);
+}
+
+int MoveGen::kingSquare(const Position &position, Position::Color color)
+{
+    const Bitboard kings = position.bitboard(color, Position::King);
+    return kings ? lowestSquare(kings) : -1;
+}
+
+bool MoveGen::inCheck(const Position &position)
+{
+    const int king = kingSquare(position, position.sideToMove);
+    return king >= 0 && isSquareAttacked(position, king, position.opponent());
+}
+
+MoveGen::Status MoveGen::status(const Position &position, const MoveList &legalMoves)
+{
+    const bool check = inCheck(position);
+    if (legalMoves.empty())
+        return check ? Status::Checkmate : Status::Stalemate;
+
+    return check ? Status::Check : Status::Ongoing;
+}
+
+const char *MoveGen::statusString(Status status)
+{
+    switch (status)
+    {
+    case Status::Ongoing: return "ongoing";
+    case Status::Check: return "check";
+    case Status::Checkmate: return "checkmate";
+    case Status::Stalemate: return "stalemate";
+    }
+    return "unknown";
+}
@@ -0,0 +1,52 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "move.h"
+#include "position.h"
+
+/*
+ * Legal move generator over the Position value type.
+ * Unlike ChessAlgorithm it keeps no state between calls, so it can be used from any thread.
+ *
+ * The generator works on the bitboards of Position and is instantiated per side to move and
+ * per kind of move, so every kernel is compiled without tests on colour or move kind.
+ * The functions that take a GenType pick the instantiation once per call.
+ */
+namespace MoveGen
+{
+    enum class Status {Ongoing, Check, Checkmate, Stalemate};
+
+    // Captures and Quiets split All in two: captures are the moves that take a piece, including
+    // en-passant and capturing promotions; quiets are the rest, including castling.
+    // Evasions are the moves that may answer a check: king moves, captures of a single checker
+    // and blocks. For a side that is not in check they are the same as All.
+    enum class GenType {Captures, Quiets, Evasions, All};
+
+    // Moves of one kind for side Us, which must be the side to move. Some may leave the own king
+    // in check. Instantiated in movegen.cpp for both colours and every GenType.
+    template<Position::Color Us, GenType Type>
+    void generate(const Position &position, MoveList &moves);
+
+    // All moves that follow the piece rules, some may leave the own king in check.
+    void generatePseudoLegal(const Position &position, MoveList &moves, GenType type = GenType::All);
+
+    // All legal moves of one kind for the side to move.
+    void generateLegal(const Position &position, MoveList &moves, GenType type = GenType::All);
+
+    // The first, square by square generator, which branches on colour and piece type at run time.
+    // GameCodec numbers moves by their place in its order, so the order may never change.
+    void generateLegalMailbox(const Position &position, MoveList &moves);
+
+    bool isSquareAttacked(const Position &position, int square, Position::Color by);
+    int kingSquare(const Position &position, Position::Color color);
+
+    // Is the side to move in check?
+    bool inCheck(const Position &position);
+
+    // Check, mate or stalemate for the side to move, given its legal moves.
+    Status status(const Position &position, const MoveList &legalMoves);
+
+    const char *statusString(Status status);
+}
+
+#endif // MOVEGEN_H
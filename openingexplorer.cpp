@@ -0,0 +1,257 @@
+#include "openingexplorer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "gamedb.h"
+#include "keysearch.h"
+#include "parallel.h"
+
+namespace
+{
+    constexpr char magic[4] = {'C', 'G', 'O', 'E'};
+    constexpr quint32 version = 1;
+    constexpr qint64 fileHeaderSize = 8;
+
+    // Games handed to a worker at a time.
+    constexpr qint64 blockSize = 256;
+
+    struct ContinuationKey
+    {
+        quint64 key;
+        quint16 move;
+
+        bool operator==(const ContinuationKey &other) const
+        {
+            return key == other.key && move == other.move;
+        }
+
+        bool operator<(const ContinuationKey &other) const
+        {
+            return key < other.key || (key == other.key && move < other.move);
+        }
+    };
+
+    struct ContinuationHash
+    {
+        std::size_t operator()(const ContinuationKey &continuation) const
+        {
+            return std::size_t(continuation.key ^ (quint64(continuation.move) * 0x9e3779b97f4a7c15ull));
+        }
+    };
+
+    struct Continuation
+    {
+        quint32 whiteWins = 0;
+        quint32 draws = 0;
+        quint32 blackWins = 0;
+        quint32 ratedGames = 0;
+        quint64 ratingSum = 0;
+
+        void add(const Continuation &other)
+        {
+            whiteWins += other.whiteWins;
+            draws += other.draws;
+            blackWins += other.blackWins;
+            ratedGames += other.ratedGames;
+            ratingSum += other.ratingSum;
+        }
+    };
+
+    using Aggregate = std::vector<std::pair<ContinuationKey, Continuation>>;
+
+    // Walks the first plies of one game and counts every move in the thread's own map.
+    void addGame(const PgnGame &game, int maxPlies, std::unordered_map<ContinuationKey, Continuation, ContinuationHash> &map)
+    {
+        Position position = game.start;
+        const int plies = std::min(int(game.moves.size()), maxPlies);
+        for (int ply = 0; ply < plies; ++ply)
+        {
+            const Move move = game.moves[std::size_t(ply)];
+            Continuation &continuation = map[{position.key, move.data()}];
+            switch (game.result)
+            {
+            case PgnGame::WhiteWin: ++continuation.whiteWins; break;
+            case PgnGame::BlackWin: ++continuation.blackWins; break;
+            case PgnGame::Draw: ++continuation.draws; break;
+            case PgnGame::Unknown: break;
+            }
+
+            const quint16 rating = position.sideToMove == Position::White ? game.whiteElo : game.blackElo;
+            if (rating > 0)
+            {
+                ++continuation.ratedGames;
+                continuation.ratingSum += rating;
+            }
+
+            position.makeMove(move);
+        }
+    }
+
+    // K-way merge of the sorted per thread aggregates, equal continuations are added up.
+    Aggregate merge(const std::vector<Aggregate> &aggregates)
+    {
+        using Head = std::pair<ContinuationKey, std::size_t>;
+        const auto later = [](const Head &a, const Head &b) { return b.first < a.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        std::vector<std::size_t> positions(aggregates.size(), 0);
+
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < aggregates.size(); ++i)
+        {
+            total += aggregates[i].size();
+            if (!aggregates[i].empty())
+                heads.push({aggregates[i].front().first, i});
+        }
+
+        Aggregate merged;
+        merged.reserve(total);
+        while (!heads.empty())
+        {
+            const std::size_t source = heads.top().second;
+            heads.pop();
+
+            const auto &item = aggregates[source][positions[source]++];
+            if (!merged.empty() && merged.back().first == item.first)
+                merged.back().second.add(item.second);
+            else
+                merged.push_back(item);
+
+            if (positions[source] < aggregates[source].size())
+                heads.push({aggregates[source][positions[source]].first, source});
+        }
+
+        return merged;
+    }
+}
+
+OpeningExplorer::OpeningExplorer(const QString &fileName)
+    : m_file(fileName)
+{
+    m_entries = nullptr;
+    m_count = 0;
+}
+
+QString OpeningExplorer::fileNameFor(const QString &databaseFileName)
+{
+    return databaseFileName + QStringLiteral(".book");
+}
+
+/*
+ * Every worker pulls blocks of games and aggregates into its own hash map, so the pass
+ * needs no locking. The maps are sorted by the workers and merged once at the end.
+ */
+bool OpeningExplorer::build(const GameDbReader &db, const QString &fileName, int threads, int maxPlies, QString *error)
+{
+    threads = qMax(1, threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    const qint64 games = db.gameCount();
+    std::atomic<qint64> nextBlock{0};
+    std::vector<Aggregate> aggregates(static_cast<std::size_t>(threads));
+
+    parallelFor(pool, threads, [&](int task) {
+        std::unordered_map<ContinuationKey, Continuation, ContinuationHash> map;
+        PgnGame game;
+        for (qint64 first = nextBlock.fetch_add(blockSize); first < games; first = nextBlock.fetch_add(blockSize))
+        {
+            const qint64 last = std::min(games, first + blockSize);
+            for (qint64 index = first; index < last; ++index)
+            {
+                if (db.header(index).result == PgnGame::Unknown || !db.readGame(index, game))
+                    continue;
+                addGame(game, maxPlies, map);
+            }
+        }
+
+        Aggregate &aggregate = aggregates[std::size_t(task)];
+        aggregate.assign(map.begin(), map.end());
+        std::sort(aggregate.begin(), aggregate.end(),
+                  [](const auto &a, const auto &b) { return a.first < b.first; });
+    });
+
+    const Aggregate merged = merge(aggregates);
+    aggregates.clear();
+
+    std::vector<OpeningExplorerEntry> entries;
+    entries.reserve(merged.size());
+    for (const auto &[continuation, statistics] : merged)
+    {
+        OpeningExplorerEntry entry;
+        entry.key = continuation.key;
+        entry.move = continuation.move;
+        entry.averageRating = statistics.ratedGames ? quint16(statistics.ratingSum / statistics.ratedGames) : 0;
+        entry.whiteWins = statistics.whiteWins;
+        entry.draws = statistics.draws;
+        entry.blackWins = statistics.blackWins;
+        entries.push_back(entry);
+    }
+
+    // Most played moves first within every position.
+    for (auto first = entries.begin(); first != entries.end();)
+    {
+        auto last = std::find_if(first, entries.end(),
+                                 [key = first->key](const OpeningExplorerEntry &entry) { return entry.key != key; });
+        std::stable_sort(first, last, [](const OpeningExplorerEntry &a, const OpeningExplorerEntry &b) {
+            return a.games() > b.games();
+        });
+        first = last;
+    }
+
+    QFile file(fileName);
+    const qint64 bytes = qint64(entries.size() * sizeof(OpeningExplorerEntry));
+    const bool written = file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            && file.write(magic, 4) == 4
+            && file.write(reinterpret_cast<const char *>(&version), 4) == 4
+            && file.write(reinterpret_cast<const char *>(entries.data()), bytes) == bytes;
+    if (!written && error)
+        *error = file.errorString();
+
+    return written;
+}
+
+bool OpeningExplorer::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar *map = size >= fileHeaderSize ? m_file.map(0, size) : nullptr;
+    quint32 fileVersion = 0;
+    if (map)
+        std::memcpy(&fileVersion, map + 4, 4);
+    if (!map || std::memcmp(map, magic, 4) != 0 || fileVersion != version)
+    {
+        m_error = QStringLiteral("%1 is not an opening explorer file").arg(m_file.fileName());
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const OpeningExplorerEntry *>(map + fileHeaderSize);
+    m_count = (size - fileHeaderSize) / qint64(sizeof(OpeningExplorerEntry));
+
+    return true;
+}
+
+QString OpeningExplorer::errorString() const
+{
+    return m_error;
+}
+
+qint64 OpeningExplorer::size() const
+{
+    return m_count;
+}
+
+OpeningExplorer::Range OpeningExplorer::find(quint64 key) const
+{
+    Range range;
+    std::tie(range.first, range.last) = findKeyRange(m_entries, m_count, key);
+    return range;
+}
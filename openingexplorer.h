@@ -0,0 +1,72 @@
+#ifndef OPENINGEXPLORER_H
+#define OPENINGEXPLORER_H
+
+#include <cstdint>
+#include <QFile>
+#include <QString>
+
+class GameDbReader;
+
+// One move played from one position, with the results of the games that continued with it.
+struct OpeningExplorerEntry
+{
+    quint64 key;
+    quint16 move;
+
+    // Average rating of the players that chose the move, 0 when none was rated.
+    quint16 averageRating;
+
+    quint32 whiteWins;
+    quint32 draws;
+    quint32 blackWins;
+
+    inline quint32 games() const
+    {
+        return whiteWins + draws + blackWins;
+    }
+};
+static_assert(sizeof(OpeningExplorerEntry) == 24, "OpeningExplorerEntry is stored as is");
+
+/*
+ * Move statistics per position for the first plies of every game.
+ *
+ * The file is "CGOE" + version followed by the entries sorted by position key, the moves of one
+ * position ordered from most to least played. It is memory mapped and searched in place.
+ * Games without a result are left out, they have nothing to add to the statistics.
+ */
+class OpeningExplorer
+{
+public:
+    struct Range
+    {
+        const OpeningExplorerEntry *first = nullptr;
+        const OpeningExplorerEntry *last = nullptr;
+
+        const OpeningExplorerEntry *begin() const { return first; }
+        const OpeningExplorerEntry *end() const { return last; }
+        qint64 size() const { return last - first; }
+        bool isEmpty() const { return first == last; }
+    };
+
+    explicit OpeningExplorer(const QString &fileName);
+
+    // Aggregates the first maxPlies plies of every game of db in one parallel pass.
+    static bool build(const GameDbReader &db, const QString &fileName, int threads, int maxPlies = 40, QString *error = nullptr);
+
+    // Default explorer file next to a game database.
+    static QString fileNameFor(const QString &databaseFileName);
+
+    bool open();
+    QString errorString() const;
+
+    qint64 size() const;
+    Range find(quint64 key) const;
+
+private:
+    QFile m_file;
+    const OpeningExplorerEntry *m_entries;
+    qint64 m_count;
+    QString m_error;
+};
+
+#endif // OPENINGEXPLORER_H
@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QThreadPool>
+
+// Runs function(task) for task = 0 .. tasks - 1 on pool and waits until all have finished.
+template<typename Function>
+void parallelFor(QThreadPool &pool, int tasks, const Function &function)
+{
+    for (int task = 0; task < tasks; ++task)
+        pool.start([&function, task] { function(task); });
+    pool.waitForDone();
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,313 @@
+#include "pgn.h"
+#include "fen.h"
+#include "san.h"
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+    inline bool isSpace(char ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+    }
+
+    inline bool isTokenEnd(char ch)
+    {
+        return isSpace(ch) || ch == '{' || ch == '}' || ch == '(' || ch == ')' || ch == ';' || ch == '$';
+    }
+
+    inline bool atLineStart(std::string_view data, std::size_t pos)
+    {
+        return pos == 0 || data[pos - 1] == '\n';
+    }
+
+    std::size_t lineEnd(std::string_view data, std::size_t pos)
+    {
+        const std::size_t end = data.find('\n', pos);
+        return end == std::string_view::npos ? data.size() : end;
+    }
+
+    std::uint16_t parseElo(std::string_view value)
+    {
+        unsigned elo = 0;
+        const auto result = std::from_chars(value.data(), value.data() + value.size(), elo);
+        return result.ec == std::errc() && elo < 0xffff ? static_cast<std::uint16_t>(elo) : 0;
+    }
+
+    // Reads one [Name "Value"] tag line, backslash escapes are kept as they are.
+    void parseTag(std::string_view line, PgnGame &game)
+    {
+        const std::size_t nameEnd = line.find_first_of(" \t", 1);
+        const std::size_t valueStart = line.find('"');
+        const std::size_t valueEnd = line.rfind('"');
+        if (nameEnd == std::string_view::npos || valueStart == std::string_view::npos || valueEnd <= valueStart)
+            return;
+
+        const std::string_view name = line.substr(1, nameEnd - 1);
+        const std::string_view value = line.substr(valueStart + 1, valueEnd - valueStart - 1);
+
+        if (name == "Result")
+            game.result = Pgn::parseResult(value);
+        else if (name == "WhiteElo")
+            game.whiteElo = parseElo(value);
+        else if (name == "BlackElo")
+            game.blackElo = parseElo(value);
+        else if (name == "FEN" && Fen::parse(value, game.start) != Fen::Error::None)
+            game.valid = false;
+    }
+}
+
+std::size_t Pgn::findGameStart(std::string_view data, std::size_t from)
+{
+    std::size_t pos = from;
+
+    // Move to the start of a line.
+    if (pos > 0 && pos < data.size() && data[pos - 1] != '\n')
+    {
+        pos = lineEnd(data, pos);
+        if (pos < data.size())
+            ++pos;
+    }
+
+    while (pos < data.size())
+    {
+        if (data[pos] == '[')
+        {
+            if (pos == 0)
+                return pos;
+
+            // Look at the line before this one, which ends at pos - 1.
+            std::size_t previous = pos < 2 ? std::string_view::npos : data.rfind('\n', pos - 2);
+            previous = previous == std::string_view::npos ? 0 : previous + 1;
+            if (previous == pos - 1 || data[previous] != '[')
+                return pos;
+        }
+
+        pos = lineEnd(data, pos);
+        if (pos < data.size())
+            ++pos;
+    }
+
+    return data.size();
+}
+
+/*
+ * The tag section is read line by line, the move text token by token.
+ * The game ends after the result token or at the next tag line.
+ */
+std::size_t Pgn::parseGame(std::string_view data, PgnGame &game)
+{
+    game.start = Position::startPosition();
+    game.moves.clear();
+    game.result = PgnGame::Unknown;
+    game.valid = true;
+
+    std::size_t pos = 0;
+
+    // Tag pairs.
+    while (pos < data.size())
+    {
+        while (pos < data.size() && isSpace(data[pos]))
+            ++pos;
+        if (pos >= data.size() || data[pos] != '[')
+            break;
+
+        const std::size_t end = lineEnd(data, pos);
+        parseTag(data.substr(pos, end - pos), game);
+        pos = end;
+    }
+
+    Position position = game.start;
+    while (pos < data.size())
+    {
+        const char ch = data[pos];
+        if (isSpace(ch))
+        {
+            ++pos;
+            continue;
+        }
+
+        // The next game starts, even though this one had no result token.
+        if (ch == '[' && atLineStart(data, pos))
+            return pos;
+
+        // Escaped line and rest-of-line comment.
+        if ((ch == '%' && atLineStart(data, pos)) || ch == ';')
+        {
+            pos = lineEnd(data, pos);
+            continue;
+        }
+
+        // Brace comment.
+        if (ch == '{')
+        {
+            const std::size_t end = data.find('}', pos);
+            pos = end == std::string_view::npos ? data.size() : end + 1;
+            continue;
+        }
+
+        // Recursive annotation variation, skipped with everything inside it.
+        if (ch == '(')
+        {
+            int depth = 0;
+            for (; pos < data.size(); ++pos)
+            {
+                if (data[pos] == '{')
+                {
+                    const std::size_t end = data.find('}', pos);
+                    pos = end == std::string_view::npos ? data.size() - 1 : end;
+                }
+                else if (data[pos] == '(')
+                {
+                    ++depth;
+                }
+                else if (data[pos] == ')' && --depth == 0)
+                {
+                    break;
+                }
+            }
+            ++pos;
+            continue;
+        }
+
+        // Stray closing characters.
+        if (ch == ')' || ch == '}')
+        {
+            ++pos;
+            continue;
+        }
+
+        // Numeric annotation glyph.
+        if (ch == '$')
+        {
+            ++pos;
+            while (pos < data.size() && data[pos] >= '0' && data[pos] <= '9')
+                ++pos;
+            continue;
+        }
+
+        std::size_t end = pos;
+        while (end < data.size() && !isTokenEnd(data[end]))
+            ++end;
+        std::string_view token = data.substr(pos, end - pos);
+        pos = end;
+
+        // Game termination marker.
+        const PgnGame::Result result = parseResult(token);
+        if (result != PgnGame::Unknown || token == "*")
+        {
+            if (result != PgnGame::Unknown)
+                game.result = result;
+            return pos;
+        }
+
+        // Move number indication, possibly glued to the move ("12.e4", "12...Nf6").
+        if (token[0] >= '1' && token[0] <= '9')
+        {
+            std::size_t digits = 0;
+            while (digits < token.size() && token[digits] >= '0' && token[digits] <= '9')
+                ++digits;
+            if (digits < token.size() && token[digits] == '.')
+            {
+                while (digits < token.size() && token[digits] == '.')
+                    ++digits;
+                token.remove_prefix(digits);
+            }
+        }
+        while (!token.empty() && token[0] == '.')
+            token.remove_prefix(1);
+        if (token.empty() || !game.valid)
+            continue;
+
+        const Move move = San::parse(position, token);
+        if (move.isNull())
+        {
+            game.valid = false;
+            continue;
+        }
+        position.makeMove(move);
+        game.moves.push_back(move);
+    }
+
+    return pos;
+}
+
+PgnGame::Result Pgn::parseResult(std::string_view token)
+{
+    if (token == "1-0")
+        return PgnGame::WhiteWin;
+    if (token == "0-1")
+        return PgnGame::BlackWin;
+    if (token == "1/2-1/2")
+        return PgnGame::Draw;
+    return PgnGame::Unknown;
+}
+
+const char *Pgn::resultString(PgnGame::Result result)
+{
+    switch (result)
+    {
+    case PgnGame::WhiteWin: return "1-0";
+    case PgnGame::BlackWin: return "0-1";
+    case PgnGame::Draw: return "1/2-1/2";
+    case PgnGame::Unknown: break;
+    }
+    return "*";
+}
+
+void Pgn::appendTag(std::string &output, std::string_view name, std::string_view value)
+{
+    output += '[';
+    output.append(name);
+    output += " \"";
+    for (char ch : value)
+    {
+        if (ch == '"' || ch == '\\')
+            output += '\\';
+        output += ch;
+    }
+    output += "\"]\n";
+}
+
+void Pgn::appendMoveText(std::string &output, const Position &start, const std::vector<Move> &moves, PgnGame::Result result)
+{
+    constexpr std::size_t MaxLine = 79;
+    std::size_t lineStart = output.size();
+
+    // Tokens are separated by a space, or start a new line when they do not fit.
+    const auto appendToken = [&](std::string_view token) {
+        if (output.size() > lineStart)
+        {
+            if (output.size() - lineStart + 1 + token.size() > MaxLine)
+            {
+                output += '\n';
+                lineStart = output.size();
+            }
+            else
+            {
+                output += ' ';
+            }
+        }
+        output.append(token);
+    };
+
+    Position position = start;
+    char token[16];
+    for (std::size_t index = 0; index < moves.size(); ++index)
+    {
+        // Black moves only get a number of their own at the start of the movetext.
+        if (position.sideToMove == Position::White || index == 0)
+        {
+            const char *dots = position.sideToMove == Position::White ? "." : "...";
+            const int length = std::snprintf(token, sizeof(token), "%u%s", unsigned(position.fullmoveNumber), dots);
+            appendToken(std::string_view(token, std::size_t(length)));
+        }
+
+        const std::size_t length = San::write(position, moves[index], token);
+        appendToken(std::string_view(token, length));
+        position.makeMove(moves[index]);
+    }
+
+    appendToken(resultString(result));
+    output += "\n\n";
+}
@@ -0,0 +1,53 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "move.h"
+#include "position.h"
+
+// One game from a PGN file, reduced to what is needed to replay and rate it.
+struct PgnGame
+{
+    enum Result : std::uint8_t {Unknown, WhiteWin, BlackWin, Draw};
+
+    Position start;
+    std::vector<Move> moves;
+    Result result = Unknown;
+    std::uint16_t whiteElo = 0;
+    std::uint16_t blackElo = 0;
+
+    // Byte offset of the first tag in the file.
+    std::uint64_t offset = 0;
+
+    // False when a move could not be resolved. moves then holds the moves before it.
+    bool valid = true;
+};
+
+/*
+ * Allocation free PGN tokenizer, see http://www.saremba.de/chessgml/standards/pgn/pgn-complete.htm.
+ * Comments, variations, NAGs and escaped lines are skipped, moves are resolved with San::parse().
+ * The writer produces export format: one tag per line and movetext wrapped below 80 columns.
+ */
+namespace Pgn
+{
+    // Offset of the first game that starts at or after from, or data.size().
+    // A game starts at a tag line that does not follow another tag line.
+    std::size_t findGameStart(std::string_view data, std::size_t from);
+
+    // Parses the game at the start of data and returns the number of bytes it spans.
+    std::size_t parseGame(std::string_view data, PgnGame &game);
+
+    PgnGame::Result parseResult(std::string_view token);
+    const char *resultString(PgnGame::Result result);
+
+    // Appends a tag pair line, quotes and backslashes in value are escaped.
+    void appendTag(std::string &output, std::string_view name, std::string_view value);
+
+    // Appends the moves played from start in SAN, followed by the result and an empty line.
+    void appendMoveText(std::string &output, const Position &start, const std::vector<Move> &moves, PgnGame::Result result);
+}
+
+#endif // PGN_H
@@ -0,0 +1,129 @@
+#include "pgnreader.h"
+#include <deque>
+#include <memory>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+namespace
+{
+    // Bytes per parallel work item. Ranges are moved to the next game start.
+    constexpr std::size_t rangeSize = 1 << 20;
+}
+
+PgnReader::PgnReader(const QString &fileName)
+    : m_file(fileName)
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_threads = QThread::idealThreadCount();
+}
+
+bool PgnReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    // Map the file, pipes and other unmappable files are read into memory instead.
+    m_size = m_file.size();
+    m_data = reinterpret_cast<const char *>(m_size > 0 ? m_file.map(0, m_size) : nullptr);
+    if (!m_data)
+    {
+        m_buffer = m_file.readAll();
+        m_data = m_buffer.constData();
+        m_size = m_buffer.size();
+    }
+
+    return true;
+}
+
+QString PgnReader::errorString() const
+{
+    return m_file.errorString();
+}
+
+void PgnReader::setThreadCount(int threads)
+{
+    m_threads = qMax(1, threads);
+}
+
+std::string_view PgnReader::data() const
+{
+    return std::string_view(m_data, std::size_t(m_size));
+}
+
+qint64 PgnReader::read(const std::function<void(PgnGame &game)> &consumer)
+{
+    struct Range
+    {
+        std::size_t begin;
+        std::size_t end;
+        std::vector<PgnGame> games;
+        bool done = false;
+    };
+
+    const std::string_view text = data();
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threads);
+    QMutex mutex;
+    QWaitCondition rangeDone;
+
+    // A range owns every game that starts inside it, the last one may run past its end.
+    const std::size_t window = std::size_t(m_threads) * 4;
+    std::deque<std::unique_ptr<Range>> inFlight;
+    std::size_t cursor = 0;
+    qint64 count = 0;
+
+    while (true)
+    {
+        while (inFlight.size() < window && cursor < text.size())
+        {
+            auto range = std::make_unique<Range>();
+            range->begin = cursor;
+            range->end = qMin(text.size(), cursor + rangeSize);
+            cursor = range->end;
+
+            Range *work = range.get();
+            inFlight.push_back(std::move(range));
+            pool.start([work, text, &mutex, &rangeDone] {
+                std::size_t pos = Pgn::findGameStart(text, work->begin);
+                while (pos < work->end)
+                {
+                    PgnGame game;
+                    game.offset = pos;
+                    const std::size_t length = Pgn::parseGame(text.substr(pos), game);
+                    work->games.push_back(std::move(game));
+                    pos = Pgn::findGameStart(text, pos + qMax<std::size_t>(1, length));
+                }
+
+                QMutexLocker locker(&mutex);
+                work->done = true;
+                rangeDone.wakeAll();
+            });
+        }
+
+        if (inFlight.empty())
+            break;
+
+        Range *head = inFlight.front().get();
+        {
+            QMutexLocker locker(&mutex);
+            while (!head->done)
+                rangeDone.wait(&mutex);
+        }
+        for (PgnGame &game : head->games)
+            consumer(game);
+        count += qint64(head->games.size());
+        inFlight.pop_front();
+    }
+
+    return count;
+}
+
+std::vector<PgnGame> PgnReader::readAll()
+{
+    std::vector<PgnGame> games;
+    read([&games](PgnGame &game) { games.push_back(std::move(game)); });
+    return games;
+}
@@ -0,0 +1,38 @@
+#ifndef PGNREADER_H
+#define PGNREADER_H
+
+#include <functional>
+#include <vector>
+#include "pgn.h"
+#include <QFile>
+#include <QString>
+
+/*
+ * Reads a memory mapped PGN file. The file is cut into byte ranges at game boundaries
+ * which are parsed on a thread pool, games are handed out in file order.
+ */
+class PgnReader
+{
+public:
+    explicit PgnReader(const QString &fileName);
+
+    bool open();
+    QString errorString() const;
+
+    void setThreadCount(int threads);
+
+    // Calls consumer for every game on the calling thread. Returns the number of games.
+    qint64 read(const std::function<void(PgnGame &game)> &consumer);
+    std::vector<PgnGame> readAll();
+
+    std::string_view data() const;
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    const char *m_data;
+    qint64 m_size;
+    int m_threads;
+};
+
+#endif // PGNREADER_H
@@ -0,0 +1,199 @@
+#include "position.h"
+#include "zobrist.h"
+
+namespace
+{
+    // Castling rights that survive a move from or to each square.
+    // Only the king and rook start squares take rights away.
+    constexpr std::uint8_t castlingMask(int square)
+    {
+        switch (square)
+        {
+        case 0: return Position::AllCastling & ~Position::WhiteLong;
+        case 4: return Position::AllCastling & ~(Position::WhiteShort | Position::WhiteLong);
+        case 7: return Position::AllCastling & ~Position::WhiteShort;
+        case 56: return Position::AllCastling & ~Position::BlackLong;
+        case 60: return Position::AllCastling & ~(Position::BlackShort | Position::BlackLong);
+        case 63: return Position::AllCastling & ~Position::BlackShort;
+        }
+        return Position::AllCastling;
+    }
+
+    // Same order as Zobrist::pieceIndex(): white pieces, then black.
+    inline std::uint64_t pieceKey(char piece, int square)
+    {
+        const int index = Position::pieceType(piece) + (Position::isBlack(piece) ? 6 : 0);
+        return Zobrist::keys.pieces[index][square];
+    }
+
+    inline std::uint64_t enPassantKey(const Position &position)
+    {
+        return Zobrist::hasEnPassantCapture(position) ? Zobrist::keys.enPassant[position.epSquare % 8] : 0;
+    }
+}
+
+void Position::makeMove(Move move)
+{
+    Undo undo;
+    makeMove(move, undo);
+}
+
+void Position::makeMove(Move move, Undo &undo)
+{
+    const int from = move.from();
+    const int to = move.to();
+    const bool white = sideToMove == White;
+    const char piece = board[from];
+    char captured = board[to];
+
+    const bool pawn = piece == 'P' || piece == 'p';
+    const bool king = piece == 'K' || piece == 'k';
+
+    undo.key = key;
+    undo.captured = captured;
+    undo.castling = castling;
+    undo.epSquare = epSquare;
+    undo.halfmoveClock = halfmoveClock;
+
+    // Whether the en-passant square counts depends on the pawns around it, so its key goes first.
+    key ^= enPassantKey(*this);
+
+    // En-passant removes the pawn behind the target square.
+    if (pawn && to == epSquare)
+    {
+        const int victim = to + (white ? -8 : 8);
+        captured = board[victim];
+        key ^= pieceKey(captured, victim);
+        remove(victim);
+    }
+    else if (captured != ' ')
+    {
+        key ^= pieceKey(captured, to);
+        remove(to);
+    }
+
+    // Castling is a king move of two columns, the rook jumps over the king.
+    // Without the own rook in its corner the move is no castling and only the king moves.
+    const char rook = white ? 'R' : 'r';
+    const int rookFrom = to > from ? from + 3 : from - 4;
+    undo.castled = king && (to - from == 2 || from - to == 2) && rookFrom >= 0 && rookFrom < 64 && board[rookFrom] == rook;
+    if (undo.castled)
+    {
+        const int rookTo = (from + to) / 2;
+        key ^= pieceKey(rook, rookFrom) ^ pieceKey(rook, rookTo);
+        remove(rookFrom);
+        put(rookTo, rook);
+    }
+
+    char placed = piece;
+    if (move.promotion() != Move::NoPromotion)
+    {
+        const char letter = move.promotionLetter();
+        placed = white ? static_cast<char>(letter - 'a' + 'A') : letter;
+    }
+    key ^= pieceKey(piece, from) ^ pieceKey(placed, to);
+    remove(from);
+    put(to, placed);
+
+    key ^= Zobrist::keys.castling[castling];
+    castling &= castlingMask(from) & castlingMask(to);
+    key ^= Zobrist::keys.castling[castling];
+
+    epSquare = NoSquare;
+    if (pawn && (to - from == 16 || from - to == 16))
+        epSquare = static_cast<std::int8_t>((from + to) / 2);
+
+    if (pawn || captured != ' ')
+        halfmoveClock = 0;
+    else if (halfmoveClock < 0xffff)
+        ++halfmoveClock;
+
+    if (!white)
+        ++fullmoveNumber;
+
+    sideToMove = opponent();
+    key ^= Zobrist::keys.side ^ enPassantKey(*this);
+}
+
+void Position::unmakeMove(Move move, const Undo &undo)
+{
+    const int from = move.from();
+    const int to = move.to();
+    sideToMove = opponent();
+    const bool white = sideToMove == White;
+    if (!white)
+        --fullmoveNumber;
+
+    const char placed = board[to];
+    const char piece = move.promotion() != Move::NoPromotion ? (white ? 'P' : 'p') : placed;
+    remove(to);
+    put(from, piece);
+    if (undo.captured != ' ')
+        put(to, undo.captured);
+
+    if ((piece == 'P' || piece == 'p') && to == undo.epSquare)
+        put(to + (white ? -8 : 8), white ? 'p' : 'P');
+
+    if (undo.castled)
+    {
+        const int rookFrom = to > from ? from + 3 : from - 4;
+        const int rookTo = (from + to) / 2;
+        put(rookFrom, board[rookTo]);
+        remove(rookTo);
+    }
+
+    key = undo.key;
+    castling = undo.castling;
+    epSquare = undo.epSquare;
+    halfmoveClock = undo.halfmoveClock;
+}
+
+void Position::refresh()
+{
+    for (std::uint64_t &bitboard : pieces)
+        bitboard = 0;
+    colors[White] = 0;
+    colors[Black] = 0;
+    for (int square = 0; square < 64; ++square)
+        put(square, board[square]);
+
+    key = Zobrist::key(*this);
+}
+
+void Position::clear()
+{
+    for (char &field : board)
+        field = ' ';
+    for (std::uint64_t &bitboard : pieces)
+        bitboard = 0;
+    colors[White] = 0;
+    colors[Black] = 0;
+    sideToMove = White;
+    castling = 0;
+    epSquare = NoSquare;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+
+    // Nothing on the board, white to move and no rights leave only the castling entry for none.
+    key = Zobrist::keys.castling[0];
+}
+
+Position Position::startPosition()
+{
+    static constexpr char backRank[] = "RNBQKBNR";
+
+    Position position;
+    position.clear();
+    for (int column = 1; column <= 8; ++column)
+    {
+        const char piece = backRank[column - 1];
+        position.board[square(column, 1)] = piece;
+        position.board[square(column, 2)] = 'P';
+        position.board[square(column, 7)] = 'p';
+        position.board[square(column, 8)] = static_cast<char>(piece - 'A' + 'a');
+    }
+    position.castling = AllCastling;
+    position.refresh();
+
+    return position;
+}
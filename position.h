@@ -0,0 +1,165 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <cstdint>
+#include <type_traits>
+#include "move.h"
+
+/*
+ * Plain value type that describes a complete chess position:
+ * the pieces, side to move, castling rights, en-passant square and the two move clocks.
+ *
+ * Squares are numbered a1 = 0, b1 = 1, ... h8 = 63.
+ * This is the same layout ChessBoard uses for its board data, so (column, rank) maps directly.
+ * Empty squares hold ' ', pieces hold their FEN letter (uppercase for white).
+ *
+ * Next to the board the pieces are kept as bitboards, bit n for square n, and the Zobrist key
+ * is kept up to date by every move. Code that writes board or the state fields directly calls
+ * refresh() afterwards. The type is trivially copyable and small, so a search can copy it per
+ * move (copy-make) or play and take back moves on one instance (make/unmake).
+ */
+struct Position
+{
+    enum Color : std::uint8_t {White, Black};
+
+    // Index into pieces.
+    enum PieceType : std::uint8_t {Pawn, Knight, Bishop, Rook, Queen, King};
+
+    enum CastlingRight : std::uint8_t {
+        WhiteShort = 1,
+        WhiteLong = 2,
+        BlackShort = 4,
+        BlackLong = 8,
+        AllCastling = 15
+    };
+
+    static constexpr std::int8_t NoSquare = -1;
+
+    // State makeMove() cannot recover from the position after the move.
+    struct Undo
+    {
+        std::uint64_t key;
+        char captured;
+        std::uint8_t castling;
+        std::int8_t epSquare;
+        std::uint16_t halfmoveClock;
+
+        // The move was castling and the rook moved too.
+        bool castled;
+    };
+
+    char board[64];
+    std::uint64_t pieces[6];
+    std::uint64_t colors[2];
+    std::uint64_t key;
+    Color sideToMove;
+    std::uint8_t castling;
+    std::int8_t epSquare;
+    std::uint16_t halfmoveClock;
+    std::uint16_t fullmoveNumber;
+
+    static constexpr int square(int column, int rank)
+    {
+        return (rank - 1) * 8 + (column - 1);
+    }
+
+    static constexpr int column(int square)
+    {
+        return square % 8 + 1;
+    }
+
+    static constexpr int rank(int square)
+    {
+        return square / 8 + 1;
+    }
+
+    inline char at(int column, int rank) const
+    {
+        return board[square(column, rank)];
+    }
+
+    static constexpr bool isWhite(char piece)
+    {
+        return piece >= 'A' && piece <= 'Z';
+    }
+
+    static constexpr bool isBlack(char piece)
+    {
+        return piece >= 'a' && piece <= 'z';
+    }
+
+    // The PieceType of a FEN letter of either colour, -1 for an empty square.
+    static constexpr int pieceType(char piece)
+    {
+        switch (piece)
+        {
+        case 'P': case 'p': return Pawn;
+        case 'N': case 'n': return Knight;
+        case 'B': case 'b': return Bishop;
+        case 'R': case 'r': return Rook;
+        case 'Q': case 'q': return Queen;
+        case 'K': case 'k': return King;
+        }
+        return -1;
+    }
+
+    inline Color opponent() const
+    {
+        return sideToMove == White ? Black : White;
+    }
+
+    inline std::uint64_t occupied() const
+    {
+        return colors[White] | colors[Black];
+    }
+
+    inline std::uint64_t bitboard(Color color, PieceType type) const
+    {
+        return pieces[type] & colors[color];
+    }
+
+    // Change board and bitboards together, the key is left to the caller.
+    inline void put(int square, char piece)
+    {
+        board[square] = piece;
+        const int type = pieceType(piece);
+        if (type < 0)
+            return;
+        const std::uint64_t bit = std::uint64_t(1) << square;
+        pieces[type] |= bit;
+        colors[isWhite(piece) ? White : Black] |= bit;
+    }
+
+    inline void remove(int square)
+    {
+        const char piece = board[square];
+        board[square] = ' ';
+        const int type = pieceType(piece);
+        if (type < 0)
+            return;
+        const std::uint64_t bit = std::uint64_t(1) << square;
+        pieces[type] &= ~bit;
+        colors[isWhite(piece) ? White : Black] &= ~bit;
+    }
+
+    // Plays a legal move, including castling, en-passant and promotion, and updates all state fields.
+    void makeMove(Move move);
+
+    // The same, keeping what unmakeMove() needs to restore the position before the move.
+    void makeMove(Move move, Undo &undo);
+    void unmakeMove(Move move, const Undo &undo);
+
+    // Rebuilds the bitboards from board and the key from everything.
+    void refresh();
+
+    // The initial position of a standard game.
+    static Position startPosition();
+
+    // Empty board, white to move, no castling rights.
+    void clear();
+};
+
+static_assert(std::is_trivially_copyable<Position>::value, "Position is copied with memcpy semantics");
+static_assert(sizeof(Position) <= 200, "Position is copied per move, keep it small");
+
+#endif // POSITION_H
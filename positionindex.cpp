@@ -0,0 +1,223 @@
+#include "positionindex.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <tuple>
+#include <vector>
+#include "gamedb.h"
+#include "keysearch.h"
+#include "parallel.h"
+
+namespace
+{
+    constexpr char magic[4] = {'C', 'G', 'P', 'I'};
+    constexpr quint32 version = 1;
+    constexpr qint64 fileHeaderSize = 8;
+
+    // Marks the entries of a game that could not be decoded.
+    constexpr quint32 unusedGame = 0xffffffffu;
+
+    /*
+     * Stable LSD radix sort on the key, one byte per pass.
+     * Every task counts and scatters its own block, so the passes run in parallel without locking.
+     */
+    void radixSort(std::vector<PositionIndexEntry> &entries, QThreadPool &pool, int tasks)
+    {
+        const std::size_t count = entries.size();
+        const std::size_t blockSize = (count + std::size_t(tasks) - 1) / std::size_t(tasks);
+        const auto blockBegin = [&](int task) { return std::min(count, std::size_t(task) * blockSize); };
+
+        std::vector<PositionIndexEntry> buffer(count);
+        std::vector<std::array<std::size_t, 256>> histograms(static_cast<std::size_t>(tasks));
+        PositionIndexEntry *source = entries.data();
+        PositionIndexEntry *target = buffer.data();
+        bool sorted = true;
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            parallelFor(pool, tasks, [&](int task) {
+                std::array<std::size_t, 256> &histogram = histograms[std::size_t(task)];
+                histogram.fill(0);
+                for (std::size_t i = blockBegin(task); i < blockBegin(task + 1); ++i)
+                    ++histogram[(source[i].key >> shift) & 0xff];
+            });
+
+            // Exclusive prefix sums, digit major and block minor, so equal digits keep their order.
+            // When all keys share this byte the pass would not move anything and is skipped.
+            std::size_t offset = 0;
+            bool trivial = false;
+            for (int digit = 0; digit < 256 && !trivial; ++digit)
+            {
+                std::size_t digitCount = 0;
+                for (const auto &histogram : histograms)
+                    digitCount += histogram[std::size_t(digit)];
+                trivial = digitCount == count;
+            }
+            if (trivial)
+                continue;
+
+            for (int digit = 0; digit < 256; ++digit)
+            {
+                for (auto &histogram : histograms)
+                {
+                    const std::size_t digitCount = histogram[std::size_t(digit)];
+                    histogram[std::size_t(digit)] = offset;
+                    offset += digitCount;
+                }
+            }
+
+            parallelFor(pool, tasks, [&](int task) {
+                std::array<std::size_t, 256> &histogram = histograms[std::size_t(task)];
+                for (std::size_t i = blockBegin(task); i < blockBegin(task + 1); ++i)
+                    target[histogram[(source[i].key >> shift) & 0xff]++] = source[i];
+            });
+
+            std::swap(source, target);
+            sorted = !sorted;
+        }
+
+        // After an odd number of passes the result is in the buffer.
+        if (!sorted)
+            entries.swap(buffer);
+    }
+}
+
+PositionIndex::PositionIndex(const QString &fileName)
+    : m_file(fileName)
+{
+    m_entries = nullptr;
+    m_count = 0;
+}
+
+QString PositionIndex::fileNameFor(const QString &databaseFileName)
+{
+    return databaseFileName + QStringLiteral(".pos");
+}
+
+bool PositionIndex::build(const GameDbReader &db, const QString &fileName, int threads, QString *error)
+{
+    const qint64 games = db.gameCount();
+    if (games > qint64(unusedGame))
+    {
+        if (error)
+            *error = QStringLiteral("Too many games for a position index");
+        return false;
+    }
+
+    // Every game adds its start position and one position per ply, the headers give the exact total.
+    std::vector<std::size_t> firstEntry(std::size_t(games) + 1);
+    for (qint64 index = 0; index < games; ++index)
+        firstEntry[std::size_t(index) + 1] = firstEntry[std::size_t(index)] + db.header(index).plies + 1;
+    std::vector<PositionIndexEntry> entries(firstEntry.back());
+
+    threads = qMax(1, threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    // More tasks than threads, games differ a lot in length.
+    const int tasks = threads * 8;
+    std::atomic<qint64> damaged{0};
+    parallelFor(pool, tasks, [&](int task) {
+        PgnGame game;
+        const qint64 first = games * task / tasks;
+        const qint64 last = games * (task + 1) / tasks;
+        for (qint64 index = first; index < last; ++index)
+        {
+            PositionIndexEntry *entry = entries.data() + firstEntry[std::size_t(index)];
+            PositionIndexEntry *end = entries.data() + firstEntry[std::size_t(index) + 1];
+            if (!db.readGame(index, game))
+            {
+                for (; entry < end; ++entry)
+                    entry->game = unusedGame;
+                damaged.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            Position position = game.start;
+            quint16 ply = 0;
+            *entry++ = {position.key, quint32(index), ply++, 0};
+            for (Move move : game.moves)
+            {
+                position.makeMove(move);
+                *entry++ = {position.key, quint32(index), ply++, 0};
+            }
+        }
+    });
+
+    if (damaged.load() > 0)
+    {
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const PositionIndexEntry &entry) { return entry.game == unusedGame; }),
+                      entries.end());
+    }
+
+    radixSort(entries, pool, threads);
+
+    QFile file(fileName);
+    const qint64 bytes = qint64(entries.size() * sizeof(PositionIndexEntry));
+    const bool written = file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            && file.write(magic, 4) == 4
+            && file.write(reinterpret_cast<const char *>(&version), 4) == 4
+            && file.write(reinterpret_cast<const char *>(entries.data()), bytes) == bytes;
+    if (!written && error)
+        *error = file.errorString();
+
+    return written;
+}
+
+bool PositionIndex::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar *map = size >= fileHeaderSize ? m_file.map(0, size) : nullptr;
+    quint32 fileVersion = 0;
+    if (map)
+        std::memcpy(&fileVersion, map + 4, 4);
+    if (!map || std::memcmp(map, magic, 4) != 0 || fileVersion != version)
+    {
+        m_error = QStringLiteral("%1 is not a position index").arg(m_file.fileName());
+        return false;
+    }
+
+    m_entries = reinterpret_cast<const PositionIndexEntry *>(map + fileHeaderSize);
+    m_count = (size - fileHeaderSize) / qint64(sizeof(PositionIndexEntry));
+
+    return true;
+}
+
+QString PositionIndex::errorString() const
+{
+    return m_error;
+}
+
+qint64 PositionIndex::size() const
+{
+    return m_count;
+}
+
+PositionIndex::Range PositionIndex::find(quint64 key) const
+{
+    Range range;
+    std::tie(range.first, range.last) = findKeyRange(m_entries, m_count, key);
+    return range;
+}
+
+qint64 PositionIndex::Range::gameCount() const
+{
+    // Entries of one key are ordered by game, so repeated games are adjacent.
+    qint64 count = 0;
+    quint32 previous = unusedGame;
+    for (const PositionIndexEntry &entry : *this)
+    {
+        if (entry.game != previous)
+            ++count;
+        previous = entry.game;
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include <cstdint>
+#include <QFile>
+#include <QString>
+
+class GameDbReader;
+
+// One position of one game. Entries are sorted by key, then by game and ply.
+struct PositionIndexEntry
+{
+    quint64 key;
+    quint32 game;
+    quint16 ply;
+    quint16 reserved;
+};
+static_assert(sizeof(PositionIndexEntry) == 16, "PositionIndexEntry is stored as is");
+
+/*
+ * Finds the games that reached a position, by Zobrist key.
+ *
+ * The index file is "CGPI" + version followed by the sorted entries, it is memory mapped
+ * and searched in place with findKeyRange().
+ */
+class PositionIndex
+{
+public:
+    struct Range
+    {
+        const PositionIndexEntry *first = nullptr;
+        const PositionIndexEntry *last = nullptr;
+
+        const PositionIndexEntry *begin() const { return first; }
+        const PositionIndexEntry *end() const { return last; }
+        qint64 size() const { return last - first; }
+        bool isEmpty() const { return first == last; }
+
+        // Number of different games, a position can occur more than once in a game.
+        qint64 gameCount() const;
+    };
+
+    explicit PositionIndex(const QString &fileName);
+
+    // Replays every game of db on threads threads and writes the index to fileName.
+    static bool build(const GameDbReader &db, const QString &fileName, int threads, QString *error = nullptr);
+
+    // Default index file next to a game database.
+    static QString fileNameFor(const QString &databaseFileName);
+
+    bool open();
+    QString errorString() const;
+
+    qint64 size() const;
+    Range find(quint64 key) const;
+
+private:
+    QFile m_file;
+    const PositionIndexEntry *m_entries;
+    qint64 m_count;
+    QString m_error;
+};
+
+#endif // POSITIONINDEX_H
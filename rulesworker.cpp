@@ -0,0 +1,78 @@
+#include "rulesworker.h"
+
+RulesWorker::RulesWorker(QObject *parent)
+    : QObject{parent}
+{
+}
+
+void RulesWorker::cancelBefore(quint64 generation)
+{
+    // Raised first, so a search that starts after the stop below sees it.
+    quint64 wanted = m_wanted.load();
+    while (wanted < generation && !m_wanted.compare_exchange_weak(wanted, generation))
+    {
+    }
+    m_control.stop();
+}
+
+void RulesWorker::skipRules(quint64 generation)
+{
+    quint64 known = m_known.load();
+    while (known < generation && !m_known.compare_exchange_weak(known, generation))
+    {
+    }
+}
+
+RulesResult RulesWorker::legalMoves(quint64 generation, const Position &position)
+{
+    RulesResult result;
+    result.generation = generation;
+    result.position = position;
+    MoveGen::generateLegal(position, result.legalMoves);
+    result.status = MoveGen::status(position, result.legalMoves);
+
+    for (Move move : result.legalMoves)
+    {
+        const quint64 target = quint64(1) << move.to();
+        const char piece = position.board[move.from()];
+        result.targets[move.from()] |= target;
+        if (position.board[move.to()] != ' ' || ((piece == 'P' || piece == 'p') && move.to() == position.epSquare))
+            result.captures[move.from()] |= target;
+    }
+    return result;
+}
+
+void RulesWorker::computeRules(quint64 generation, const Position &position)
+{
+    if (isStale(generation) || generation <= m_known.load())
+        return;
+
+    const RulesResult result = legalMoves(generation, position);
+    if (!isStale(generation) && generation > m_known.load())
+        emit rulesReady(result);
+}
+
+void RulesWorker::searchHint(quint64 generation, const Position &position)
+{
+    if (isStale(generation))
+        return;
+
+    SearchLimits limits;
+    limits.depth = HintDepth;
+    m_control.start(limits, position.sideToMove);
+
+    // A cancel between the first check and start() would have its stop reset, so look again.
+    if (isStale(generation))
+        return;
+
+    const SearchResult result = m_searcher.search(position, limits, &m_control);
+    if (isStale(generation) || m_control.isStopped() || result.bestMove.isNull())
+        return;
+
+    RulesHint hint;
+    hint.generation = generation;
+    hint.move = result.bestMove;
+    hint.score = result.score;
+    hint.depth = result.depth;
+    emit hintReady(hint);
+}
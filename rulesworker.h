@@ -0,0 +1,84 @@
+#ifndef RULESWORKER_H
+#define RULESWORKER_H
+
+#include <atomic>
+#include "move.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include <QMetaType>
+#include <QObject>
+
+// Legal moves of one position snapshot, indexed by from-square.
+// Target masks use bit (rank - 1) * 8 + column - 1, as in Position.
+struct RulesResult
+{
+    // Generation of the snapshot, 0 for a result that belongs to no position.
+    quint64 generation = 0;
+    Position position;
+    MoveList legalMoves;
+    quint64 targets[64] = {};
+    quint64 captures[64] = {};
+    MoveGen::Status status = MoveGen::Status::Ongoing;
+};
+
+// Best move of a short search on a snapshot, score in centipawns from the side to move.
+struct RulesHint
+{
+    quint64 generation = 0;
+    Move move;
+    int score = 0;
+    int depth = 0;
+};
+
+/**
+ * @brief Rules work on position snapshots, run on a thread of its own by ChessAlgorithm.
+ *
+ * Every snapshot has a generation number that grows with every position change. cancelBefore()
+ * may be called from any thread: work for older generations is skipped when it has not started
+ * and a running hint search stops. The receiver still compares generations, since a result may
+ * already be queued when the position changes. skipRules() does the same for the rules of one
+ * generation only, hints for it are still searched.
+ */
+class RulesWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int HintDepth = 4;
+
+    explicit RulesWorker(QObject *parent = nullptr);
+
+    void cancelBefore(quint64 generation);
+
+    // The caller has the legal moves of generation already, computeRules() skips it.
+    // May be called from any thread, like cancelBefore().
+    void skipRules(quint64 generation);
+
+    // The part of computeRules() a caller that cannot wait does itself.
+    static RulesResult legalMoves(quint64 generation, const Position &position);
+
+public slots:
+    void computeRules(quint64 generation, const Position &position);
+    void searchHint(quint64 generation, const Position &position);
+
+signals:
+    void rulesReady(const RulesResult &result);
+    void hintReady(const RulesHint &hint);
+
+private:
+    inline bool isStale(quint64 generation) const
+    {
+        return generation < m_wanted.load();
+    }
+
+    std::atomic<quint64> m_wanted {0};
+    std::atomic<quint64> m_known {0};
+    SearchControl m_control;
+    Searcher m_searcher;
+};
+
+Q_DECLARE_METATYPE(RulesResult)
+Q_DECLARE_METATYPE(RulesHint)
+
+#endif // RULESWORKER_H
@@ -0,0 +1,203 @@
+#include "san.h"
+#include "movegen.h"
+
+namespace
+{
+    bool isSquare(char column, char rank)
+    {
+        return column >= 'a' && column <= 'h' && rank >= '1' && rank <= '8';
+    }
+
+    Move::Promotion promotionFor(char letter)
+    {
+        switch (letter)
+        {
+        case 'N': case 'n': return Move::Knight;
+        case 'B': case 'b': return Move::Bishop;
+        case 'R': case 'r': return Move::Rook;
+        case 'Q': case 'q': return Move::Queen;
+        }
+        return Move::NoPromotion;
+    }
+
+    bool isLegal(const Position &position, Move move)
+    {
+        Position next = position;
+        next.makeMove(move);
+        const int king = MoveGen::kingSquare(next, position.sideToMove);
+        return king >= 0 && !MoveGen::isSquareAttacked(next, king, position.opponent());
+    }
+}
+
+/*
+ * Only the pseudo legal moves that fit the notation are played out to test legality,
+ * which is much cheaper than generating all legal moves for every SAN token.
+ */
+Move San::parse(const Position &position, std::string_view san)
+{
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+        san.remove_suffix(1);
+    if (san.size() < 2)
+        return Move();
+
+    const bool white = position.sideToMove == Position::White;
+    MoveList candidates;
+
+    // Castling.
+    const bool castleShort = san == "O-O" || san == "0-0";
+    const bool castleLong = san == "O-O-O" || san == "0-0-0";
+    if (castleShort || castleLong)
+    {
+        const int from = white ? 4 : 60;
+        const Move castle(from, castleShort ? from + 2 : from - 2);
+
+        MoveList moves;
+        MoveGen::generatePseudoLegal(position, moves);
+        for (Move move : moves)
+        {
+            if (move == castle && (position.board[from] == 'K' || position.board[from] == 'k'))
+                return isLegal(position, move) ? move : Move();
+        }
+        return Move();
+    }
+
+    // Piece letter, pawns have none.
+    char piece = 'P';
+    if (san[0] == 'N' || san[0] == 'B' || san[0] == 'R' || san[0] == 'Q' || san[0] == 'K')
+    {
+        piece = san[0];
+        san.remove_prefix(1);
+    }
+
+    // Promotion, written as "e8=Q" or "e8Q".
+    Move::Promotion promotion = Move::NoPromotion;
+    if (piece == 'P' && san.size() >= 3)
+    {
+        const char last = san.back();
+        const bool withEquals = san[san.size() - 2] == '=';
+        if (withEquals || (last >= 'A' && last <= 'Z'))
+        {
+            promotion = promotionFor(last);
+            if (promotion == Move::NoPromotion)
+                return Move();
+            san.remove_suffix(withEquals ? 2 : 1);
+        }
+    }
+
+    // Target square.
+    if (san.size() < 2 || !isSquare(san[san.size() - 2], san.back()))
+        return Move();
+    const int to = (san.back() - '1') * 8 + (san[san.size() - 2] - 'a');
+    san.remove_suffix(2);
+
+    // What is left is an optional capture mark and the disambiguation.
+    if (!san.empty() && (san.back() == 'x' || san.back() == ':'))
+        san.remove_suffix(1);
+    int fromColumn = -1;
+    int fromRank = -1;
+    for (char ch : san)
+    {
+        if (ch >= 'a' && ch <= 'h')
+            fromColumn = ch - 'a';
+        else if (ch >= '1' && ch <= '8')
+            fromRank = ch - '1';
+        else
+            return Move();
+    }
+
+    const char ownPiece = white ? piece : static_cast<char>(piece - 'A' + 'a');
+    MoveList moves;
+    MoveGen::generatePseudoLegal(position, moves);
+
+    Move match;
+    int matches = 0;
+    for (Move move : moves)
+    {
+        if (move.to() != to || move.promotion() != promotion || position.board[move.from()] != ownPiece)
+            continue;
+        if (fromColumn >= 0 && move.from() % 8 != fromColumn)
+            continue;
+        if (fromRank >= 0 && move.from() / 8 != fromRank)
+            continue;
+        if (!isLegal(position, move))
+            continue;
+
+        match = move;
+        ++matches;
+    }
+
+    return matches == 1 ? match : Move();
+}
+
+std::size_t San::write(const Position &position, Move move, char *buffer)
+{
+    const char moving = position.board[move.from()];
+    const char piece = Position::isWhite(moving) ? moving : static_cast<char>(moving - 'a' + 'A');
+    const int from = move.from();
+    const int to = move.to();
+    std::size_t length = 0;
+
+    if (piece == 'K' && (to - from == 2 || from - to == 2))
+    {
+        const char *castle = to > from ? "O-O" : "O-O-O";
+        while (*castle)
+            buffer[length++] = *castle++;
+    }
+    else
+    {
+        const bool capture = position.board[to] != ' ' || (piece == 'P' && to == position.epSquare);
+        if (piece == 'P')
+        {
+            if (capture)
+                buffer[length++] = static_cast<char>('a' + from % 8);
+        }
+        else
+        {
+            buffer[length++] = piece;
+
+            // Other pieces of the same kind that can legally reach the target square.
+            bool ambiguous = false;
+            bool sameColumn = false;
+            bool sameRank = false;
+            MoveList moves;
+            MoveGen::generatePseudoLegal(position, moves);
+            for (Move other : moves)
+            {
+                if (other.to() != to || other.from() == from || position.board[other.from()] != moving || !isLegal(position, other))
+                    continue;
+                ambiguous = true;
+                sameColumn |= other.from() % 8 == from % 8;
+                sameRank |= other.from() / 8 == from / 8;
+            }
+
+            // The file is preferred, the rank is used when the file is shared, both when both are.
+            if (ambiguous && (!sameColumn || sameRank))
+                buffer[length++] = static_cast<char>('a' + from % 8);
+            if (ambiguous && sameColumn)
+                buffer[length++] = static_cast<char>('1' + from / 8);
+        }
+
+        if (capture)
+            buffer[length++] = 'x';
+        buffer[length++] = static_cast<char>('a' + to % 8);
+        buffer[length++] = static_cast<char>('1' + to / 8);
+
+        if (move.promotion() != Move::NoPromotion)
+        {
+            buffer[length++] = '=';
+            buffer[length++] = static_cast<char>(move.promotionLetter() - 'a' + 'A');
+        }
+    }
+
+    Position next = position;
+    next.makeMove(move);
+    if (MoveGen::inCheck(next))
+    {
+        MoveList replies;
+        MoveGen::generateLegal(next, replies);
+        buffer[length++] = replies.empty() ? '#' : '+';
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
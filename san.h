@@ -0,0 +1,28 @@
+#ifndef SAN_H
+#define SAN_H
+
+#include <cstddef>
+#include <string_view>
+#include "move.h"
+#include "position.h"
+
+/*
+ * Standard algebraic notation as used in PGN, see https://www.chess.com/terms/chess-notation.
+ * Both "O-O" and "0-0" are accepted for castling.
+ */
+namespace San
+{
+    // Resolves san against the legal moves of position.
+    // Check marks and annotations ("+", "#", "!", "?") are ignored.
+    // Returns a null move when no legal move, or more than one, matches.
+    Move parse(const Position &position, std::string_view san);
+
+    // Longest move ("Qa1xb2+", "exd8=Q#") plus the terminating zero.
+    constexpr std::size_t BufferSize = 8;
+
+    // Writes the legal move in the shortest unambiguous form, with "+" or "#" when it gives check.
+    // buffer must hold at least BufferSize characters, the result is zero terminated.
+    std::size_t write(const Position &position, Move move, char *buffer);
+}
+
+#endif // SAN_H
@@ -0,0 +1,461 @@
+#include "search.h"
+#include <algorithm>
+#include <chrono>
+#include "movegen.h"
+#include "transposition.h"
+
+namespace
+{
+    int pieceValue(char piece)
+    {
+        switch (piece)
+        {
+        case 'P': case 'p': return 100;
+        case 'N': case 'n': return 320;
+        case 'B': case 'b': return 330;
+        case 'R': case 'r': return 500;
+        case 'Q': case 'q': return 900;
+        }
+        return 0;
+    }
+
+    // Small bonus for pieces near the centre, in centipawns.
+    int centralisation(int square)
+    {
+        const int column = square % 8;
+        const int rank = square / 8;
+        const int columnDistance = column < 4 ? 3 - column : column - 4;
+        const int rankDistance = rank < 4 ? 3 - rank : rank - 4;
+        return 12 - 4 * std::max(columnDistance, rankDistance);
+    }
+
+    int pieceSquareBonus(char piece, int square)
+    {
+        switch (piece)
+        {
+        case 'P': return 5 * (square / 8 - 1);
+        case 'p': return 5 * (6 - square / 8);
+        case 'N': case 'n': return 2 * centralisation(square);
+        case 'B': case 'b': case 'Q': case 'q': return centralisation(square);
+        }
+        return 0;
+    }
+
+    bool isCapture(const Position &position, Move move)
+    {
+        const char piece = position.board[move.from()];
+        return position.board[move.to()] != ' '
+            || ((piece == 'P' || piece == 'p') && move.to() == position.epSquare);
+    }
+
+    // Most valuable victim first, least valuable attacker breaks ties.
+    int captureOrder(const Position &position, Move move)
+    {
+        const int victim = position.board[move.to()] == ' ' ? 100 : pieceValue(position.board[move.to()]);
+        return victim * 16 - pieceValue(position.board[move.from()]) / 100;
+    }
+}
+
+int Searcher::evaluate(const Position &position)
+{
+    int score = 0;
+    for (int square = 0; square < 64; ++square)
+    {
+        const char piece = position.board[square];
+        if (piece == ' ')
+            continue;
+
+        const int value = pieceValue(piece) + pieceSquareBonus(piece, square);
+        score += Position::isWhite(piece) ? value : -value;
+    }
+
+    return position.sideToMove == Position::White ? score : -score;
+}
+
+namespace
+{
+    std::int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Mate scores are stored relative to the node, so they stay right when found through another path.
+    int scoreToTable(int score, int ply)
+    {
+        if (score > Searcher::MateScore - Searcher::MaxPly)
+            return score + ply;
+        if (score < -Searcher::MateScore + Searcher::MaxPly)
+            return score - ply;
+        return score;
+    }
+
+    int scoreFromTable(int score, int ply)
+    {
+        if (score > Searcher::MateScore - Searcher::MaxPly)
+            return score - ply;
+        if (score < -Searcher::MateScore + Searcher::MaxPly)
+            return score + ply;
+        return score;
+    }
+
+    // Continues a line that was cut short by table hits with the moves stored in the table.
+    void extendPv(const TranspositionTable &table, const Position &root, MoveList &pv)
+    {
+        Position position = root;
+        for (Move move : pv)
+            position.makeMove(move);
+
+        std::vector<std::uint64_t> seen;
+        while (pv.size() < Searcher::MaxPly)
+        {
+            const std::uint64_t key = position.key;
+            TranspositionTable::Entry entry;
+            if (!table.probe(key, entry) || entry.move.isNull()
+                    || std::find(seen.begin(), seen.end(), key) != seen.end())
+                break;
+
+            MoveList moves;
+            MoveGen::generateLegal(position, moves);
+            if (std::find(moves.begin(), moves.end(), entry.move) == moves.end())
+                break;
+
+            seen.push_back(key);
+            pv.add(entry.move);
+            position.makeMove(entry.move);
+        }
+    }
+}
+
+/*
+ * A fixed move time is used as is. With a clock the search aims at an equal share of the
+ * remaining time plus most of the increment, and may run over up to four times that when an
+ * iteration is not finished. While pondering the clock only starts at ponderhit.
+ */
+void SearchControl::start(const SearchLimits &limits, Position::Color side)
+{
+    m_stop.store(false, std::memory_order_relaxed);
+    m_pondering.store(limits.ponder, std::memory_order_relaxed);
+    m_startNs.store(nowNs(), std::memory_order_relaxed);
+    m_nodes.store(0, std::memory_order_relaxed);
+    m_softLimit = -1;
+    m_hardLimit = -1;
+
+    if (limits.infinite)
+        return;
+
+    if (limits.moveTime > 0)
+    {
+        m_softLimit = m_hardLimit = std::max<std::int64_t>(1, limits.moveTime - MoveOverhead);
+        return;
+    }
+
+    const std::int64_t time = limits.time[side];
+    if (time <= 0)
+        return;
+
+    const std::int64_t available = std::max<std::int64_t>(1, time - MoveOverhead);
+    const int movesToGo = limits.movesToGo > 0 ? std::min(limits.movesToGo, 40) : 30;
+    m_softLimit = std::clamp<std::int64_t>(time / movesToGo + limits.increment[side] * 3 / 4, 1, available);
+    m_hardLimit = std::min(available, m_softLimit * 4);
+}
+
+void SearchControl::ponderHit()
+{
+    m_startNs.store(nowNs(), std::memory_order_relaxed);
+    m_pondering.store(false, std::memory_order_relaxed);
+}
+
+std::int64_t SearchControl::elapsedMs() const
+{
+    return (nowNs() - m_startNs.load(std::memory_order_relaxed)) / 1000000;
+}
+
+// An iteration takes a few times longer than the one before, so none is started past half the budget.
+bool SearchControl::canStartIteration() const
+{
+    if (isStopped())
+        return false;
+    if (isPondering() || m_softLimit < 0)
+        return true;
+    return elapsedMs() * 2 < m_softLimit;
+}
+
+bool SearchControl::checkTime()
+{
+    if (isPondering() || m_hardLimit < 0)
+        return false;
+    if (elapsedMs() < m_hardLimit)
+        return false;
+
+    stop();
+    return true;
+}
+
+void Searcher::setTranspositionTable(TranspositionTable *table)
+{
+    m_table = table;
+}
+
+void Searcher::setReporter(Reporter reporter)
+{
+    m_reporter = std::move(reporter);
+}
+
+void Searcher::setHistory(std::vector<std::uint64_t> keys)
+{
+    m_keys = std::move(keys);
+    m_historySize = m_keys.size();
+}
+
+/*
+ * Iterative deepening up to limits.depth, the best move of each iteration is searched first in the next.
+ * The first iteration always completes, so there is a move even when the search is stopped at once.
+ */
+SearchResult Searcher::search(const Position &position, const SearchLimits &limits, SearchControl *control)
+{
+    SearchResult result;
+    m_nodes = 0;
+    m_nodeLimit = limits.nodes;
+    m_control = control;
+    m_rootMoves = limits.searchMoves.empty() ? nullptr : &limits.searchMoves;
+    m_aborted = false;
+    m_keys.resize(m_historySize);
+
+    int maxDepth = std::clamp(limits.depth, 1, MaxPly - 1);
+    if (limits.mate > 0)
+        maxDepth = std::min(maxDepth, 2 * limits.mate);
+
+    for (int depth = 1; depth <= maxDepth; ++depth)
+    {
+        if (depth > 1 && control && !control->canStartIteration())
+            break;
+
+        m_canAbort = depth > 1;
+        m_selDepth = 0;
+        Move bestMove = result.bestMove;
+        const int score = negamax(position, depth, -MateScore - 1, MateScore + 1, 0, &bestMove);
+        if (m_aborted)
+            break;
+
+        result.bestMove = bestMove;
+        result.score = score;
+        result.depth = depth;
+        result.selDepth = m_selDepth;
+        result.nodes = m_nodes;
+        result.timeMs = control ? control->elapsedMs() : 0;
+
+        // A line cut short by the table may not start with the best move of a fail low root.
+        result.pv.clear();
+        if (m_pvLength[0] > 0 && m_pv[0][0] == bestMove)
+        {
+            for (int ply = 0; ply < m_pvLength[0]; ++ply)
+                result.pv.add(m_pv[0][ply]);
+        }
+        else if (!bestMove.isNull())
+        {
+            result.pv.add(bestMove);
+        }
+        if (m_table && !result.pv.empty())
+            extendPv(*m_table, position, result.pv);
+
+        if (m_reporter)
+            m_reporter(result);
+
+        // No need to look deeper once a forced mate has been found.
+        if (isMateScore(score))
+            break;
+    }
+    result.nodes = m_nodes;
+    if (control)
+    {
+        control->addNodes(m_nodes & 127);
+        result.timeMs = control->elapsedMs();
+    }
+    m_control = nullptr;
+
+    return result;
+}
+
+// Called in every node: the stop flag is one relaxed load, the clock and shared node count are updated every 128 nodes.
+inline bool Searcher::shouldStop()
+{
+    if (m_control && (m_nodes & 127) == 0)
+    {
+        m_control->addNodes(128);
+        m_control->checkTime();
+    }
+
+    if (!m_canAbort || m_aborted)
+        return m_aborted;
+
+    if (m_nodeLimit > 0 && m_nodes >= m_nodeLimit)
+        m_aborted = true;
+    else if (m_control)
+        m_aborted = m_control->isStopped();
+    return m_aborted;
+}
+
+// Only positions since the last capture or pawn move can repeat, and only every second ply.
+bool Searcher::isRepetition(std::uint64_t key, const Position &position) const
+{
+    const int reach = std::min<int>(position.halfmoveClock, int(m_keys.size()));
+    for (int back = 2; back <= reach; back += 2)
+    {
+        if (m_keys[m_keys.size() - std::size_t(back)] == key)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * With a transposition table the node is looked up first, repetitions of the game or the current
+ * line are scored as draws, and the result is stored for later iterations and the other threads.
+ */
+int Searcher::negamax(const Position &position, int depth, int alpha, int beta, int ply, Move *bestMove)
+{
+    ++m_nodes;
+    m_pvLength[ply] = 0;
+    if (shouldStop())
+        return 0;
+    m_selDepth = std::max(m_selDepth, ply);
+
+    MoveList moves;
+    MoveGen::generateLegal(position, moves);
+    if (moves.empty())
+        return MoveGen::inCheck(position) ? -MateScore + ply : 0;
+
+    if (position.halfmoveClock >= 100)
+        return 0;
+
+    std::uint64_t key = 0;
+    Move hashMove = bestMove ? *bestMove : Move();
+    if (m_table)
+    {
+        key = position.key;
+        if (ply > 0 && isRepetition(key, position))
+            return 0;
+
+        TranspositionTable::Entry entry;
+        if (m_table->probe(key, entry))
+        {
+            if (hashMove.isNull())
+                hashMove = entry.move;
+
+            const int score = scoreFromTable(entry.score, ply);
+            if (ply > 0 && entry.depth >= depth
+                    && (entry.bound == TranspositionTable::Exact
+                        || (entry.bound == TranspositionTable::Lower && score >= beta)
+                        || (entry.bound == TranspositionTable::Upper && score <= alpha)))
+                return score;
+        }
+    }
+
+    if (depth <= 0 || ply >= MaxPly)
+        return quiescence(position, alpha, beta, ply);
+
+    // "go searchmoves" restricts the root.
+    if (ply == 0 && m_rootMoves)
+    {
+        MoveList allowed;
+        for (Move move : moves)
+        {
+            if (std::find(m_rootMoves->begin(), m_rootMoves->end(), move) != m_rootMoves->end())
+                allowed.add(move);
+        }
+        if (!allowed.empty())
+            moves = allowed;
+    }
+
+    orderMoves(position, moves, hashMove);
+
+    const int originalAlpha = alpha;
+    Move best;
+    if (m_table)
+        m_keys.push_back(key);
+    for (Move move : moves)
+    {
+        Position next = position;
+        next.makeMove(move);
+        const int score = -negamax(next, depth - 1, -beta, -alpha, ply + 1, nullptr);
+        if (m_aborted)
+            break;
+        if (score > alpha)
+        {
+            alpha = score;
+            best = move;
+            if (bestMove)
+                *bestMove = move;
+
+            m_pv[ply][0] = move;
+            std::copy(m_pv[ply + 1], m_pv[ply + 1] + m_pvLength[ply + 1], m_pv[ply] + 1);
+            m_pvLength[ply] = m_pvLength[ply + 1] + 1;
+
+            if (alpha >= beta)
+                break;
+        }
+    }
+    if (m_table)
+        m_keys.pop_back();
+
+    if (m_aborted)
+        return 0;
+
+    if (m_table)
+    {
+        const TranspositionTable::Bound bound = alpha >= beta ? TranspositionTable::Lower
+                : alpha > originalAlpha ? TranspositionTable::Exact : TranspositionTable::Upper;
+        m_table->store(key, best, scoreToTable(alpha, ply), depth, bound);
+    }
+
+    return alpha;
+}
+
+// Only captures are searched so the evaluation is not taken in the middle of an exchange.
+int Searcher::quiescence(const Position &position, int alpha, int beta, int ply)
+{
+    ++m_nodes;
+    m_pvLength[ply] = 0;
+    if (shouldStop())
+        return 0;
+    m_selDepth = std::max(m_selDepth, ply);
+
+    const int standPat = evaluate(position);
+    if (standPat >= beta || ply >= MaxPly)
+        return standPat;
+    alpha = std::max(alpha, standPat);
+
+    MoveList captures;
+    MoveGen::generateLegal(position, captures, MoveGen::GenType::Captures);
+    orderMoves(position, captures, Move());
+
+    for (Move move : captures)
+    {
+        Position next = position;
+        next.makeMove(move);
+        const int score = -quiescence(next, -beta, -alpha, ply + 1);
+        if (m_aborted)
+            return 0;
+        if (score > alpha)
+        {
+            alpha = score;
+            if (alpha >= beta)
+                break;
+        }
+    }
+
+    return alpha;
+}
+
+void Searcher::orderMoves(const Position &position, MoveList &moves, Move first) const
+{
+    auto key = [&](Move move) {
+        if (move == first)
+            return 1 << 20;
+        if (isCapture(position, move))
+            return captureOrder(position, move);
+        return move.promotion() == Move::Queen ? 800 : 0;
+    };
+
+    std::stable_sort(moves.begin(), moves.end(), [&](Move a, Move b) { return key(a) > key(b); });
+}
@@ -0,0 +1,156 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "move.h"
+#include "position.h"
+
+class TranspositionTable;
+
+// Limits of one search. Everything but depth corresponds to a UCI "go" parameter, 0 means not given.
+struct SearchLimits
+{
+    int depth = 4;
+    std::uint64_t nodes = 0;
+
+    // Stop once a mate in this many moves is found.
+    int mate = 0;
+
+    // Milliseconds. time and increment are indexed by Position::Color.
+    std::int64_t moveTime = 0;
+    std::int64_t time[2] = {0, 0};
+    std::int64_t increment[2] = {0, 0};
+    int movesToGo = 0;
+
+    // Neither limits the search; they tell the caller to hold the result until stop or ponderhit.
+    bool infinite = false;
+    bool ponder = false;
+
+    // Only these root moves are searched when not empty.
+    MoveList searchMoves;
+};
+
+struct SearchResult
+{
+    Move bestMove;
+    int score = 0;
+    int depth = 0;
+    int selDepth = 0;
+    std::uint64_t nodes = 0;
+    std::int64_t timeMs = 0;
+    MoveList pv;
+};
+
+/*
+ * Stop and time state of one search, shared by every thread that works on it.
+ * stop() and ponderHit() may be called from any thread while the search runs.
+ */
+class SearchControl
+{
+public:
+    // Time kept back for communication with the GUI.
+    static constexpr std::int64_t MoveOverhead = 30;
+
+    // Resets the flags and turns the limits of the side to move into a time budget.
+    void start(const SearchLimits &limits, Position::Color side);
+
+    inline void stop() { m_stop.store(true, std::memory_order_relaxed); }
+    inline bool isStopped() const { return m_stop.load(std::memory_order_relaxed); }
+
+    // The opponent played the expected move, the clock starts running now.
+    void ponderHit();
+    inline bool isPondering() const { return m_pondering.load(std::memory_order_relaxed); }
+
+    std::int64_t elapsedMs() const;
+
+    // Nodes of all threads, updated in steps of a few hundred nodes.
+    inline void addNodes(std::uint64_t nodes) { m_nodes.fetch_add(nodes, std::memory_order_relaxed); }
+    inline std::uint64_t nodes() const { return m_nodes.load(std::memory_order_relaxed); }
+
+    // Whether there is time left to start another iteration.
+    bool canStartIteration() const;
+
+    // Sets the stop flag once the hard time limit has passed.
+    bool checkTime();
+
+private:
+    std::atomic<bool> m_stop {false};
+    std::atomic<bool> m_pondering {false};
+    std::atomic<std::int64_t> m_startNs {0};
+    std::atomic<std::uint64_t> m_nodes {0};
+
+    // Milliseconds, -1 when the search is not timed.
+    std::int64_t m_softLimit = -1;
+    std::int64_t m_hardLimit = -1;
+};
+
+/*
+ * Small alpha-beta searcher with a material and centralisation evaluation.
+ * Scores are in centipawns from the side to move, mate scores count down from MateScore.
+ *
+ * Without a control and a transposition table it runs a plain fixed depth search. The UCI
+ * front end adds both; several searchers that share them search the same position in parallel.
+ * One Searcher per thread.
+ */
+class Searcher
+{
+public:
+    static constexpr int MateScore = 32000;
+    static constexpr int MaxPly = 128;
+
+    // Called from the searching thread after every completed iteration.
+    using Reporter = std::function<void(const SearchResult &result)>;
+
+    SearchResult search(const Position &position, const SearchLimits &limits, SearchControl *control = nullptr);
+
+    void setTranspositionTable(TranspositionTable *table);
+    void setReporter(Reporter reporter);
+
+    // Keys of the game positions before the root, oldest first, for repetition detection.
+    void setHistory(std::vector<std::uint64_t> keys);
+
+    static int evaluate(const Position &position);
+
+    static inline bool isMateScore(int score)
+    {
+        return score > MateScore - MaxPly || score < -MateScore + MaxPly;
+    }
+
+    // Number of moves (not plies) to mate, negative when being mated.
+    static inline int mateInMoves(int score)
+    {
+        return score > 0 ? (MateScore - score + 1) / 2 : -(MateScore + score) / 2;
+    }
+
+private:
+    int negamax(const Position &position, int depth, int alpha, int beta, int ply, Move *bestMove);
+    int quiescence(const Position &position, int alpha, int beta, int ply);
+    void orderMoves(const Position &position, MoveList &moves, Move first) const;
+    bool shouldStop();
+    bool isRepetition(std::uint64_t key, const Position &position) const;
+
+    std::uint64_t m_nodes = 0;
+    std::uint64_t m_nodeLimit = 0;
+    int m_selDepth = 0;
+    SearchControl *m_control = nullptr;
+    TranspositionTable *m_table = nullptr;
+    Reporter m_reporter;
+    const MoveList *m_rootMoves = nullptr;
+
+    // Set when the running iteration was cut off, its result is incomplete.
+    bool m_aborted = false;
+    bool m_canAbort = false;
+
+    // Game history followed by the keys along the current line.
+    std::vector<std::uint64_t> m_keys;
+    std::size_t m_historySize = 0;
+
+    // Triangular principal variation table.
+    Move m_pv[MaxPly + 1][MaxPly + 1];
+    int m_pvLength[MaxPly + 1] = {};
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,34 @@
+#ifndef SQUARESETS_H
+#define SQUARESETS_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bit scans over sets of squares in a 64-bit word, bit n for square n as in Position.
+namespace SquareSets
+{
+    // Lowest square of a non-empty set.
+    inline int lowestSquare(std::uint64_t squares)
+    {
+#if defined(_MSC_VER)
+        unsigned long square;
+        _BitScanForward64(&square, squares);
+        return int(square);
+#else
+        return __builtin_ctzll(squares);
+#endif
+    }
+
+    // Takes the lowest square out of a non-empty set and returns it.
+    inline int popLowestSquare(std::uint64_t &squares)
+    {
+        const int square = lowestSquare(squares);
+        squares &= squares - 1;
+        return square;
+    }
+}
+
+#endif // SQUARESETS_H
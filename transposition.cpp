@@ -0,0 +1,105 @@
+#include "transposition.h"
+#include <algorithm>
+
+namespace
+{
+    // Layout of the data word, from the low bits: move 16, score 16, depth 8, bound 2, generation 6.
+    std::uint64_t pack(Move move, int score, int depth, TranspositionTable::Bound bound, std::uint8_t generation)
+    {
+        return std::uint64_t(move.data())
+                | std::uint64_t(std::uint16_t(std::int16_t(score))) << 16
+                | std::uint64_t(std::uint8_t(std::clamp(depth, 0, 255))) << 32
+                | std::uint64_t(bound) << 40
+                | std::uint64_t(generation & 63) << 42;
+    }
+
+    int depthOf(std::uint64_t data)
+    {
+        return int((data >> 32) & 0xff);
+    }
+
+    std::uint8_t generationOf(std::uint64_t data)
+    {
+        return std::uint8_t((data >> 42) & 63);
+    }
+}
+
+TranspositionTable::TranspositionTable(std::size_t megabytes)
+{
+    m_mask = 0;
+    m_generation = 0;
+    resize(megabytes);
+}
+
+void TranspositionTable::resize(std::size_t megabytes)
+{
+    const std::size_t wanted = std::max<std::size_t>(1, megabytes) * 1024 * 1024 / sizeof(Slot);
+    std::size_t slots = 1;
+    while (slots * 2 <= wanted)
+        slots *= 2;
+
+    m_slots = std::make_unique<Slot[]>(slots);
+    m_mask = slots - 1;
+    clear();
+}
+
+void TranspositionTable::clear()
+{
+    for (std::size_t index = 0; index <= m_mask; ++index)
+    {
+        m_slots[index].check.store(0, std::memory_order_relaxed);
+        m_slots[index].data.store(0, std::memory_order_relaxed);
+    }
+    m_generation = 0;
+}
+
+void TranspositionTable::newSearch()
+{
+    m_generation = std::uint8_t((m_generation + 1) & 63);
+}
+
+bool TranspositionTable::probe(std::uint64_t key, Entry &entry) const
+{
+    const Slot &slot = m_slots[key & m_mask];
+    const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if (data == 0 || (slot.check.load(std::memory_order_relaxed) ^ data) != key)
+        return false;
+
+    entry.move = Move::fromData(std::uint16_t(data));
+    entry.score = std::int16_t(std::uint16_t(data >> 16));
+    entry.depth = depthOf(data);
+    entry.bound = Bound((data >> 40) & 3);
+    return true;
+}
+
+void TranspositionTable::store(std::uint64_t key, Move move, int score, int depth, Bound bound)
+{
+    Slot &slot = m_slots[key & m_mask];
+    const std::uint64_t old = slot.data.load(std::memory_order_relaxed);
+    const bool sameKey = old != 0 && (slot.check.load(std::memory_order_relaxed) ^ old) == key;
+
+    // Keep a deeper result of the current search for another position.
+    if (!sameKey && old != 0 && generationOf(old) == m_generation && depthOf(old) > depth)
+        return;
+
+    // A result without a move keeps the move found earlier for the same position.
+    if (sameKey && move.isNull())
+        move = Move::fromData(std::uint16_t(old));
+
+    const std::uint64_t data = pack(move, score, depth, bound, m_generation);
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashFull() const
+{
+    const std::size_t samples = std::min<std::size_t>(1000, m_mask + 1);
+    int used = 0;
+    for (std::size_t index = 0; index < samples; ++index)
+    {
+        const std::uint64_t data = m_slots[index].data.load(std::memory_order_relaxed);
+        if (data != 0 && generationOf(data) == m_generation)
+            ++used;
+    }
+    return int(used * 1000 / samples);
+}
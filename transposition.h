@@ -0,0 +1,57 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "move.h"
+
+/*
+ * Hash table of search results, shared by all threads of a search.
+ *
+ * Every slot is two 64 bit words: the data and the position key xor the data. A slot torn by
+ * two threads writing at once no longer matches its key and reads as a miss, so no locking
+ * is needed. Scores are stored as is; mate scores must be made relative to the node by the caller.
+ */
+class TranspositionTable
+{
+public:
+    enum Bound : std::uint8_t {NoBound, Upper, Lower, Exact};
+
+    struct Entry
+    {
+        Move move;
+        int score = 0;
+        int depth = 0;
+        Bound bound = NoBound;
+    };
+
+    explicit TranspositionTable(std::size_t megabytes = 16);
+
+    // Rounds down to a power of two number of slots and clears the table.
+    void resize(std::size_t megabytes);
+    void clear();
+
+    // Entries of earlier searches are replaced first.
+    void newSearch();
+
+    bool probe(std::uint64_t key, Entry &entry) const;
+    void store(std::uint64_t key, Move move, int score, int depth, Bound bound);
+
+    // Used slots per thousand, estimated from the first thousand slots.
+    int hashFull() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<std::uint64_t> check;
+        std::atomic<std::uint64_t> data;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+    std::uint8_t m_generation;
+};
+
+#endif // TRANSPOSITION_H
@@ -0,0 +1,392 @@
+/**
+ * @brief chess-uci: the built-in search behind the UCI protocol on standard input and output.
+ * Build together with fen.cpp, position.cpp, movegen.cpp, search.cpp, transposition.cpp and zobrist.cpp.
+ *
+ * Commands are read on the main thread while a search runs on a thread of its own, so "stop",
+ * "ponderhit" and "isready" are answered at once. The search checks its stop flag in every node.
+ * With Threads > 1 helper searchers share the transposition table and search the same position.
+ */
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../fen.h"
+#include "../movegen.h"
+#include "../search.h"
+#include "../transposition.h"
+#include "../zobrist.h"
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+namespace
+{
+    constexpr int DefaultHash = 16;
+    constexpr int MaxHash = 4096;
+    constexpr int MaxThreads = 256;
+
+    std::string_view nextToken(std::string_view &text)
+    {
+        const std::size_t start = std::min(text.find_first_not_of(" \t\r"), text.size());
+        const std::size_t end = std::min(text.find_first_of(" \t\r", start), text.size());
+        const std::string_view token = text.substr(start, end - start);
+        text.remove_prefix(end);
+        return token;
+    }
+
+    template<typename T>
+    T toNumber(std::string_view token, T fallback = 0)
+    {
+        T value = fallback;
+        std::from_chars(token.data(), token.data() + token.size(), value);
+        return value;
+    }
+
+    // The legal move written as text, or a null move.
+    Move legalMove(const Position &position, std::string_view text)
+    {
+        const Move move = Move::fromUci(text);
+        MoveList moves;
+        MoveGen::generateLegal(position, moves);
+        return std::find(moves.begin(), moves.end(), move) != moves.end() ? move : Move();
+    }
+
+    std::string moveText(Move move)
+    {
+        char buffer[6];
+        return std::string(buffer, move.writeUci(buffer));
+    }
+}
+
+class UciServer
+{
+public:
+    UciServer();
+    ~UciServer();
+
+    // Reads commands until "quit" or the end of the input.
+    void run();
+
+private:
+    void send(const std::string &line);
+    void setOption(std::string_view arguments);
+    void setPosition(std::string_view arguments);
+    void go(std::string_view arguments);
+    void search(const Position &position, const SearchLimits &limits, const std::vector<std::uint64_t> &history);
+    void report(const SearchResult &result);
+    void stopSearch();
+
+    Position m_position;
+    std::vector<std::uint64_t> m_history;
+    TranspositionTable m_table;
+    int m_threads;
+
+    SearchControl m_control;
+    std::unique_ptr<QThread> m_searchThread;
+
+    // "go infinite" and "go ponder" may not answer before stop or ponderhit.
+    QMutex m_mutex;
+    QWaitCondition m_released;
+    bool m_holdResult;
+
+    QMutex m_outputMutex;
+};
+
+UciServer::UciServer()
+    : m_table(DefaultHash)
+{
+    m_position = Position::startPosition();
+    m_threads = 1;
+    m_holdResult = false;
+}
+
+UciServer::~UciServer()
+{
+    stopSearch();
+}
+
+void UciServer::send(const std::string &line)
+{
+    QMutexLocker locker(&m_outputMutex);
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+}
+
+void UciServer::run()
+{
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::string_view arguments(line);
+        const std::string_view command = nextToken(arguments);
+
+        if (command == "uci")
+        {
+            send("id name chess-uci");
+            send("id author the chess project");
+            send("option name Hash type spin default " + std::to_string(DefaultHash) + " min 1 max " + std::to_string(MaxHash));
+            send("option name Threads type spin default 1 min 1 max " + std::to_string(MaxThreads));
+            send("option name Ponder type check default false");
+            send("uciok");
+        }
+        else if (command == "isready")
+        {
+            send("readyok");
+        }
+        else if (command == "ucinewgame")
+        {
+            stopSearch();
+            m_table.clear();
+        }
+        else if (command == "setoption")
+        {
+            setOption(arguments);
+        }
+        else if (command == "position")
+        {
+            setPosition(arguments);
+        }
+        else if (command == "go")
+        {
+            go(arguments);
+        }
+        else if (command == "stop")
+        {
+            stopSearch();
+        }
+        else if (command == "ponderhit")
+        {
+            // The search goes on, now on the clock; a finished one answers right away.
+            m_control.ponderHit();
+            QMutexLocker locker(&m_mutex);
+            m_holdResult = false;
+            m_released.wakeAll();
+        }
+        else if (command == "quit")
+        {
+            break;
+        }
+        else if (!command.empty() && command != "debug")
+        {
+            send("info string unknown command " + std::string(command));
+        }
+    }
+
+    stopSearch();
+}
+
+// Options can only be changed between searches.
+void UciServer::setOption(std::string_view arguments)
+{
+    std::string name;
+    std::string_view value;
+    for (std::string_view token = nextToken(arguments); !token.empty(); token = nextToken(arguments))
+    {
+        if (token == "name")
+        {
+            name = std::string(nextToken(arguments));
+        }
+        else if (token == "value")
+        {
+            value = nextToken(arguments);
+            break;
+        }
+    }
+
+    stopSearch();
+    if (name == "Hash")
+        m_table.resize(std::size_t(std::clamp(toNumber<int>(value, DefaultHash), 1, MaxHash)));
+    else if (name == "Threads")
+        m_threads = std::clamp(toNumber<int>(value, 1), 1, MaxThreads);
+    else if (name != "Ponder")
+        send("info string unknown option " + name);
+}
+
+void UciServer::setPosition(std::string_view arguments)
+{
+    Position position;
+    const std::string_view type = nextToken(arguments);
+    if (type == "startpos")
+    {
+        position = Position::startPosition();
+    }
+    else if (type == "fen")
+    {
+        // The FEN runs up to "moves" or the end of the line.
+        const std::size_t movesAt = arguments.find(" moves");
+        const std::string_view fen = arguments.substr(0, movesAt);
+        const std::size_t first = std::min(fen.find_first_not_of(" \t\r"), fen.size());
+        const std::size_t last = fen.find_last_not_of(" \t\r");
+        const std::string_view trimmed = fen.substr(first, last == std::string_view::npos ? 0 : last + 1 - first);
+        if (Fen::parse(trimmed, position) != Fen::Error::None)
+        {
+            send("info string invalid fen " + std::string(trimmed));
+            return;
+        }
+        arguments.remove_prefix(movesAt == std::string_view::npos ? arguments.size() : movesAt);
+    }
+    else
+    {
+        send("info string invalid position command");
+        return;
+    }
+
+    std::vector<std::uint64_t> history;
+    if (nextToken(arguments) == "moves")
+    {
+        for (std::string_view text = nextToken(arguments); !text.empty(); text = nextToken(arguments))
+        {
+            const Move move = legalMove(position, text);
+            if (move.isNull())
+            {
+                send("info string illegal move " + std::string(text));
+                break;
+            }
+            history.push_back(Zobrist::key(position));
+            position.makeMove(move);
+        }
+    }
+
+    stopSearch();
+    m_position = position;
+    m_history = std::move(history);
+}
+
+void UciServer::go(std::string_view arguments)
+{
+    SearchLimits limits;
+    limits.depth = Searcher::MaxPly - 1;
+
+    for (std::string_view token = nextToken(arguments); !token.empty(); token = nextToken(arguments))
+    {
+        if (token == "depth")
+            limits.depth = toNumber<int>(nextToken(arguments), limits.depth);
+        else if (token == "nodes")
+            limits.nodes = toNumber<std::uint64_t>(nextToken(arguments));
+        else if (token == "mate")
+            limits.mate = toNumber<int>(nextToken(arguments));
+        else if (token == "movetime")
+            limits.moveTime = toNumber<std::int64_t>(nextToken(arguments));
+        else if (token == "wtime")
+            limits.time[Position::White] = toNumber<std::int64_t>(nextToken(arguments));
+        else if (token == "btime")
+            limits.time[Position::Black] = toNumber<std::int64_t>(nextToken(arguments));
+        else if (token == "winc")
+            limits.increment[Position::White] = toNumber<std::int64_t>(nextToken(arguments));
+        else if (token == "binc")
+            limits.increment[Position::Black] = toNumber<std::int64_t>(nextToken(arguments));
+        else if (token == "movestogo")
+            limits.movesToGo = toNumber<int>(nextToken(arguments));
+        else if (token == "infinite")
+            limits.infinite = true;
+        else if (token == "ponder")
+            limits.ponder = true;
+        else if (token == "searchmoves")
+        {
+            // Moves up to the next keyword.
+            std::string_view lookahead = arguments;
+            for (std::string_view text = nextToken(lookahead); !text.empty(); text = nextToken(lookahead))
+            {
+                const Move move = legalMove(m_position, text);
+                if (move.isNull())
+                    break;
+                limits.searchMoves.add(move);
+                arguments = lookahead;
+            }
+        }
+    }
+
+    stopSearch();
+    m_control.start(limits, m_position.sideToMove);
+    m_holdResult = limits.infinite || limits.ponder;
+
+    m_searchThread.reset(QThread::create([this, position = m_position, limits, history = m_history] {
+        search(position, limits, history);
+    }));
+    m_searchThread->start();
+}
+
+void UciServer::stopSearch()
+{
+    if (!m_searchThread)
+        return;
+
+    m_control.stop();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_holdResult = false;
+        m_released.wakeAll();
+    }
+    m_searchThread->wait();
+    m_searchThread.reset();
+}
+
+// Runs on the search thread, the helpers on a pool of their own.
+void UciServer::search(const Position &position, const SearchLimits &limits, const std::vector<std::uint64_t> &history)
+{
+    m_table.newSearch();
+
+    QThreadPool helpers;
+    helpers.setMaxThreadCount(qMax(1, m_threads - 1));
+    for (int helper = 1; helper < m_threads; ++helper)
+    {
+        helpers.start([this, &position, &limits, &history] {
+            Searcher searcher;
+            searcher.setTranspositionTable(&m_table);
+            searcher.setHistory(history);
+            SearchLimits helperLimits = limits;
+            helperLimits.nodes = 0;
+            searcher.search(position, helperLimits, &m_control);
+        });
+    }
+
+    Searcher searcher;
+    searcher.setTranspositionTable(&m_table);
+    searcher.setHistory(history);
+    searcher.setReporter([this](const SearchResult &result) { report(result); });
+    const SearchResult result = searcher.search(position, limits, &m_control);
+
+    m_control.stop();
+    helpers.waitForDone();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_holdResult)
+            m_released.wait(&m_mutex);
+    }
+
+    std::string line = "bestmove " + moveText(result.bestMove);
+    if (result.pv.size() > 1)
+        line += " ponder " + moveText(result.pv[1]);
+    send(line);
+}
+
+void UciServer::report(const SearchResult &result)
+{
+    const std::uint64_t nodes = std::max(result.nodes, m_control.nodes());
+    const std::int64_t time = result.timeMs;
+
+    std::string line = "info depth " + std::to_string(result.depth) + " seldepth " + std::to_string(result.selDepth);
+    if (Searcher::isMateScore(result.score))
+        line += " score mate " + std::to_string(Searcher::mateInMoves(result.score));
+    else
+        line += " score cp " + std::to_string(result.score);
+    line += " nodes " + std::to_string(nodes) + " nps " + std::to_string(nodes * 1000 / std::uint64_t(std::max<std::int64_t>(1, time)));
+    line += " hashfull " + std::to_string(m_table.hashFull()) + " time " + std::to_string(time) + " pv";
+    for (Move move : result.pv)
+        line += ' ' + moveText(move);
+    send(line);
+}
+
+int main()
+{
+    UciServer server;
+    server.run();
+    return 0;
+}
@@ -1,57 +1,109 @@
 #include "uciengine.h"
-#include <QDebug>
-#include <QObject>
+#include "uciengineworker.h"
+#include <QMetaMethod>
 
 UciEngine::UciEngine(QObject *parent)
     : QObject{parent}
 {
-    m_uciEngine = new QProcess(this);
-    m_uciEngine->setReadChannel(QProcess::StandardOutput);
+    qRegisterMetaType<UciInfo>();
+    qRegisterMetaType<UciBestMove>();
+    qRegisterMetaType<UciEngine::State>();
 
-    connect(m_uciEngine, SIGNAL(readyRead()), SLOT(readFromEngine()));
+    m_state = NotRunning;
+    m_generation = 0;
+
+    // The worker and its QProcess are created here and moved before anything is started.
+    m_worker = new UciEngineWorker();
+    m_worker->moveToThread(&m_thread);
+    m_thread.setObjectName("UciEngine");
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+
+    connect(m_worker, &UciEngineWorker::messageReceived, this, &UciEngine::messageReceived);
+    connect(m_worker, &UciEngineWorker::info, this, &UciEngine::info);
+    connect(m_worker, &UciEngineWorker::optionReceived, this, &UciEngine::optionReceived);
+    connect(m_worker, &UciEngineWorker::stateChanged, this, [this](UciEngine::State state) {
+        m_state = state;
+        emit stateChanged(m_state);
+    });
+    connect(m_worker, &UciEngineWorker::bestMove, this, [this](const UciBestMove &result) {
+        emit bestMove(result);
+        if (!result.move.isNull())
+        {
+            char move[6];
+            result.move.writeUci(move);
+            emit engineMove(QString::fromLatin1(move));
+        }
+    });
+
+    m_thread.start();
 }
 
 UciEngine::~UciEngine()
 {
-    delete m_uciEngine;
+    // Quit the engine on its own thread before the thread goes away.
+    QMetaObject::invokeMethod(m_worker, &UciEngineWorker::stopEngine, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void UciEngine::setOption(const QString &name, const QString &value)
+{
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, name, value] { worker->setOption(name, value); });
 }
 
 void UciEngine::startEngine(const QString &enginepath)
 {
-    qInfo() << Q_FUNC_INFO;
-    m_uciEngine->start(enginepath);
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, enginepath] { worker->startEngine(enginepath); });
 }
 
 void UciEngine::stopEngine()
 {
-    qInfo() << Q_FUNC_INFO;
-    m_uciEngine->close();
+    QMetaObject::invokeMethod(m_worker, &UciEngineWorker::stopEngine);
 }
 
 void UciEngine::sendCommand(const QString &command)
 {
-    qInfo() << Q_FUNC_INFO;
-    qInfo() << command.toLatin1();
-    m_uciEngine->write(command.toLatin1() + "\n");
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, command] { worker->sendCommand(command); });
 }
 
-void UciEngine::readFromEngine()
+void UciEngine::newGame()
 {
-    while (m_uciEngine->canReadLine()){
-        QByteArray line = m_uciEngine->readLine().trimmed();
-        parseLine(line);
-        emit messageReceived(line);
-    }
+    QMetaObject::invokeMethod(m_worker, &UciEngineWorker::newGame);
 }
 
-void UciEngine::parseLine(const QString& line)
+quint32 UciEngine::analyse(const QString &fen, const QString &goCommand)
 {
-    if (line.contains("bestmove"))
-    {
-        qInfo() << line;
-        QStringList bestMove = line.split(" ");
-        qInfo() << bestMove[1];
+    const quint32 generation = ++m_generation;
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, fen, goCommand, generation] {
+        worker->analyse(fen, goCommand, generation);
+    });
+    return generation;
+}
 
-        emit engineMove(QString(bestMove[1]));
-    }
+quint32 UciEngine::ponder(const QString &fen, const QString &goCommand)
+{
+    const quint32 generation = ++m_generation;
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, fen, goCommand, generation] {
+        worker->ponder(fen, goCommand, generation);
+    });
+    return generation;
+}
+
+void UciEngine::stopSearch()
+{
+    QMetaObject::invokeMethod(m_worker, &UciEngineWorker::stopSearch);
+}
+
+// Raw lines cross the thread boundary only while someone listens to them.
+void UciEngine::connectNotify(const QMetaMethod &signal)
+{
+    if (signal == QMetaMethod::fromSignal(&UciEngine::messageReceived))
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker] { worker->setForwardLines(true); });
+}
+
+void UciEngine::disconnectNotify(const QMetaMethod &signal)
+{
+    if (signal == QMetaMethod::fromSignal(&UciEngine::messageReceived)
+            && !isSignalConnected(QMetaMethod::fromSignal(&UciEngine::messageReceived)))
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker] { worker->setForwardLines(false); });
 }
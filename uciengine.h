@@ -1,12 +1,21 @@
 #ifndef UCIENGINE_H
 #define UCIENGINE_H
 
+#include "uciparser.h"
+#include <QMetaType>
 #include <QObject>
-#include <QProcess>
+#include <QThread>
+
+class UciEngineWorker;
 
 /**
  * @brief The UciEngine class
  * The code in this class is partly based on https://github.com/cutechess/cutechess.
+ *
+ * Front end for one long lived engine session. The process, its output parsing and the
+ * session state machine live in a UciEngineWorker on a dedicated I/O thread, so a verbose
+ * engine never floods the GUI event loop. Calls are queued to the worker; info updates come
+ * back coalesced to about 30 per second, everything else as soon as it arrives.
  */
 
 class UciEngine : public QObject
@@ -14,24 +23,67 @@ class UciEngine : public QObject
     Q_OBJECT
 
 public:
+    enum State {NotRunning, Starting, Initializing, Synchronizing, Idle, Searching};
+    Q_ENUM(State)
+
     explicit UciEngine(QObject *parent = nullptr);
     ~UciEngine();
 
+    // Last state reported by the worker.
+    inline State state() const { return m_state; }
+    inline bool isRunning() const { return m_state != NotRunning; }
+
+    // Sent during initialisation, or before the next search when the engine is already running.
+    void setOption(const QString &name, const QString &value);
+
 public slots:
+    // Starts the engine, does nothing when it is already running.
     void startEngine(const QString &enginepath);
     void stopEngine();
     void sendCommand(const QString &command);
 
-private slots:
-    void readFromEngine();
+    // The next search belongs to a new game, ucinewgame is sent before it.
+    void newGame();
+
+    // Searches fen, replacing a search that was requested or running before.
+    // fen may be followed by " moves" and the moves played since, so the engine knows the game history.
+    // Returns the generation of the search, its info and bestMove carry it. Output of an older search
+    // can still be on its way when the call returns, callers that care compare generations.
+    quint32 analyse(const QString &fen, const QString &goCommand = "go depth 3");
+
+    // Searches fen with "go ponder": the engine thinks but holds its answer. analyse() with the
+    // same fen and go command turns it into a normal search with ponderhit, anything else stops it.
+    // Returns the generation as analyse() does; after a ponderhit the search carries the new one.
+    quint32 ponder(const QString &fen, const QString &goCommand = "go depth 3");
+
+    // Ends the running search without an answer and forgets a requested one; the engine stays running.
+    void stopSearch();
 
 signals:
+    // Every raw line; only forwarded by the worker while something is connected.
     void messageReceived(QString line);
     void engineMove(QString);
+    void stateChanged(UciEngine::State);
+
+    // Typed engine output, parsed straight from the bytes the engine wrote.
+    void info(const UciInfo &info);
+    void bestMove(const UciBestMove &bestMove);
+    void optionReceived(const QString &name, const QString &type, const QString &defaultValue);
+
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
 
 private:
-    void parseLine(const QString &line);
-    QProcess *m_uciEngine;
+    QThread m_thread;
+    UciEngineWorker *m_worker;
+    State m_state;
+
+    // Generation of the last search requested, 0 before the first one.
+    quint32 m_generation;
 };
 
+Q_DECLARE_METATYPE(UciInfo)
+Q_DECLARE_METATYPE(UciBestMove)
+
 #endif // UCIENGINE_H
@@ -0,0 +1,383 @@
+#include "uciengineworker.h"
+#include <cstring>
+#include <utility>
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QObject>
+
+// Engine traffic, enable with QT_LOGGING_RULES="chess.uci.debug=true".
+Q_LOGGING_CATEGORY(lcUci, "chess.uci", QtInfoMsg)
+
+UciEngineWorker::UciEngineWorker(QObject *parent)
+    : QObject{parent}
+{
+    m_uciEngine = new QProcess(this);
+    m_uciEngine->setReadChannel(QProcess::StandardOutput);
+
+    m_state = UciEngine::NotRunning;
+    m_forwardLines = false;
+    m_pendingInfoMask = 0;
+    m_hasPendingSearch = false;
+    m_pendingPonder = false;
+    m_pendingGeneration = 0;
+    m_searchGeneration = 0;
+    m_pondering = false;
+    m_ponderedNs = 0;
+    m_newGamePending = true;
+    m_stopSent = false;
+
+    m_infoTimer = new QTimer(this);
+    m_infoTimer->setSingleShot(true);
+    m_infoTimer->setInterval(InfoInterval);
+    connect(m_infoTimer, &QTimer::timeout, this, &UciEngineWorker::flushInfo);
+
+    connect(m_uciEngine, SIGNAL(readyReadStandardOutput()), SLOT(readFromEngine()));
+    connect(m_uciEngine, &QProcess::started, this, &UciEngineWorker::processStarted);
+    connect(m_uciEngine, &QProcess::finished, this, &UciEngineWorker::processFinished);
+    connect(m_uciEngine, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        qWarning() << "Engine error:" << error << m_uciEngine->errorString();
+        if (error == QProcess::FailedToStart)
+            processFinished();
+    });
+}
+
+UciEngineWorker::~UciEngineWorker()
+{
+    stopEngine();
+    delete m_uciEngine;
+}
+
+void UciEngineWorker::setState(UciEngine::State state)
+{
+    if (m_state == state)
+        return;
+
+    m_state = state;
+    emit stateChanged(m_state);
+}
+
+void UciEngineWorker::setOption(const QString &name, const QString &value)
+{
+    bool known = false;
+    for (QPair<QString, QString> &option : m_options)
+    {
+        if (option.first == name)
+        {
+            option.second = value;
+            known = true;
+        }
+    }
+    if (!known)
+        m_options.append(qMakePair(name, value));
+
+    // Options that change after initialisation are sent before the next search.
+    if (m_state == UciEngine::Starting || m_state == UciEngine::NotRunning)
+        return;
+    m_changedOptions.append(qMakePair(name, value));
+    if (m_state == UciEngine::Idle)
+        synchronize();
+}
+
+void UciEngineWorker::startEngine(const QString &enginepath)
+{
+    if (m_state != UciEngine::NotRunning && enginepath == m_enginePath)
+        return;
+    if (m_state != UciEngine::NotRunning)
+        stopEngine();
+
+    qCInfo(lcUci) << "Starting" << enginepath;
+    m_enginePath = enginepath;
+    m_newGamePending = true;
+    m_stopSent = false;
+    m_changedOptions.clear();
+    setState(UciEngine::Starting);
+    m_uciEngine->start(enginepath, QStringList());
+}
+
+void UciEngineWorker::stopEngine()
+{
+    if (m_state == UciEngine::NotRunning)
+        return;
+
+    qCInfo(lcUci) << "Stopping" << m_enginePath;
+    sendCommand("quit");
+    if (!m_uciEngine->waitForFinished(1000))
+        m_uciEngine->kill();
+    m_uciEngine->close();
+    processFinished();
+}
+
+void UciEngineWorker::processStarted()
+{
+    sendCommand("uci");
+}
+
+void UciEngineWorker::processFinished()
+{
+    m_readBuffer.clear();
+    m_hasPendingSearch = false;
+    m_pondering = false;
+    m_stopSent = false;
+    setState(UciEngine::NotRunning);
+}
+
+void UciEngineWorker::sendCommand(const QString &command)
+{
+    qCDebug(lcUci) << ">" << command;
+    m_uciEngine->write(command.toLatin1() + "\n");
+}
+
+void UciEngineWorker::setForwardLines(bool forward)
+{
+    m_forwardLines = forward;
+}
+
+void UciEngineWorker::newGame()
+{
+    m_newGamePending = true;
+}
+
+void UciEngineWorker::analyse(const QString &fen, const QString &goCommand, quint32 generation)
+{
+    // The ponder search was right, it goes on as the real search and keeps what it found so far.
+    if (m_state == UciEngine::Searching && m_pondering && !m_stopSent && fen == m_ponderFen && goCommand == m_ponderGo)
+    {
+        sendCommand("ponderhit");
+        m_pondering = false;
+        m_ponderedNs = m_searchTimer.nsecsElapsed();
+        m_searchTimer.start();
+
+        // What the search found while pondering belongs to the new request as well.
+        m_searchGeneration = generation;
+        for (UciInfo &info : m_pendingInfo)
+            info.generation = generation;
+        m_hasPendingSearch = false;
+        return;
+    }
+
+    m_pendingFen = fen;
+    m_pendingGo = goCommand;
+    m_pendingPonder = false;
+    m_pendingGeneration = generation;
+    queueSearch();
+}
+
+void UciEngineWorker::ponder(const QString &fen, const QString &goCommand, quint32 generation)
+{
+    m_pendingFen = fen;
+    m_pendingGo = goCommand;
+    m_pendingPonder = true;
+    m_pendingGeneration = generation;
+    queueSearch();
+}
+
+// Drops a search that was requested but not started, a running one ends with a stale bestmove.
+void UciEngineWorker::stopSearch()
+{
+    m_hasPendingSearch = false;
+    if (m_state != UciEngine::Searching || m_stopSent)
+        return;
+
+    sendCommand("stop");
+    m_stopSent = true;
+    m_pendingInfoMask = 0;
+    m_infoTimer->stop();
+}
+
+void UciEngineWorker::queueSearch()
+{
+    m_hasPendingSearch = true;
+
+    switch (m_state)
+    {
+    case UciEngine::Idle:
+        startSearch();
+        break;
+    case UciEngine::Searching:
+        // The old search ends with a bestmove that is dropped, then the new one starts.
+        if (!m_stopSent)
+        {
+            sendCommand("stop");
+            m_stopSent = true;
+            m_pendingInfoMask = 0;
+            m_infoTimer->stop();
+        }
+        break;
+    default:
+        // Started once the engine reports it is ready.
+        break;
+    }
+}
+
+void UciEngineWorker::startSearch()
+{
+    if (!m_hasPendingSearch)
+        return;
+
+    if (m_newGamePending || !m_changedOptions.isEmpty())
+    {
+        synchronize();
+        return;
+    }
+
+    m_hasPendingSearch = false;
+    m_pondering = m_pendingPonder;
+    m_searchGeneration = m_pendingGeneration;
+    m_ponderedNs = 0;
+    sendCommand("position fen " + m_pendingFen);
+    if (m_pondering)
+    {
+        m_ponderFen = m_pendingFen;
+        m_ponderGo = m_pendingGo;
+        QString go = m_pendingGo;
+        sendCommand(go.insert(2, " ponder"));
+    }
+    else
+    {
+        sendCommand(m_pendingGo);
+    }
+    m_searchTimer.start();
+    setState(UciEngine::Searching);
+}
+
+// Options and ucinewgame need an isready round trip before the next position may be sent.
+void UciEngineWorker::synchronize()
+{
+    for (const QPair<QString, QString> &option : std::as_const(m_changedOptions))
+        sendCommand(QStringLiteral("setoption name %1 value %2").arg(option.first, option.second));
+    m_changedOptions.clear();
+
+    if (m_newGamePending)
+    {
+        m_newGamePending = false;
+        sendCommand("ucinewgame");
+    }
+
+    sendCommand("isready");
+    setState(UciEngine::Synchronizing);
+}
+
+// Lines are cut out of the raw output buffer and parsed in place, only a partial last line is kept.
+void UciEngineWorker::readFromEngine()
+{
+    m_readBuffer.append(m_uciEngine->readAllStandardOutput());
+
+    const char *data = m_readBuffer.constData();
+    const qsizetype size = m_readBuffer.size();
+    qsizetype start = 0;
+    while (start < size)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(data + start, '\n', std::size_t(size - start)));
+        if (!newline)
+            break;
+
+        const qsizetype end = newline - data;
+        std::string_view line(data + start, std::size_t(end - start));
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        start = end + 1;
+
+        parseLine(line);
+        if (m_forwardLines)
+            emit messageReceived(QString::fromLatin1(line.data(), qsizetype(line.size())));
+    }
+    m_readBuffer.remove(0, start);
+}
+
+void UciEngineWorker::parseLine(std::string_view line)
+{
+    switch (Uci::messageType(line))
+    {
+    case Uci::Message::UciOk:
+        if (m_state != UciEngine::Starting)
+            return;
+
+        for (const QPair<QString, QString> &option : std::as_const(m_options))
+            sendCommand(QStringLiteral("setoption name %1 value %2").arg(option.first, option.second));
+        sendCommand("isready");
+        setState(UciEngine::Initializing);
+        break;
+
+    case Uci::Message::ReadyOk:
+        if (m_state != UciEngine::Initializing && m_state != UciEngine::Synchronizing)
+            return;
+
+        setState(UciEngine::Idle);
+        startSearch();
+        break;
+
+    case Uci::Message::Info:
+        // Output of a search that was stopped is of no interest any more.
+        if (m_state == UciEngine::Searching && !m_stopSent && Uci::parseInfo(line, m_info))
+        {
+            m_info.generation = m_searchGeneration;
+            queueInfo(m_info);
+        }
+        break;
+
+    case Uci::Message::BestMove:
+    {
+        UciBestMove result;
+        if (m_state != UciEngine::Searching || !Uci::parseBestMove(line, result))
+            return;
+        result.elapsedNs = m_searchTimer.nsecsElapsed();
+        result.ponderedNs = m_ponderedNs;
+        result.generation = m_searchGeneration;
+
+        // An engine must not answer a ponder search before ponderhit; if it does, the answer is dropped.
+        const bool stale = m_stopSent || m_pondering;
+        m_stopSent = false;
+        m_pondering = false;
+        setState(UciEngine::Idle);
+
+        if (stale)
+        {
+            qCDebug(lcUci) << "Dropping stale" << QLatin1String(line.data(), qsizetype(line.size()));
+        }
+        else
+        {
+            // The last info of a search arrives before its bestmove.
+            flushInfo();
+            emit bestMove(result);
+        }
+
+        startSearch();
+        break;
+    }
+
+    case Uci::Message::Option:
+    {
+        UciOption option;
+        if (Uci::parseOption(line, option))
+        {
+            const auto toString = [](std::string_view text) { return QString::fromLatin1(text.data(), qsizetype(text.size())); };
+            emit optionReceived(toString(option.name), toString(option.type), toString(option.defaultValue));
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void UciEngineWorker::queueInfo(const UciInfo &info)
+{
+    const int slot = qBound(0, info.multiPv - 1, MaxInfoLines - 1);
+    m_pendingInfo[slot] = info;
+    m_pendingInfoMask |= 1u << slot;
+
+    if (!m_infoTimer->isActive())
+        m_infoTimer->start();
+}
+
+void UciEngineWorker::flushInfo()
+{
+    m_infoTimer->stop();
+    for (int slot = 0; slot < MaxInfoLines; ++slot)
+    {
+        if (m_pendingInfoMask & (1u << slot))
+            emit info(m_pendingInfo[slot]);
+    }
+    m_pendingInfoMask = 0;
+}
@@ -0,0 +1,109 @@
+#ifndef UCIENGINEWORKER_H
+#define UCIENGINEWORKER_H
+
+#include <string_view>
+#include "uciengine.h"
+#include "uciparser.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+
+/**
+ * @brief Owns the engine process and runs on the UciEngine I/O thread.
+ *
+ * Keeps one engine process alive for the whole session. The engine goes through
+ * Starting (waiting for uciok) and Initializing (waiting for readyok) once, after that
+ * it is Idle or Searching. A new search while one is running stops the old one, its
+ * bestmove is dropped and the new position is sent once the engine is idle again.
+ * A ponder search is such a search as well, unless the next request is for the position
+ * it ponders on; then ponderhit is sent and the search goes on.
+ *
+ * Info lines are coalesced: only the newest line per multipv slot is kept and they are
+ * handed on at most every InfoInterval milliseconds. Everything else goes out right away.
+ */
+class UciEngineWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int InfoInterval = 33;
+    static constexpr int MaxInfoLines = 8;
+
+    explicit UciEngineWorker(QObject *parent = nullptr);
+    ~UciEngineWorker();
+
+public slots:
+    void startEngine(const QString &enginepath);
+    void stopEngine();
+    void sendCommand(const QString &command);
+    void setOption(const QString &name, const QString &value);
+    void newGame();
+    void analyse(const QString &fen, const QString &goCommand, quint32 generation);
+    void ponder(const QString &fen, const QString &goCommand, quint32 generation);
+    void stopSearch();
+    void setForwardLines(bool forward);
+
+private slots:
+    void readFromEngine();
+    void processStarted();
+    void processFinished();
+    void flushInfo();
+
+signals:
+    void messageReceived(QString line);
+    void stateChanged(UciEngine::State);
+    void info(const UciInfo &info);
+    void bestMove(const UciBestMove &bestMove);
+    void optionReceived(const QString &name, const QString &type, const QString &defaultValue);
+
+private:
+    void parseLine(std::string_view line);
+    void queueInfo(const UciInfo &info);
+    void setState(UciEngine::State state);
+    void queueSearch();
+    void startSearch();
+    void synchronize();
+
+    QProcess *m_uciEngine;
+    QByteArray m_readBuffer;
+    UciInfo m_info;
+    UciEngine::State m_state;
+    QString m_enginePath;
+    QList<QPair<QString, QString>> m_options;
+    QList<QPair<QString, QString>> m_changedOptions;
+    bool m_forwardLines;
+
+    // Newest info per multipv slot, waiting for the next flush.
+    QTimer *m_infoTimer;
+    UciInfo m_pendingInfo[MaxInfoLines];
+    unsigned m_pendingInfoMask;
+
+    // Search waiting for the engine to become idle.
+    QString m_pendingFen;
+    QString m_pendingGo;
+    bool m_hasPendingSearch;
+    bool m_pendingPonder;
+    quint32 m_pendingGeneration;
+
+    // Generation of the running search, stamped on its info and bestmove.
+    quint32 m_searchGeneration;
+
+    // The running search was started with "go ponder" for this position and has not been hit yet.
+    QString m_ponderFen;
+    QString m_ponderGo;
+    bool m_pondering;
+
+    bool m_newGamePending;
+
+    // The running search was stopped, its bestmove is stale.
+    bool m_stopSent;
+
+    // Started right after "go" is written, so clocks do not include queueing in the GUI thread.
+    QElapsedTimer m_searchTimer;
+    qint64 m_ponderedNs;
+};
+
+#endif // UCIENGINEWORKER_H
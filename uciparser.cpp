@@ -0,0 +1,197 @@
+#include "uciparser.h"
+#include <charconv>
+
+namespace
+{
+    inline bool isSpace(char ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+    }
+
+    // Splits a line into whitespace separated tokens.
+    class Tokenizer
+    {
+    public:
+        explicit Tokenizer(std::string_view line) : m_rest(line) {}
+
+        std::string_view next()
+        {
+            std::size_t start = 0;
+            while (start < m_rest.size() && isSpace(m_rest[start]))
+                ++start;
+            std::size_t end = start;
+            while (end < m_rest.size() && !isSpace(m_rest[end]))
+                ++end;
+
+            const std::string_view token = m_rest.substr(start, end - start);
+            m_rest.remove_prefix(end);
+            return token;
+        }
+
+    private:
+        std::string_view m_rest;
+    };
+
+    template<typename T>
+    bool toNumber(std::string_view token, T &value)
+    {
+        T result {};
+        const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), result);
+        if (error != std::errc() || end != token.data() + token.size())
+            return false;
+        value = result;
+        return true;
+    }
+
+    bool isOptionKeyword(std::string_view token)
+    {
+        return token == "name" || token == "type" || token == "default" || token == "min" || token == "max" || token == "var";
+    }
+}
+
+Uci::Message Uci::messageType(std::string_view line)
+{
+    const std::string_view command = Tokenizer(line).next();
+
+    if (command == "info")
+        return Message::Info;
+    if (command == "bestmove")
+        return Message::BestMove;
+    if (command == "readyok")
+        return Message::ReadyOk;
+    if (command == "uciok")
+        return Message::UciOk;
+    if (command == "option")
+        return Message::Option;
+    if (command == "id")
+        return Message::Id;
+    if (command == "copyprotection")
+        return Message::CopyProtection;
+    if (command == "registration")
+        return Message::Registration;
+    return Message::Unknown;
+}
+
+bool Uci::parseInfo(std::string_view line, UciInfo &info)
+{
+    Tokenizer tokens(line);
+    if (tokens.next() != "info")
+        return false;
+
+    info = UciInfo();
+    for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next())
+    {
+        if (token == "depth")
+            toNumber(tokens.next(), info.depth);
+        else if (token == "seldepth")
+            toNumber(tokens.next(), info.selDepth);
+        else if (token == "multipv")
+            toNumber(tokens.next(), info.multiPv);
+        else if (token == "time")
+            toNumber(tokens.next(), info.timeMs);
+        else if (token == "nodes")
+            toNumber(tokens.next(), info.nodes);
+        else if (token == "nps")
+            toNumber(tokens.next(), info.nps);
+        else if (token == "tbhits")
+            toNumber(tokens.next(), info.tbHits);
+        else if (token == "hashfull")
+            toNumber(tokens.next(), info.hashFull);
+        else if (token == "currmove")
+            info.currentMove = Move::fromUci(tokens.next());
+        else if (token == "currmovenumber")
+            toNumber(tokens.next(), info.currentMoveNumber);
+        else if (token == "score")
+        {
+            const std::string_view type = tokens.next();
+            if (type == "cp" && toNumber(tokens.next(), info.score))
+                info.scoreType = UciInfo::Centipawns;
+            else if (type == "mate" && toNumber(tokens.next(), info.score))
+                info.scoreType = UciInfo::Mate;
+        }
+        else if (token == "lowerbound")
+            info.lowerBound = true;
+        else if (token == "upperbound")
+            info.upperBound = true;
+        else if (token == "pv")
+        {
+            // The pv runs up to the next keyword or the end of the line.
+            Tokenizer lookahead = tokens;
+            for (std::string_view move = lookahead.next(); !move.empty(); move = lookahead.next())
+            {
+                const Move parsed = Move::fromUci(move);
+                if (parsed.isNull())
+                    break;
+                if (info.pvLength < UciInfo::MaxPv)
+                    info.pv[info.pvLength++] = parsed;
+                tokens = lookahead;
+            }
+        }
+        else if (token == "string")
+        {
+            // Free text up to the end of the line.
+            info.hasString = true;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool Uci::parseBestMove(std::string_view line, UciBestMove &bestMove)
+{
+    Tokenizer tokens(line);
+    if (tokens.next() != "bestmove")
+        return false;
+
+    // "bestmove (none)" and "bestmove 0000" leave a null move.
+    bestMove = UciBestMove();
+    bestMove.move = Move::fromUci(tokens.next());
+    if (tokens.next() == "ponder")
+        bestMove.ponder = Move::fromUci(tokens.next());
+
+    return true;
+}
+
+/*
+ * Option names and values may contain spaces ("option name Clear Hash type button"),
+ * so a value runs until the next keyword.
+ */
+bool Uci::parseOption(std::string_view line, UciOption &option)
+{
+    Tokenizer tokens(line);
+    if (tokens.next() != "option")
+        return false;
+
+    option = UciOption();
+    std::string_view *field = nullptr;
+    for (std::string_view token = tokens.next(); !token.empty(); token = tokens.next())
+    {
+        if (isOptionKeyword(token))
+        {
+            if (token == "name")
+                field = &option.name;
+            else if (token == "type")
+                field = &option.type;
+            else if (token == "default")
+                field = &option.defaultValue;
+            else if (token == "min")
+                field = &option.min;
+            else if (token == "max")
+                field = &option.max;
+            else
+                field = nullptr;
+            continue;
+        }
+        if (!field)
+            continue;
+
+        // Extend the value over the token, the view stays inside the line.
+        if (field->empty())
+            *field = token;
+        else
+            *field = std::string_view(field->data(), std::size_t(token.data() + token.size() - field->data()));
+    }
+
+    return !option.name.empty();
+}
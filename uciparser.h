@@ -0,0 +1,84 @@
+#ifndef UCIPARSER_H
+#define UCIPARSER_H
+
+#include <cstdint>
+#include <string_view>
+#include "move.h"
+
+// Contents of one "info" line. Fields the engine did not send keep their default.
+struct UciInfo
+{
+    enum ScoreType : std::uint8_t {NoScore, Centipawns, Mate};
+
+    static constexpr int MaxPv = 64;
+
+    int depth = -1;
+    int selDepth = -1;
+    int multiPv = 1;
+    ScoreType scoreType = NoScore;
+    bool lowerBound = false;
+    bool upperBound = false;
+    int score = 0;
+    std::int64_t timeMs = -1;
+    std::uint64_t nodes = 0;
+    std::uint64_t nps = 0;
+    std::uint64_t tbHits = 0;
+    int hashFull = -1;
+    Move currentMove;
+    int currentMoveNumber = 0;
+
+    // Principal variation, longer ones are cut off at MaxPv moves.
+    Move pv[MaxPv];
+    int pvLength = 0;
+
+    // Set for "info string", the text itself is not stored.
+    bool hasString = false;
+
+    // Search the line belongs to, as returned by UciEngine::analyse() or ponder(). Not parsed,
+    // the worker fills it in.
+    std::uint32_t generation = 0;
+};
+
+struct UciBestMove
+{
+    // Null for "bestmove (none)" or "bestmove 0000".
+    Move move;
+    Move ponder;
+
+    // Time from sending "go", or "ponderhit" for a pondered search, to reading this line,
+    // measured on the I/O thread.
+    std::int64_t elapsedNs = 0;
+
+    // Time the search ran in ponder mode before the ponderhit, 0 when it was not pondered.
+    std::int64_t ponderedNs = 0;
+
+    // Search the answer belongs to, see UciInfo::generation.
+    std::uint32_t generation = 0;
+};
+
+// An "option" line. The views point into the parsed line and are only valid as long as it is.
+struct UciOption
+{
+    std::string_view name;
+    std::string_view type;
+    std::string_view defaultValue;
+    std::string_view min;
+    std::string_view max;
+};
+
+/*
+ * Tokenizer for engine to GUI messages, see https://www.shredderchess.com/download/div/uci.zip.
+ * Works on the raw bytes of one line without allocating, unknown tokens are skipped.
+ */
+namespace Uci
+{
+    enum class Message {Unknown, Id, UciOk, ReadyOk, BestMove, Info, Option, CopyProtection, Registration};
+
+    Message messageType(std::string_view line);
+
+    bool parseInfo(std::string_view line, UciInfo &info);
+    bool parseBestMove(std::string_view line, UciBestMove &bestMove);
+    bool parseOption(std::string_view line, UciOption &option);
+}
+
+#endif // UCIPARSER_H
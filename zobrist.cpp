@@ -0,0 +1,99 @@
+#include "zobrist.h"
+
+namespace
+{
+    // SplitMix64, deterministic and good enough to fill the key table.
+    constexpr std::uint64_t nextRandom(std::uint64_t &state)
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    constexpr Zobrist::Keys makeKeys()
+    {
+        Zobrist::Keys keys {};
+        std::uint64_t state = 0x5eed0fc4e55ull;
+        for (auto &piece : keys.pieces)
+        {
+            for (auto &square : piece)
+                square = nextRandom(state);
+        }
+
+        // Castling keys are combined per right, so the table is consistent with a per-right update.
+        std::uint64_t rights[4] = {};
+        for (auto &right : rights)
+            right = nextRandom(state);
+        for (int mask = 0; mask < 16; ++mask)
+        {
+            for (int right = 0; right < 4; ++right)
+            {
+                if (mask & (1 << right))
+                    keys.castling[mask] ^= rights[right];
+            }
+        }
+
+        for (auto &column : keys.enPassant)
+            column = nextRandom(state);
+        keys.side = nextRandom(state);
+
+        return keys;
+    }
+}
+
+const Zobrist::Keys Zobrist::keys = makeKeys();
+
+int Zobrist::pieceIndex(char piece)
+{
+    switch (piece)
+    {
+    case 'P': return 0;
+    case 'N': return 1;
+    case 'B': return 2;
+    case 'R': return 3;
+    case 'Q': return 4;
+    case 'K': return 5;
+    case 'p': return 6;
+    case 'n': return 7;
+    case 'b': return 8;
+    case 'r': return 9;
+    case 'q': return 10;
+    case 'k': return 11;
+    }
+    return -1;
+}
+
+bool Zobrist::hasEnPassantCapture(const Position &position)
+{
+    const int square = position.epSquare;
+    if (square == Position::NoSquare)
+        return false;
+
+    // Pawns of the side to move that stand next to the pawn that just made a double step.
+    const bool white = position.sideToMove == Position::White;
+    const char pawn = white ? 'P' : 'p';
+    const int behind = white ? square - 8 : square + 8;
+    const int column = square % 8;
+    return (column > 0 && position.board[behind - 1] == pawn)
+            || (column < 7 && position.board[behind + 1] == pawn);
+}
+
+std::uint64_t Zobrist::key(const Position &position)
+{
+    std::uint64_t key = 0;
+    for (int square = 0; square < 64; ++square)
+    {
+        const int piece = pieceIndex(position.board[square]);
+        if (piece >= 0)
+            key ^= keys.pieces[piece][square];
+    }
+
+    key ^= keys.castling[position.castling & Position::AllCastling];
+    if (hasEnPassantCapture(position))
+        key ^= keys.enPassant[position.epSquare % 8];
+    if (position.sideToMove == Position::Black)
+        key ^= keys.side;
+
+    return key;
+}
@@ -0,0 +1,33 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+#include "position.h"
+
+/*
+ * Zobrist hashing of positions. Two positions get the same key when they have the same pieces,
+ * side to move, castling rights and a usable en-passant capture; the clocks are ignored.
+ * The keys are fixed, so stored keys stay valid between runs and builds.
+ */
+namespace Zobrist
+{
+    struct Keys
+    {
+        std::uint64_t pieces[12][64];
+        std::uint64_t castling[16];
+        std::uint64_t enPassant[8];
+        std::uint64_t side;
+    };
+
+    extern const Keys keys;
+
+    // Index into Keys::pieces, -1 for an empty square.
+    int pieceIndex(char piece);
+
+    // The en-passant square only counts when a pawn can actually capture on it.
+    bool hasEnPassantCapture(const Position &position);
+
+    std::uint64_t key(const Position &position);
+}
+
+#endif // ZOBRIST_H